@@ -0,0 +1,281 @@
+/*---------------------------------------------------------------------
+| jx_arena.c
+----------------------------------------------------------------------
+| jxutil project
+|
+| Created by Cory Montgomery
+| cory.james.montgomery@gmail.com
+|
+| https://cjmont32.dev/jxutil
+| https://github.com/cjmont32/jxutil
+|
+----------------------------------------------------------------------
+| BSD 2-Clause License
+|
+| Copyright (c) 2018-2023, Cory Montgomery
+|
+| Redistribution and use in source and binary forms, with or without
+| modification, are permitted provided that the following conditions
+| are met:
+|
+|    1. Redistributions of source code must retain the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer.
+|    2. Redistributions in binary form must reproduce the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer in the documentation and/or other materials
+|       provided with the distribution.
+|
+| THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+| "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+| LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+| FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+| COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+| INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+| BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+| LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+| CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+| LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+| WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+| POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define JX_INTERNAL
+
+#include <string.h>
+#include <stdint.h>
+
+#include <jx_arena.h>
+
+#define JX_ARENA_ALIGN 16
+
+typedef struct jx_arena_block_t
+{
+    struct jx_arena_block_t *next;
+
+    size_t size;
+    size_t pos;
+} jx_arena_block;
+
+struct jx_arena_t
+{
+    jx_arena_block *head;
+    jx_arena_block *current;
+
+    /* The most recent allocation, which jx_mem_realloc() can grow in place. */
+    char *last;
+
+    struct jx_intern_t *intern;
+
+    size_t block_size;
+};
+
+#define jx_arena_align(n) (((n) + (JX_ARENA_ALIGN - 1)) & ~(size_t)(JX_ARENA_ALIGN - 1))
+#define jx_arena_block_data(block) ((char *)(block) + jx_arena_align(sizeof(jx_arena_block)))
+
+jx_arena_block *jx_arena_block_new(size_t size)
+{
+    jx_arena_block *block;
+
+    if ((block = malloc(jx_arena_align(sizeof(jx_arena_block)) + size)) == NULL) {
+        return NULL;
+    }
+
+    block->next = NULL;
+    block->size = size;
+    block->pos = 0;
+
+    return block;
+}
+
+jx_arena *jx_arena_new(size_t block_size)
+{
+    jx_arena *arena;
+
+    if (block_size == 0) {
+        block_size = JX_ARENA_DEFAULT_BLOCK_SIZE;
+    }
+
+    if ((arena = calloc(1, sizeof(jx_arena))) == NULL) {
+        return NULL;
+    }
+
+    arena->block_size = jx_arena_align(block_size);
+
+    if ((arena->head = jx_arena_block_new(arena->block_size)) == NULL) {
+        free(arena);
+        return NULL;
+    }
+
+    arena->current = arena->head;
+
+    return arena;
+}
+
+void *jx_arena_alloc(jx_arena *arena, size_t size)
+{
+    jx_arena_block *block;
+    char *ptr;
+
+    if (arena == NULL) {
+        return NULL;
+    }
+
+    if (size > SIZE_MAX - JX_ARENA_ALIGN - sizeof(jx_arena_block)) {
+        return NULL;
+    }
+
+    size = jx_arena_align(size ? size : 1);
+
+    block = arena->current;
+
+    /* Move on to the next block when this one is full: blocks kept from before the last
+     * reset are reused when large enough, otherwise a new block is linked in after the
+     * current one. Requests larger than the block size get a block of their own. */
+    if (block->size - block->pos < size) {
+        if (block->next != NULL && block->next->size >= size) {
+            block = block->next;
+            block->pos = 0;
+        }
+        else {
+            jx_arena_block *new_block;
+
+            new_block = jx_arena_block_new(size > arena->block_size ? size : arena->block_size);
+
+            if (new_block == NULL) {
+                return NULL;
+            }
+
+            new_block->next = block->next;
+            block->next = new_block;
+
+            block = new_block;
+        }
+
+        arena->current = block;
+    }
+
+    ptr = jx_arena_block_data(block) + block->pos;
+
+    block->pos += size;
+
+    arena->last = ptr;
+
+    return ptr;
+}
+
+void jx_arena_reset(jx_arena *arena)
+{
+    if (arena == NULL) {
+        return;
+    }
+
+    arena->current = arena->head;
+    arena->current->pos = 0;
+    arena->last = NULL;
+    arena->intern = NULL;
+}
+
+/* The number of bytes held by the arena, whether in use or not. */
+size_t jx_arena_get_size(jx_arena *arena)
+{
+    jx_arena_block *block;
+    size_t size = 0;
+
+    if (arena == NULL) {
+        return 0;
+    }
+
+    for (block = arena->head; block != NULL; block = block->next) {
+        size += block->size;
+    }
+
+    return size;
+}
+
+void jx_arena_free(jx_arena *arena)
+{
+    jx_arena_block *block, *next;
+
+    if (arena == NULL) {
+        return;
+    }
+
+    for (block = arena->head; block != NULL; block = next) {
+        next = block->next;
+        free(block);
+    }
+
+    free(arena);
+}
+
+struct jx_intern_t *jx_arena_get_intern(jx_arena *arena)
+{
+    return arena->intern;
+}
+
+void jx_arena_set_intern(jx_arena *arena, struct jx_intern_t *intern)
+{
+    arena->intern = intern;
+}
+
+void *jx_mem_alloc(jx_arena *arena, size_t size)
+{
+    if (arena == NULL) {
+        return malloc(size);
+    }
+
+    return jx_arena_alloc(arena, size);
+}
+
+void *jx_mem_calloc(jx_arena *arena, size_t size)
+{
+    void *ptr;
+
+    if (arena == NULL) {
+        return calloc(1, size);
+    }
+
+    if ((ptr = jx_arena_alloc(arena, size)) != NULL) {
+        memset(ptr, 0, size);
+    }
+
+    return ptr;
+}
+
+void *jx_mem_realloc(jx_arena *arena, void *ptr, size_t old_size, size_t new_size)
+{
+    void *new_ptr;
+
+    if (arena == NULL) {
+        return realloc(ptr, new_size);
+    }
+
+    /* Growing the most recent allocation only needs the current block to have room. */
+    if (ptr != NULL && ptr == arena->last) {
+        jx_arena_block *block = arena->current;
+        size_t offset = (char *)ptr - jx_arena_block_data(block);
+
+        if (new_size <= block->size - offset) {
+            block->pos = offset + jx_arena_align(new_size);
+            return ptr;
+        }
+    }
+
+    if ((new_ptr = jx_arena_alloc(arena, new_size)) == NULL) {
+        return NULL;
+    }
+
+    if (ptr != NULL) {
+        memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    }
+
+    return new_ptr;
+}
+
+void jx_mem_free(jx_arena *arena, void *ptr)
+{
+    if (arena == NULL) {
+        free(ptr);
+    }
+}
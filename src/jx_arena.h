@@ -0,0 +1,81 @@
+/*---------------------------------------------------------------------
+| jx_arena.h
+----------------------------------------------------------------------
+| jxutil project
+|
+| Created by Cory Montgomery
+| cory.james.montgomery@gmail.com
+|
+| https://cjmont32.dev/jxutil
+| https://github.com/cjmont32/jxutil
+|
+----------------------------------------------------------------------
+| BSD 2-Clause License
+|
+| Copyright (c) 2018-2023, Cory Montgomery
+|
+| Redistribution and use in source and binary forms, with or without
+| modification, are permitted provided that the following conditions
+| are met:
+|
+|    1. Redistributions of source code must retain the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer.
+|    2. Redistributions in binary form must reproduce the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer in the documentation and/or other materials
+|       provided with the distribution.
+|
+| THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+| "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+| LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+| FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+| COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+| INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+| BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+| LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+| CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+| LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+| WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+| POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+/* Region allocator for documents that are built, used and discarded as a unit.
+ *
+ * Allocations are carved sequentially out of large blocks and are never freed
+ * individually; jx_arena_reset() releases everything allocated so far in O(1)
+ * by rewinding to the first block, keeping the blocks for the next document.
+ * The memory is only returned to the system by jx_arena_free(). An arena is
+ * not thread-safe. */
+
+#define JX_ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+struct jx_arena_t;
+typedef struct jx_arena_t jx_arena;
+
+jx_arena *jx_arena_new(size_t block_size);
+void *jx_arena_alloc(jx_arena *arena, size_t size);
+void jx_arena_reset(jx_arena *arena);
+size_t jx_arena_get_size(jx_arena *arena);
+void jx_arena_free(jx_arena *arena);
+
+#ifdef JX_INTERNAL
+/* Heap or arena allocation, depending on whether arena is NULL; used by the
+ * value constructors so that the same code path serves both. */
+void *jx_mem_alloc(jx_arena *arena, size_t size);
+void *jx_mem_calloc(jx_arena *arena, size_t size);
+void *jx_mem_realloc(jx_arena *arena, void *ptr, size_t old_size, size_t new_size);
+void jx_mem_free(jx_arena *arena, void *ptr);
+
+/* The key intern table shared by the objects allocated from the arena (see
+ * jx_intern_get()); jx_arena_reset() drops it along with everything else. */
+struct jx_intern_t;
+
+struct jx_intern_t *jx_arena_get_intern(jx_arena *arena);
+void jx_arena_set_intern(jx_arena *arena, struct jx_intern_t *intern);
+#endif
@@ -0,0 +1,376 @@
+/*---------------------------------------------------------------------
+| jx_async.c
+----------------------------------------------------------------------
+| jxutil project
+|
+| Created by Cory Montgomery
+| cory.james.montgomery@gmail.com
+|
+| https://cjmont32.dev/jxutil
+| https://github.com/cjmont32/jxutil
+|
+----------------------------------------------------------------------
+| BSD 2-Clause License
+|
+| Copyright (c) 2018-2023, Cory Montgomery
+|
+| Redistribution and use in source and binary forms, with or without
+| modification, are permitted provided that the following conditions
+| are met:
+|
+|    1. Redistributions of source code must retain the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer.
+|    2. Redistributions in binary form must reproduce the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer in the documentation and/or other materials
+|       provided with the distribution.
+|
+| THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+| "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+| LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+| FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+| COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+| INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+| BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+| LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+| CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+| LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+| WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+| POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define JX_INTERNAL
+
+#include <errno.h>
+#include <string.h>
+
+#include <jx.h>
+#include <jx_util.h>
+
+#ifndef WIN32
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+/* Background parsing.
+ *
+ * The feeding thread copies chunks into a fixed ring of slots, and a worker thread
+ * passes them to jx_parse_json() in order. The ring has one producer and one
+ * consumer, so the slot indices are plain atomics; the mutex and condition variable
+ * are only used to park a side that has nothing to do (the producer when the ring is
+ * full, the worker when it is empty), and are only signalled when the other side has
+ * announced that it is parked. */
+
+#define JX_ASYNC_SLOTS          8
+#define JX_ASYNC_MAX_CHUNK      (64 * 1024)
+#define JX_ASYNC_CACHE_LINE     64
+
+typedef struct
+{
+    char *data;
+    size_t length, size;
+} jx_async_slot;
+
+struct jx_async_t
+{
+    jx_async_slot slots[JX_ASYNC_SLOTS];
+
+    /* The producer owns head, the worker owns tail; keep them on separate cache lines. */
+    atomic_size_t head;
+    char head_pad[JX_ASYNC_CACHE_LINE - sizeof(atomic_size_t)];
+    atomic_size_t tail;
+    char tail_pad[JX_ASYNC_CACHE_LINE - sizeof(atomic_size_t)];
+
+    /* The result of the last call to jx_parse_json() made by the worker. */
+    atomic_int status;
+
+    /* The errno of a failure on the feeding side, which only the worker may report in the
+     * context, so it is kept here until the worker has been joined. */
+    atomic_int error;
+
+    atomic_bool closed;
+    atomic_bool cancelled;
+    atomic_bool producer_waiting;
+    atomic_bool worker_waiting;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+};
+
+void jx_async_wake(jx_async *async, atomic_bool *waiting)
+{
+    if (atomic_load(waiting)) {
+        pthread_mutex_lock(&async->lock);
+        pthread_cond_broadcast(&async->cond);
+        pthread_mutex_unlock(&async->lock);
+    }
+}
+
+bool jx_async_stopped(jx_async *async)
+{
+    return atomic_load(&async->cancelled) || atomic_load(&async->status) == -1;
+}
+
+bool jx_async_ring_full(jx_async *async)
+{
+    return atomic_load(&async->head) - atomic_load(&async->tail) == JX_ASYNC_SLOTS;
+}
+
+bool jx_async_ring_empty(jx_async *async)
+{
+    return atomic_load(&async->head) == atomic_load(&async->tail);
+}
+
+void *jx_async_worker(void *ptr)
+{
+    jx_cntx *cntx = ptr;
+    jx_async *async = cntx->async;
+
+    while (!atomic_load(&async->cancelled)) {
+        size_t tail = atomic_load_explicit(&async->tail, memory_order_relaxed);
+        jx_async_slot *slot;
+        int ret;
+
+        if (tail == atomic_load_explicit(&async->head, memory_order_acquire)) {
+            /* The producer may have published a last chunk just before closing the ring. */
+            if (atomic_load(&async->closed)) {
+                if (!jx_async_ring_empty(async)) {
+                    continue;
+                }
+
+                break;
+            }
+
+            pthread_mutex_lock(&async->lock);
+
+            atomic_store(&async->worker_waiting, true);
+
+            while ( jx_async_ring_empty(async) &&
+                    !atomic_load(&async->closed) &&
+                    !atomic_load(&async->cancelled)) {
+                pthread_cond_wait(&async->cond, &async->lock);
+            }
+
+            atomic_store(&async->worker_waiting, false);
+
+            pthread_mutex_unlock(&async->lock);
+
+            continue;
+        }
+
+        slot = &async->slots[tail % JX_ASYNC_SLOTS];
+
+        ret = jx_parse_json(cntx, slot->data, slot->length);
+
+        atomic_store(&async->status, ret);
+        atomic_store(&async->tail, tail + 1);
+
+        jx_async_wake(async, &async->producer_waiting);
+
+        if (ret == -1) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+void jx_async_free(jx_async *async)
+{
+    int i;
+
+    for (i = 0; i < JX_ASYNC_SLOTS; i++) {
+        free(async->slots[i].data);
+    }
+
+    pthread_mutex_destroy(&async->lock);
+    pthread_cond_destroy(&async->cond);
+
+    free(async);
+}
+
+/* Tell the worker to stop, either once it has parsed everything (closed) or right away
+ * (cancelled). */
+void jx_async_signal(jx_async *async, atomic_bool *flag)
+{
+    pthread_mutex_lock(&async->lock);
+    atomic_store(flag, true);
+    pthread_cond_broadcast(&async->cond);
+    pthread_mutex_unlock(&async->lock);
+}
+
+/* Stop the worker and release the ring. Once the worker is joined, the context is the
+ * caller's again, and a failure recorded while feeding can be reported in it. */
+int jx_async_stop(jx_cntx *cntx, atomic_bool *flag)
+{
+    jx_async *async = cntx->async;
+    int status;
+
+    jx_async_signal(async, flag);
+
+    pthread_join(async->thread, NULL);
+
+    status = atomic_load(&async->status);
+
+    if (atomic_load(&async->error) != 0) {
+        errno = atomic_load(&async->error);
+        jx_set_error(cntx, JX_ERROR_LIBC);
+        status = -1;
+    }
+
+    cntx->async = NULL;
+
+    jx_async_free(async);
+
+    return status;
+}
+
+bool jx_parse_async_start(jx_cntx *cntx)
+{
+    jx_async *async;
+    int err;
+
+    if (cntx == NULL || cntx->async != NULL) {
+        return false;
+    }
+
+    if ((async = calloc(1, sizeof(jx_async))) == NULL) {
+        jx_set_error(cntx, JX_ERROR_LIBC);
+        return false;
+    }
+
+    pthread_mutex_init(&async->lock, NULL);
+    pthread_cond_init(&async->cond, NULL);
+
+    cntx->async = async;
+    cntx->async_cancel = jx_parse_async_cancel;
+
+    if ((err = pthread_create(&async->thread, NULL, jx_async_worker, cntx)) != 0) {
+        cntx->async = NULL;
+        jx_async_free(async);
+
+        errno = err;
+        jx_set_error(cntx, JX_ERROR_LIBC);
+
+        return false;
+    }
+
+    return true;
+}
+
+/* Queue n bytes for the worker, blocking while the ring is full. Returns false once the
+ * worker has failed (the context holds the error), the parse has been cancelled, or
+ * queueing failed; the worker is then stopped, and jx_parse_async_finish() returns -1
+ * with the error set in the context. */
+bool jx_parse_async_feed(jx_cntx *cntx, const char *buf, size_t n)
+{
+    jx_async *async;
+
+    if (cntx == NULL || buf == NULL || (async = cntx->async) == NULL) {
+        return false;
+    }
+
+    while (n > 0) {
+        size_t head, length;
+        jx_async_slot *slot;
+
+        if (jx_async_ring_full(async)) {
+            pthread_mutex_lock(&async->lock);
+
+            atomic_store(&async->producer_waiting, true);
+
+            while (jx_async_ring_full(async) && !jx_async_stopped(async)) {
+                pthread_cond_wait(&async->cond, &async->lock);
+            }
+
+            atomic_store(&async->producer_waiting, false);
+
+            pthread_mutex_unlock(&async->lock);
+        }
+
+        if (jx_async_stopped(async)) {
+            return false;
+        }
+
+        head = atomic_load_explicit(&async->head, memory_order_relaxed);
+        slot = &async->slots[head % JX_ASYNC_SLOTS];
+
+        length = n < JX_ASYNC_MAX_CHUNK ? n : JX_ASYNC_MAX_CHUNK;
+
+        /* Slot buffers only grow, so after the first few chunks feeding does not allocate. */
+        if (slot->size < length) {
+            char *data;
+
+            if ((data = realloc(slot->data, length)) == NULL) {
+                atomic_store(&async->error, ENOMEM);
+                jx_async_signal(async, &async->cancelled);
+                return false;
+            }
+
+            slot->data = data;
+            slot->size = length;
+        }
+
+        memcpy(slot->data, buf, length);
+        slot->length = length;
+
+        atomic_store(&async->head, head + 1);
+
+        jx_async_wake(async, &async->worker_waiting);
+
+        buf += length;
+        n -= length;
+    }
+
+    return true;
+}
+
+/* Wait for the worker to parse everything fed so far, and stop it. Returns what the last
+ * call to jx_parse_json() returned: 1 if the document is complete (the result can then
+ * be collected with jx_get_result()), 0 if more input is needed, or -1 on error. */
+int jx_parse_async_finish(jx_cntx *cntx)
+{
+    if (cntx == NULL || cntx->async == NULL) {
+        return -1;
+    }
+
+    return jx_async_stop(cntx, &cntx->async->closed);
+}
+
+/* Stop the worker without waiting for it to parse the queued input. The context is left
+ * in whatever state the worker reached; use jx_reset() to parse another document. */
+void jx_parse_async_cancel(jx_cntx *cntx)
+{
+    if (cntx == NULL || cntx->async == NULL) {
+        return;
+    }
+
+    jx_async_stop(cntx, &cntx->async->cancelled);
+}
+
+#else
+
+bool jx_parse_async_start(jx_cntx *cntx)
+{
+    errno = ENOSYS;
+    jx_set_error(cntx, JX_ERROR_LIBC);
+    return false;
+}
+
+bool jx_parse_async_feed(jx_cntx *cntx, const char *buf, size_t n)
+{
+    return false;
+}
+
+int jx_parse_async_finish(jx_cntx *cntx)
+{
+    return -1;
+}
+
+void jx_parse_async_cancel(jx_cntx *cntx)
+{
+}
+
+#endif
@@ -0,0 +1,811 @@
+/*---------------------------------------------------------------------
+| jx_hash.c
+----------------------------------------------------------------------
+| jxutil project
+|
+| Created by Cory Montgomery
+| cory.james.montgomery@gmail.com
+|
+| https://cjmont32.dev/jxutil
+| https://github.com/cjmont32/jxutil
+|
+----------------------------------------------------------------------
+| BSD 2-Clause License
+|
+| Copyright (c) 2018-2023, Cory Montgomery
+|
+| Redistribution and use in source and binary forms, with or without
+| modification, are permitted provided that the following conditions
+| are met:
+|
+|    1. Redistributions of source code must retain the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer.
+|    2. Redistributions in binary form must reproduce the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer in the documentation and/or other materials
+|       provided with the distribution.
+|
+| THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+| "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+| LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+| FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+| COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+| INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+| BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+| LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+| CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+| LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+| WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+| POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define JX_INTERNAL
+#define JX_VALUE_INTERNAL
+
+#include <string.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <stdatomic.h>
+#endif
+
+#include <jx_value.h>
+#include <jx_simd.h>
+
+/* Hash table engine for objects (see jx_object in jx_value.h).
+ *
+ * The slots are split into groups of JX_HASH_GROUP control bytes, which are searched
+ * with one SIMD compare each. A key's probe sequence visits whole groups, starting at
+ * the group picked by the high bits of its hash (triangular probing, which reaches every
+ * group since their number is a power of two), and ends at the first group that has an
+ * empty slot. At most 7/8 of the slots are ever filled, so such a group always exists. */
+
+#ifdef JX_SIMD_WIDTH
+#define JX_HASH_GROUP       JX_SIMD_WIDTH
+#else
+#define JX_HASH_GROUP       16
+#endif
+
+#define JX_CTRL_EMPTY       0x80
+#define JX_CTRL_DELETED     0xFE
+
+#define JX_HASH_H1(hash)    ((hash) >> 7)
+#define JX_HASH_H2(hash)    ((uint8_t)((hash) & 0x7F))
+
+/* Hash the key a word at a time, mixing each word in with a multiply and xor-shift. */
+uint32_t jx_hash_key(const char *key, size_t length)
+{
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ length;
+    uint64_t w;
+
+    while (length >= 8) {
+        memcpy(&w, key, 8);
+
+        h = (h ^ w) * 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 31;
+
+        key += 8;
+        length -= 8;
+    }
+
+    if (length > 0) {
+        w = 0;
+        memcpy(&w, key, length);
+
+        h = (h ^ w) * 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 31;
+    }
+
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 32;
+
+    return (uint32_t)h;
+}
+
+/* One bit for each control byte in the group that is equal to c. */
+uint32_t jx_hash_match(const uint8_t *ctrl, uint8_t c)
+{
+#ifdef JX_SIMD_WIDTH
+    return jx_simd_match(ctrl, c);
+#else
+    uint32_t mask = 0;
+    int i;
+
+    for (i = 0; i < JX_HASH_GROUP; i++) {
+        if (ctrl[i] == c) {
+            mask |= 1u << i;
+        }
+    }
+
+    return mask;
+#endif
+}
+
+/* One bit for each empty or deleted slot in the group (the only control bytes with
+ * their high bit set). */
+uint32_t jx_hash_match_free(const uint8_t *ctrl)
+{
+#ifdef JX_SIMD_WIDTH
+    return jx_simd_mask(jx_simd_load(ctrl));
+#else
+    uint32_t mask = 0;
+    int i;
+
+    for (i = 0; i < JX_HASH_GROUP; i++) {
+        if (ctrl[i] & 0x80) {
+            mask |= 1u << i;
+        }
+    }
+
+    return mask;
+#endif
+}
+
+/* Return the slot indexing the entry for key, or the capacity if there isn't one. */
+size_t jx_hash_find_slot(jx_object *obj, const char *key, size_t length, uint32_t hash)
+{
+    size_t mask, group, probe;
+
+    mask = obj->capacity / JX_HASH_GROUP - 1;
+    group = JX_HASH_H1(hash) & mask;
+
+    for (probe = 1; ; probe++) {
+        const uint8_t *ctrl = obj->ctrl + group * JX_HASH_GROUP;
+        uint32_t match = jx_hash_match(ctrl, JX_HASH_H2(hash));
+
+        while (match != 0) {
+            size_t slot = group * JX_HASH_GROUP + jx_ctz32(match);
+            jx_dict_entry *entry = &obj->entries[obj->slots[slot]];
+
+            if (entry->key == key ||
+                (entry->hash == hash && entry->length == length && memcmp(entry->key, key, length) == 0)) {
+                return slot;
+            }
+
+            match &= match - 1;
+        }
+
+        if (jx_hash_match(ctrl, JX_CTRL_EMPTY) != 0) {
+            return obj->capacity;
+        }
+
+        group = (group + probe) & mask;
+    }
+}
+
+/* Return the first empty or deleted slot in the probe sequence for hash. */
+size_t jx_hash_find_free(jx_object *obj, uint32_t hash)
+{
+    size_t mask, group, probe;
+
+    mask = obj->capacity / JX_HASH_GROUP - 1;
+    group = JX_HASH_H1(hash) & mask;
+
+    for (probe = 1; ; probe++) {
+        uint32_t match = jx_hash_match_free(obj->ctrl + group * JX_HASH_GROUP);
+
+        if (match != 0) {
+            return group * JX_HASH_GROUP + jx_ctz32(match);
+        }
+
+        group = (group + probe) & mask;
+    }
+}
+
+/* Rebuild the index with the given capacity, dropping the holes left by deleted entries
+ * along the way (the remaining ones keep their order, and their keys stay put). */
+bool jx_hash_rehash(jx_object *obj, size_t capacity)
+{
+    uint32_t *slots;
+    uint32_t i, j;
+
+    if ((slots = jx_mem_alloc(obj->arena, capacity * (sizeof(uint32_t) + 1))) == NULL) {
+        return false;
+    }
+
+    jx_mem_free(obj->arena, obj->slots);
+
+    obj->slots = slots;
+    obj->ctrl = (uint8_t *)(slots + capacity);
+    obj->capacity = capacity;
+    obj->growth_left = capacity - capacity / 8 - obj->length;
+
+    memset(obj->ctrl, JX_CTRL_EMPTY, capacity);
+
+    for (i = 0, j = 0; i < obj->n_entries; i++) {
+        jx_dict_entry *entry = &obj->entries[i];
+        size_t slot;
+
+        if (entry->value == NULL) {
+            continue;
+        }
+
+        slot = jx_hash_find_free(obj, entry->hash);
+
+        obj->ctrl[slot] = JX_HASH_H2(entry->hash);
+        obj->slots[slot] = j;
+
+        obj->entries[j++] = *entry;
+    }
+
+    obj->n_entries = j;
+
+    return true;
+}
+
+/* The capacity to rehash to before adding another entry: large enough that the index is
+ * at most about half full afterwards. */
+size_t jx_hash_capacity(jx_object *obj)
+{
+    size_t capacity = JX_HASH_GROUP;
+
+    while (capacity - capacity / 8 < (obj->length + 1) * 2) {
+        capacity *= 2;
+    }
+
+    return capacity;
+}
+
+/* Allocate an object block with room for the given number of entries and key bytes. */
+jx_object *jx_hash_alloc(jx_arena *arena, size_t entries_size, size_t keys_size)
+{
+    jx_object *obj;
+
+    obj = jx_mem_alloc(arena, sizeof(jx_object) + sizeof(jx_dict_entry) * entries_size + keys_size);
+
+    if (obj == NULL) {
+        return NULL;
+    }
+
+    memset(obj, 0, sizeof(jx_object));
+
+    obj->arena = arena;
+    obj->entries_size = entries_size;
+    obj->keys_size = keys_size;
+
+    return obj;
+}
+
+jx_object *jx_hash_new(jx_arena *arena, size_t keys_size)
+{
+    return jx_hash_alloc(arena, 4, keys_size);
+}
+
+char *jx_hash_keys(jx_object *obj)
+{
+    return (char *)(obj->entries + obj->entries_size);
+}
+
+/* Whether key is stored in the object's block, rather than shared from an intern table. */
+bool jx_hash_owns_key(jx_object *obj, const char *key)
+{
+    uintptr_t keys = (uintptr_t)jx_hash_keys(obj);
+
+    return (uintptr_t)key >= keys && (uintptr_t)key < keys + obj->keys_size;
+}
+
+/* Make room for one more entry, with key_size bytes of key to copy, by moving the object
+ * to a new block if needed. The live entries and keys are compacted along the way, and the new
+ * block is grown (if they would fill more than 3/4 of the old one) so that doing this
+ * stays amortized O(1) per entry. */
+bool jx_hash_reserve(jx_object **objp, size_t key_size)
+{
+    jx_object *obj = *objp, *new_obj;
+    size_t entries_size, keys_size, keys_length;
+    char *keys;
+    uint32_t i, j;
+
+    if (obj->n_entries < obj->entries_size && obj->keys_length + key_size <= obj->keys_size) {
+        return true;
+    }
+
+    keys_length = key_size;
+
+    for (i = 0; i < obj->n_entries; i++) {
+        if (obj->entries[i].value != NULL && jx_hash_owns_key(obj, obj->entries[i].key)) {
+            keys_length += obj->entries[i].length + 1;
+        }
+    }
+
+    for (entries_size = obj->entries_size; entries_size < (obj->length + 1) * 4 / 3; entries_size *= 2) {
+        continue;
+    }
+
+    /* Objects whose keys are all shared need no key bytes at all. */
+    if (keys_length == 0) {
+        keys_size = 0;
+    }
+    else {
+        for (keys_size = obj->keys_size ? obj->keys_size : 32; keys_size < keys_length * 4 / 3; keys_size *= 2) {
+            continue;
+        }
+    }
+
+    if ((new_obj = jx_hash_alloc(obj->arena, entries_size, keys_size)) == NULL) {
+        return false;
+    }
+
+    new_obj->intern = obj->intern;
+    new_obj->cache = obj->cache;
+    new_obj->length = obj->length;
+
+    keys = jx_hash_keys(new_obj);
+
+    for (i = 0, j = 0; i < obj->n_entries; i++) {
+        jx_dict_entry *entry = &new_obj->entries[j];
+
+        if (obj->entries[i].value == NULL) {
+            continue;
+        }
+
+        *entry = obj->entries[i];
+
+        if (jx_hash_owns_key(obj, entry->key)) {
+            entry->key = memcpy(keys + new_obj->keys_length, entry->key, entry->length + 1);
+            new_obj->keys_length += entry->length + 1;
+        }
+
+        j++;
+    }
+
+    new_obj->n_entries = j;
+
+    /* The entries have moved, so the index has to be rebuilt. */
+    if (obj->slots != NULL) {
+        if (!jx_hash_rehash(new_obj, obj->capacity)) {
+            jx_mem_free(obj->arena, new_obj);
+            return false;
+        }
+
+        jx_mem_free(obj->arena, obj->slots);
+    }
+
+    jx_mem_free(obj->arena, obj);
+
+    *objp = new_obj;
+
+    return true;
+}
+
+/* Find the entry for key, whose hash is only needed (and only has to be valid) once the
+ * object is indexed. */
+jx_dict_entry *jx_hash_find(jx_object *obj, const char *key, size_t length, uint32_t hash)
+{
+    size_t slot;
+
+    /* Flat objects have no holes, and are searched by length first. A key shared from
+     * an intern table is found by its address alone. */
+    if (obj->slots == NULL) {
+        uint32_t i;
+
+        for (i = 0; i < obj->n_entries; i++) {
+            jx_dict_entry *entry = &obj->entries[i];
+
+            if (entry->key == key || (entry->length == length && memcmp(entry->key, key, length) == 0)) {
+                return entry;
+            }
+        }
+
+        return NULL;
+    }
+
+    slot = jx_hash_find_slot(obj, key, length, hash);
+
+    if (slot == obj->capacity) {
+        return NULL;
+    }
+
+    return &obj->entries[obj->slots[slot]];
+}
+
+jx_dict_entry *jx_hash_get(jx_object *obj, const char *key, size_t length)
+{
+    return jx_hash_find(obj, key, length, obj->slots != NULL ? jx_hash_key(key, length) : 0);
+}
+
+/* Prepared keys have the layout of shared keys, but are allocated one at a time. */
+jx_key *jx_key_prepare_n(const char *key, size_t length)
+{
+    jx_key *prepared;
+
+    if (key == NULL || length > UINT32_MAX) {
+        return NULL;
+    }
+
+    if ((prepared = malloc(sizeof(jx_key) + length + 1)) == NULL) {
+        return NULL;
+    }
+
+    prepared->hash = jx_hash_key(key, length);
+    prepared->length = length;
+
+    memcpy(prepared->data, key, length);
+    prepared->data[length] = '\0';
+
+    return prepared;
+}
+
+jx_key *jx_key_prepare(const char *key)
+{
+    if (key == NULL) {
+        return NULL;
+    }
+
+    return jx_key_prepare_n(key, strlen(key));
+}
+
+void jx_key_free(jx_key *key)
+{
+    free(key);
+}
+
+/* Key intern tables.
+ *
+ * The parser shares the keys of the objects it builds through a table of immutable keys,
+ * so that a key repeated across many objects (the field names of a large array of
+ * records) is stored, and hashed, only once; looking such a key up in an object then
+ * comes down to comparing addresses. A heap table belongs to its context and keeps its
+ * keys for the documents that follow, and is freed once the context and every object
+ * using it are; since those objects may be freed from any thread, it is reference counted.
+ * An arena table lives, and is reset, with its arena, so its objects hold no reference.
+ *
+ * Tables are open-addressed with linear probing. Their size is bounded, so that the keys
+ * of documents like {"<id>": ...} don't pile up: once full (and for long keys), keys
+ * are simply copied into their objects again. */
+
+#define JX_INTERN_MAX_KEYS      16384
+#define JX_INTERN_MAX_LENGTH    64
+
+/* Heap tables are reference counted across threads; MSVC has no <stdatomic.h> in C. */
+#ifdef WIN32
+typedef volatile LONG64 jx_refcount;
+
+#define jx_refcount_init(refs)      (*(refs) = 1)
+#define jx_refcount_retain(refs)    InterlockedIncrement64(refs)
+#define jx_refcount_release(refs)   (InterlockedDecrement64(refs) == 0)
+#else
+typedef atomic_size_t jx_refcount;
+
+#define jx_refcount_init(refs)      atomic_init(refs, 1)
+#define jx_refcount_retain(refs)    atomic_fetch_add_explicit(refs, 1, memory_order_relaxed)
+#define jx_refcount_release(refs)   (atomic_fetch_sub_explicit(refs, 1, memory_order_acq_rel) == 1)
+#endif
+
+struct jx_intern_t
+{
+    /* The arena of an arena table, or NULL for a heap table. */
+    jx_arena *arena;
+
+    /* Where the keys are allocated: the table's own arena for a heap table. */
+    jx_arena *keys;
+
+    jx_refcount refs;
+
+    jx_key **slots;
+    uint32_t capacity, length;
+};
+
+jx_intern *jx_intern_alloc(jx_arena *arena)
+{
+    jx_intern *intern;
+
+    if ((intern = jx_mem_calloc(arena, sizeof(jx_intern))) == NULL) {
+        return NULL;
+    }
+
+    intern->arena = arena;
+    intern->keys = arena;
+    intern->capacity = 64;
+
+    jx_refcount_init(&intern->refs);
+
+    if ((intern->slots = jx_mem_calloc(arena, sizeof(jx_key *) * intern->capacity)) == NULL) {
+        jx_mem_free(arena, intern);
+        return NULL;
+    }
+
+    return intern;
+}
+
+/* A heap table, owned by the caller. */
+jx_intern *jx_intern_new()
+{
+    jx_intern *intern;
+
+    if ((intern = jx_intern_alloc(NULL)) == NULL) {
+        return NULL;
+    }
+
+    if ((intern->keys = jx_arena_new(4096)) == NULL) {
+        jx_intern_release(intern);
+        return NULL;
+    }
+
+    return intern;
+}
+
+/* The table of the arena, created on first use. */
+jx_intern *jx_intern_get(jx_arena *arena)
+{
+    jx_intern *intern = jx_arena_get_intern(arena);
+
+    if (intern == NULL && (intern = jx_intern_alloc(arena)) != NULL) {
+        jx_arena_set_intern(arena, intern);
+    }
+
+    return intern;
+}
+
+jx_intern *jx_intern_retain(jx_intern *intern)
+{
+    if (intern->arena == NULL) {
+        jx_refcount_retain(&intern->refs);
+    }
+
+    return intern;
+}
+
+void jx_intern_release(jx_intern *intern)
+{
+    if (intern == NULL || intern->arena != NULL) {
+        return;
+    }
+
+    if (jx_refcount_release(&intern->refs)) {
+        jx_arena_free(intern->keys);
+        free(intern->slots);
+        free(intern);
+    }
+}
+
+bool jx_intern_grow(jx_intern *intern)
+{
+    uint32_t capacity = intern->capacity * 2, i;
+    jx_key **slots;
+
+    if ((slots = jx_mem_calloc(intern->arena, sizeof(jx_key *) * capacity)) == NULL) {
+        return false;
+    }
+
+    for (i = 0; i < intern->capacity; i++) {
+        jx_key *key = intern->slots[i];
+        uint32_t slot;
+
+        if (key == NULL) {
+            continue;
+        }
+
+        for (slot = key->hash & (capacity - 1); slots[slot] != NULL; slot = (slot + 1) & (capacity - 1)) {
+            continue;
+        }
+
+        slots[slot] = key;
+    }
+
+    jx_mem_free(intern->arena, intern->slots);
+
+    intern->slots = slots;
+    intern->capacity = capacity;
+
+    return true;
+}
+
+/* Return the shared copy of key, adding it if there's room; NULL means the caller keeps
+ * a copy of its own. */
+jx_key *jx_intern_key(jx_intern *intern, const char *key, size_t length)
+{
+    jx_key *shared;
+    uint32_t hash, slot;
+
+    if (length > JX_INTERN_MAX_LENGTH) {
+        return NULL;
+    }
+
+    hash = jx_hash_key(key, length);
+
+    for (slot = hash & (intern->capacity - 1); intern->slots[slot] != NULL;
+        slot = (slot + 1) & (intern->capacity - 1)) {
+        shared = intern->slots[slot];
+
+        if (shared->hash == hash && shared->length == length && memcmp(shared->data, key, length) == 0) {
+            return shared;
+        }
+    }
+
+    if (intern->length == JX_INTERN_MAX_KEYS) {
+        return NULL;
+    }
+
+    /* Keep the table at most half full. */
+    if ((intern->length + 1) * 2 > intern->capacity) {
+        if (!jx_intern_grow(intern)) {
+            return NULL;
+        }
+
+        for (slot = hash & (intern->capacity - 1); intern->slots[slot] != NULL;
+            slot = (slot + 1) & (intern->capacity - 1)) {
+            continue;
+        }
+    }
+
+    if ((shared = jx_arena_alloc(intern->keys, sizeof(jx_key) + length + 1)) == NULL) {
+        return NULL;
+    }
+
+    shared->hash = hash;
+    shared->length = length;
+
+    memcpy(shared->data, key, length);
+    shared->data[length] = '\0';
+
+    intern->slots[slot] = shared;
+    intern->length++;
+
+    return shared;
+}
+
+/* Return the entry for key, adding one (with no value yet) if there isn't one. The key is
+ * shared from intern when it can be, and copied into the object otherwise. The object may
+ * move to a new block, in which case *objp is updated; the entry stays where it is until
+ * the next insert. */
+jx_dict_entry *jx_hash_insert(jx_object **objp, jx_intern *intern, const char *key, size_t length)
+{
+    jx_object *obj = *objp;
+    jx_dict_entry *entry;
+    jx_key *shared = NULL;
+    uint32_t hash = 0;
+    size_t slot = 0;
+
+    /* An object shares keys from one table at most, which it holds a reference to. */
+    if (intern != NULL && (obj->intern == NULL || obj->intern == intern)) {
+        if ((shared = jx_intern_key(intern, key, length)) != NULL) {
+            key = shared->data;
+            hash = shared->hash;
+        }
+    }
+
+    if (shared == NULL && obj->slots != NULL) {
+        hash = jx_hash_key(key, length);
+    }
+
+    if ((entry = jx_hash_find(obj, key, length, hash)) != NULL) {
+        return entry;
+    }
+
+    if (!jx_hash_reserve(objp, shared != NULL ? 0 : length + 1)) {
+        return NULL;
+    }
+
+    obj = *objp;
+
+    if (shared != NULL && obj->intern == NULL) {
+        obj->intern = jx_intern_retain(intern);
+    }
+
+    /* Index the object once it outgrows a linear search; until then the entries with
+     * keys of their own don't need hashing at all. */
+    if (obj->slots == NULL && obj->length == JX_DICT_FLAT_MAX) {
+        uint32_t i;
+
+        for (i = 0; i < obj->n_entries; i++) {
+            if (jx_hash_owns_key(obj, obj->entries[i].key)) {
+                obj->entries[i].hash = jx_hash_key(obj->entries[i].key, obj->entries[i].length);
+            }
+        }
+
+        if (!jx_hash_rehash(obj, jx_hash_capacity(obj))) {
+            return NULL;
+        }
+
+        if (shared == NULL) {
+            hash = jx_hash_key(key, length);
+        }
+    }
+
+    if (obj->slots != NULL) {
+        slot = jx_hash_find_free(obj, hash);
+
+        /* Reusing a deleted slot is always fine, but an empty one must be paid for. */
+        if (obj->ctrl[slot] == JX_CTRL_EMPTY && obj->growth_left == 0) {
+            if (!jx_hash_rehash(obj, jx_hash_capacity(obj))) {
+                return NULL;
+            }
+
+            slot = jx_hash_find_free(obj, hash);
+        }
+
+        if (obj->ctrl[slot] == JX_CTRL_EMPTY) {
+            obj->growth_left--;
+        }
+
+        obj->ctrl[slot] = JX_HASH_H2(hash);
+        obj->slots[slot] = obj->n_entries;
+    }
+
+    entry = &obj->entries[obj->n_entries++];
+
+    if (shared != NULL) {
+        entry->key = shared->data;
+    }
+    else {
+        entry->key = memcpy(jx_hash_keys(obj) + obj->keys_length, key, length);
+        entry->key[length] = '\0';
+
+        obj->keys_length += length + 1;
+    }
+
+    entry->length = length;
+    entry->hash = hash;
+    entry->value = NULL;
+
+    obj->length++;
+
+    return entry;
+}
+
+/* Remove the entry for key, returning its value (which is not freed). */
+jx_value *jx_hash_del(jx_object *obj, const char *key, size_t length)
+{
+    jx_dict_entry *entry;
+    jx_value *value;
+    size_t slot;
+
+    if (obj->slots == NULL) {
+        if ((entry = jx_hash_get(obj, key, length)) == NULL) {
+            return NULL;
+        }
+
+        value = entry->value;
+
+        obj->n_entries--;
+        obj->length--;
+
+        memmove(entry, entry + 1, (char *)(obj->entries + obj->n_entries) - (char *)entry);
+
+        return value;
+    }
+
+    if ((slot = jx_hash_find_slot(obj, key, length, jx_hash_key(key, length))) == obj->capacity) {
+        return NULL;
+    }
+
+    entry = &obj->entries[obj->slots[slot]];
+    value = entry->value;
+
+    entry->key = NULL;
+    entry->value = NULL;
+
+    /* No probe sequence continues past a group with an empty slot, so the slot can be
+     * emptied (rather than marked deleted) if its group already has one. */
+    if (jx_hash_match(obj->ctrl + slot - slot % JX_HASH_GROUP, JX_CTRL_EMPTY) != 0) {
+        obj->ctrl[slot] = JX_CTRL_EMPTY;
+        obj->growth_left++;
+    }
+    else {
+        obj->ctrl[slot] = JX_CTRL_DELETED;
+    }
+
+    obj->length--;
+
+    while (obj->n_entries > 0 && obj->entries[obj->n_entries - 1].value == NULL) {
+        obj->n_entries--;
+    }
+
+    return value;
+}
+
+/* Free the values and the index of a heap object (but not the object itself). */
+void jx_hash_free(jx_object *obj)
+{
+    uint32_t i;
+
+    for (i = 0; i < obj->n_entries; i++) {
+        jxv_free(obj->entries[i].value);
+    }
+
+    free(obj->slots);
+
+    jx_intern_release(obj->intern);
+}
@@ -47,9 +47,12 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <math.h>
 
 #include <jx.h>
 #include <jx_util.h>
+#include <jx_simd.h>
+#include <jx_number.h>
 
 #define JX_ARRAY_STATE_DEFAULT                  0
 #define JX_ARRAY_STATE_NEW_MEMBER               1
@@ -70,7 +73,7 @@
 #define JX_NUM_HAS_DIGITS                       (1 << 5)
 #define JX_NUM_HAS_DEC_PT                       (1 << 6)
 #define JX_NUM_HAS_EXP                          (1 << 7)
-#define JX_NUM_DEFAULT                          JX_NUM_ACCEPT_SIGN | JX_NUM_ACCEPT_DIGITS
+#define JX_NUM_DEFAULT                          (JX_NUM_ACCEPT_SIGN | JX_NUM_ACCEPT_DIGITS)
 
 #define JX_STRING_ESCAPE                        (1 << 0)
 #define JX_STRING_UTF8                          (1 << 1)
@@ -80,6 +83,11 @@
 
 #define JX_DEFAULT_OBJECT_STACK_SIZE            8
 #define JX_DEFAULT_ARRAY_SIZE                   8
+#define JX_DEFAULT_STRING_BUF_SIZE              64
+
+/* Keys read in a document before the rest are shared through an intern table; small
+ * documents aren't worth one. */
+#define JX_INTERN_MIN_KEYS                      64
 
 static const char * const jx_error_messages[JX_ERROR_GUARD] =
 {
@@ -92,7 +100,8 @@ static const char * const jx_error_messages[JX_ERROR_GUARD] =
     "Syntax Error [%lu:%lu]: Unexpected token (%s).",
     "Syntax Error [%lu:%lu]: Illegal token (%s).",
     "Syntax Error [%lu:%lu]: Illegal value type for key in object, member keys must be of type string.",
-    "Syntax Error [%lu:%lu]: Incomplete JSON object."
+    "Syntax Error [%lu:%lu]: Incomplete JSON object.",
+    "Parsing aborted by callback [%lu:%lu]."
 };
 
 jx_cntx *jx_new()
@@ -103,11 +112,13 @@ jx_cntx *jx_new()
         return NULL;
     }
 
-    if ((cntx->object_stack = jxa_new(JX_DEFAULT_OBJECT_STACK_SIZE)) == NULL) {
+    if ((cntx->frames = malloc(sizeof(jx_frame) * JX_DEFAULT_OBJECT_STACK_SIZE)) == NULL) {
         free(cntx);
         return NULL;
     }
 
+    cntx->frames_size = JX_DEFAULT_OBJECT_STACK_SIZE;
+
     cntx->line = 1;
     cntx->col = 1;
     cntx->tab_stop_width = 4;
@@ -116,12 +127,16 @@ jx_cntx *jx_new()
     return cntx;
 }
 
-void jx_free(jx_cntx *cntx)
+void jx_reset(jx_cntx *cntx)
 {
     if (cntx == NULL) {
         return;
     }
 
+    if (cntx->async != NULL) {
+        cntx->async_cancel(cntx);
+    }
+
     while (jx_get_mode(cntx) != JX_MODE_UNDEFINED) {
         jx_frame *frame;
 
@@ -142,7 +157,41 @@ void jx_free(jx_cntx *cntx)
         jx_pop_mode(cntx);
     }
 
-    jxv_free(cntx->object_stack);
+    /* Everything describing the document being parsed goes back to its initial state; the
+     * settings (tab width, extensions) and the buffers grown so far are kept for reuse. */
+    cntx->line = 1;
+    cntx->col = 1;
+    cntx->depth = 0;
+
+    cntx->code_index = 0;
+    cntx->shifts = 0;
+    cntx->tok_buf_pos = 0;
+    cntx->str_buf_len = 0;
+    cntx->uni_tok_len = 0;
+    cntx->n_keys = 0;
+    cntx->uni_tok_i = 0;
+
+    cntx->inside_token = false;
+    cntx->find_next_token = false;
+    cntx->locked = false;
+
+    cntx->error_msg[0] = '\0';
+    cntx->error = JX_ERROR_NONE;
+}
+
+void jx_free(jx_cntx *cntx)
+{
+    if (cntx == NULL) {
+        return;
+    }
+
+    jx_reset(cntx);
+
+    free(cntx->frames);
+
+    free(cntx->str_buf);
+
+    jx_intern_release(cntx->intern);
 
     free(cntx);
 }
@@ -204,49 +253,86 @@ void jx_set_extensions(jx_cntx *cntx, jx_ext_set ext)
     cntx->ext = ext;
 }
 
+/* Allocate the values of subsequent documents from arena (or from the heap, if arena
+ * is NULL); those values are released by jx_arena_reset() instead of jxv_free(). */
+void jx_set_arena(jx_cntx *cntx, jx_arena *arena)
+{
+    if (cntx == NULL || cntx->locked) {
+        return;
+    }
+
+    cntx->arena = arena;
+}
+
+/* Report the document through handlers instead of building a tree; jx_get_result() then
+ * returns NULL once the document is complete. Passing NULL restores the default. */
+void jx_set_handlers(jx_cntx *cntx, const jx_handlers *handlers, void *user)
+{
+    if (cntx == NULL || cntx->locked) {
+        return;
+    }
+
+    if (handlers == NULL) {
+        memset(&cntx->handlers, 0, sizeof(jx_handlers));
+    }
+    else {
+        cntx->handlers = *handlers;
+    }
+
+    cntx->user = user;
+    cntx->callbacks = handlers != NULL;
+}
+
 jx_frame *jx_top(jx_cntx *cntx)
 {
-    if (cntx == NULL) {
+    if (cntx == NULL || cntx->n_frames == 0) {
         return NULL;
     }
 
-    return jxv_get_ptr(jxa_top(cntx->object_stack));
+    return &cntx->frames[cntx->n_frames - 1];
 }
 
+/* Frames live in a contiguous array owned by the context, so entering and leaving a
+ * value is a pointer bump; the array only grows (doubling) when the nesting depth
+ * exceeds anything seen before. Growing may move the frames, so callers must not hold
+ * a frame pointer across a push. */
 bool jx_push_mode(jx_cntx *cntx, jx_mode mode)
 {
     jx_frame *frame;
 
-    if (cntx == NULL || cntx->object_stack == NULL) {
+    if (cntx == NULL || cntx->frames == NULL) {
         return false;
     }
 
-    if ((frame = calloc(1, sizeof(jx_frame))) == NULL) {
-        jx_set_error(cntx, JX_ERROR_LIBC);
-        return false;
-    }
+    if (cntx->n_frames == cntx->frames_size) {
+        size_t size = cntx->frames_size * 2;
+        jx_frame *frames;
 
-    frame->mode = mode;
+        if ((frames = realloc(cntx->frames, sizeof(jx_frame) * size)) == NULL) {
+            jx_set_error(cntx, JX_ERROR_LIBC);
+            return false;
+        }
 
-    if (!jxa_push_ptr(cntx->object_stack, frame)) {
-        free(frame);
-        return false;
+        cntx->frames = frames;
+        cntx->frames_size = size;
     }
 
+    frame = &cntx->frames[cntx->n_frames++];
+
+    memset(frame, 0, sizeof(jx_frame));
+
+    frame->mode = mode;
+
     return true;
 }
 
 void jx_pop_mode(jx_cntx *cntx)
 {
-    jx_value *value;
-
-    if (cntx == NULL || cntx->object_stack == NULL) {
+    if (cntx == NULL || cntx->n_frames == 0) {
         return;
     }
 
-    value = jxa_pop(cntx->object_stack);
-
-    jxv_free(value);
+    cntx->n_frames--;
 }
 
 void jx_set_mode(jx_cntx *cntx, jx_mode mode)
@@ -349,6 +435,214 @@ jx_value *jx_get_return(jx_cntx *cntx)
     return frame->return_value;
 }
 
+/* The value constructors used by the parser: in callback mode they invoke the matching
+ * handler and return a placeholder, so that the array and object state machines work
+ * unchanged. On failure the error is set and NULL is returned. */
+bool jx_callback_result(jx_cntx *cntx, bool ok)
+{
+    if (!ok) {
+        jx_set_error(cntx, JX_ERROR_ABORTED, cntx->line, cntx->col);
+    }
+
+    return ok;
+}
+
+/* A number read inside an array is added to it right away, so that arrays of numbers
+ * stay packed (see jx_array); the array then skips the placeholder returned for it. */
+jx_value *jx_new_number(jx_cntx *cntx, double num)
+{
+    jx_frame *parent = cntx->n_frames > 1 ? &cntx->frames[cntx->n_frames - 2] : NULL;
+    jx_value *value;
+
+    if (cntx->callbacks) {
+        if (cntx->handlers.number != NULL &&
+            !jx_callback_result(cntx, cntx->handlers.number(cntx->user, num))) {
+            return NULL;
+        }
+
+        return jxv_placeholder(JX_TYPE_NUMBER);
+    }
+
+    if (parent != NULL && parent->mode == JX_MODE_PARSE_ARRAY) {
+        if (!jxa_push_number(parent->value, num)) {
+            jx_set_error(cntx, JX_ERROR_LIBC);
+            return NULL;
+        }
+
+        return jxv_placeholder(JX_TYPE_NUMBER);
+    }
+
+    if ((value = jxv_number_new_arena(cntx->arena, num)) == NULL) {
+        jx_set_error(cntx, JX_ERROR_LIBC);
+    }
+
+    return value;
+}
+
+jx_value *jx_new_int(jx_cntx *cntx, int64_t num)
+{
+    jx_frame *parent = cntx->n_frames > 1 ? &cntx->frames[cntx->n_frames - 2] : NULL;
+    jx_value *value;
+
+    if (cntx->callbacks) {
+        bool ok = true;
+
+        if (cntx->handlers.integer != NULL) {
+            ok = cntx->handlers.integer(cntx->user, num);
+        }
+        else if (cntx->handlers.number != NULL) {
+            ok = cntx->handlers.number(cntx->user, (double)num);
+        }
+
+        if (!jx_callback_result(cntx, ok)) {
+            return NULL;
+        }
+
+        return jxv_placeholder(JX_TYPE_NUMBER);
+    }
+
+    if (parent != NULL && parent->mode == JX_MODE_PARSE_ARRAY) {
+        if (!jxa_push_int(parent->value, num)) {
+            jx_set_error(cntx, JX_ERROR_LIBC);
+            return NULL;
+        }
+
+        return jxv_placeholder(JX_TYPE_NUMBER);
+    }
+
+    if ((value = jxv_int_new_arena(cntx->arena, num)) == NULL) {
+        jx_set_error(cntx, JX_ERROR_LIBC);
+    }
+
+    return value;
+}
+
+/* A string read where the enclosing object is waiting for a key is added to the object
+ * right away (or reported as a key, in callback mode); the object then checks the
+ * placeholder's type, as it would for a real value, and stores the value that follows
+ * in the slot it was given for the key. */
+jx_value *jx_new_string(jx_cntx *cntx, const char *str, size_t length)
+{
+    jx_frame *parent = cntx->n_frames > 1 ? &cntx->frames[cntx->n_frames - 2] : NULL;
+    jx_value *value;
+
+    bool key = parent != NULL && parent->mode == JX_MODE_PARSE_OBJECT &&
+        (parent->state & JX_OBJ_STATE_ACCEPT_KEY);
+
+    if (cntx->callbacks) {
+        if (key) {
+            if (cntx->handlers.key != NULL &&
+                !jx_callback_result(cntx, cntx->handlers.key(cntx->user, str, length))) {
+                return NULL;
+            }
+        }
+        else if (cntx->handlers.string != NULL &&
+            !jx_callback_result(cntx, cntx->handlers.string(cntx->user, str, length))) {
+            return NULL;
+        }
+
+        return jxv_placeholder(JX_TYPE_STRING);
+    }
+
+    if (key) {
+        jx_intern *intern = NULL;
+
+        /* Keys are shared through the arena's intern table, or else the context's own,
+         * which carries over from one document to the next. */
+        if (++cntx->n_keys > JX_INTERN_MIN_KEYS) {
+            if (cntx->arena != NULL) {
+                intern = jx_intern_get(cntx->arena);
+            }
+            else {
+                if (cntx->intern == NULL) {
+                    cntx->intern = jx_intern_new();
+                }
+
+                intern = cntx->intern;
+            }
+        }
+
+        if ((parent->slot = jxd_put_key(parent->value, intern, str, length)) == NULL) {
+            jx_set_error(cntx, JX_ERROR_LIBC);
+            return NULL;
+        }
+
+        return jxv_placeholder(JX_TYPE_STRING);
+    }
+
+    if ((value = jxs_new_n_arena(cntx->arena, str, length)) == NULL) {
+        jx_set_error(cntx, JX_ERROR_LIBC);
+    }
+
+    return value;
+}
+
+bool jx_set_keyword(jx_cntx *cntx, jx_value *value)
+{
+    if (cntx->callbacks) {
+        bool ok = true;
+
+        if (jxv_is_null(value)) {
+            if (cntx->handlers.null != NULL) {
+                ok = cntx->handlers.null(cntx->user);
+            }
+        }
+        else if (cntx->handlers.boolean != NULL) {
+            ok = cntx->handlers.boolean(cntx->user, jxv_get_bool(value));
+        }
+
+        if (!jx_callback_result(cntx, ok)) {
+            return false;
+        }
+    }
+
+    jx_set_value(cntx, value);
+
+    return true;
+}
+
+jx_value *jx_new_container(jx_cntx *cntx, jx_type type)
+{
+    jx_value *value;
+
+    if (cntx->callbacks) {
+        bool (*handler)(void *) =
+            type == JX_TYPE_ARRAY ? cntx->handlers.start_array : cntx->handlers.start_object;
+
+        if (handler != NULL && !jx_callback_result(cntx, handler(cntx->user))) {
+            return NULL;
+        }
+
+        return jxv_placeholder(type);
+    }
+
+    if (type == JX_TYPE_ARRAY) {
+        value = jxa_new_arena(cntx->arena, JX_DEFAULT_ARRAY_SIZE);
+    }
+    else {
+        value = jxd_new_keys(cntx->arena, cntx->n_keys < JX_INTERN_MIN_KEYS ? 32 : 0);
+    }
+
+    if (value == NULL) {
+        jx_set_error(cntx, JX_ERROR_LIBC);
+    }
+
+    return value;
+}
+
+bool jx_end_container(jx_cntx *cntx, jx_mode mode)
+{
+    bool (*handler)(void *);
+
+    if (!cntx->callbacks) {
+        return true;
+    }
+
+    handler = mode == JX_MODE_PARSE_ARRAY ? cntx->handlers.end_array : cntx->handlers.end_object;
+
+    return handler == NULL || jx_callback_result(cntx, handler(cntx->user));
+}
+
 bool jx_utf16_surrogate(uint16_t value)
 {
     return value >= 0xD800 && value <= 0xDFFF;
@@ -494,10 +788,68 @@ bool jx_unicode_to_utf8(char out[5], int code_point)
     return true;
 }
 
-long jx_find_token(jx_cntx *cntx, const char *src, long pos, long end_pos)
+void jx_advance_tab(jx_cntx *cntx)
+{
+    while ((++cntx->col - 1) % cntx->tab_stop_width)
+        ;
+}
+
+#ifdef JX_SIMD_WIDTH
+/* Consume whitespace one block at a time. Lines are counted with a popcount of
+ * the newline mask, and the column is recomputed from the offset of the last
+ * newline in the run; only the spaces/tabs after that newline are walked one
+ * at a time, and only if they contain a tab.
+ *
+ * Returns the number of bytes of whitespace consumed, if this is less than
+ * JX_SIMD_WIDTH the byte at that offset is the start of a token. */
+int jx_skip_whitespace_block(jx_cntx *cntx, const char *src)
 {
-    int tab_width;
+    uint32_t ws, nl, tab, run_mask;
+    int run, start, i;
+
+    ws = jx_simd_whitespace(src, &nl, &tab);
+
+    if (ws == 0xFFFFFFFF) {
+        run = 32;
+        run_mask = ws;
+    }
+    else {
+        run = jx_ctz32(~ws);
+        run_mask = (1u << run) - 1;
+    }
+
+    nl &= run_mask;
+    tab &= run_mask;
+
+    start = 0;
+
+    if (nl) {
+        cntx->line += jx_popcount32(nl);
+        cntx->col = 1;
+
+        start = jx_msb32(nl) + 1;
+    }
+
+    if (start < 32 && (tab >> start) != 0) {
+        for (i = start; i < run; i++) {
+            if (src[i] == '\t') {
+                jx_advance_tab(cntx);
+            }
+            else {
+                cntx->col++;
+            }
+        }
+    }
+    else {
+        cntx->col += run - start;
+    }
+
+    return run;
+}
+#endif
 
+long jx_find_token(jx_cntx *cntx, const char *src, long pos, long end_pos)
+{
     if (cntx == NULL) {
         return -1;
     }
@@ -506,7 +858,17 @@ long jx_find_token(jx_cntx *cntx, const char *src, long pos, long end_pos)
         return pos;
     }
 
-    tab_width = cntx->tab_stop_width;
+#ifdef JX_SIMD_WIDTH
+    while (end_pos - pos + 1 >= JX_SIMD_WIDTH) {
+        int n = jx_skip_whitespace_block(cntx, src + pos);
+
+        pos += n;
+
+        if (n < JX_SIMD_WIDTH) {
+            return pos;
+        }
+    }
+#endif
 
     while (pos <= end_pos) {
         if (src[pos] == ' ') {
@@ -514,9 +876,7 @@ long jx_find_token(jx_cntx *cntx, const char *src, long pos, long end_pos)
             pos++;
         }
         else if (src[pos] == '\t') {
-            while ((++cntx->col - 1) % tab_width)
-                ;
-
+            jx_advance_tab(cntx);
             pos++;
         }
         else if (src[pos] == '\n' || src[pos] == '\v') {
@@ -585,10 +945,10 @@ jx_utoken jx_unicode_token_type(jx_cntx *cntx)
     return JX_UNI_UNSUPPORTED;
 }
 
-jx_value *jx_unicode_token_object(jx_utoken type)
+jx_value *jx_unicode_token_object(jx_cntx *cntx, jx_utoken type)
 {
     if (type == JX_UNI_LOWER_PI) {
-        return jxv_number_new(3.14159);
+        return jx_new_number(cntx, 3.14159);
     }
 
     return NULL;
@@ -655,7 +1015,7 @@ long jx_parse_array(jx_cntx *cntx, const char *src, long pos, long end_pos, bool
     if (ret != NULL) {
         jx_value *array = jx_get_value(cntx);
 
-        if (!jxa_push(array, ret)) {
+        if (!cntx->callbacks && !jxv_is_placeholder(ret) && !jxa_push(array, ret)) {
             jx_set_error(cntx, JX_ERROR_LIBC);
             return -1;
         }
@@ -781,18 +1141,12 @@ long jx_parse_object(jx_cntx *cntx, const char *src, long pos, long end_pos, boo
             jx_set_return(cntx, NULL);
         }
         else if (state & JX_OBJ_STATE_ACCEPT_VALUE) {
-            jx_value *obj = jx_get_value(cntx);
-
-            char *key_str = jxs_get_str(frame->key);
-
-            if (!jxd_put(obj, key_str, value)) {
-                jx_set_error(cntx, JX_ERROR_LIBC);
-                return -1;
+            if (!cntx->callbacks) {
+                *frame->slot = value;
             }
 
-            jxv_free(frame->key);
-
             frame->key = NULL;
+            frame->slot = NULL;
 
             jx_set_state(cntx, JX_OBJ_STATE_ACCEPT_MEMBER_DELIMITER | JX_OBJ_STATE_ACCEPT_CLOSE);
 
@@ -857,6 +1211,52 @@ long jx_parse_object(jx_cntx *cntx, const char *src, long pos, long end_pos, boo
     return pos;
 }
 
+/* Strings are accumulated in a buffer owned by the context, which is reused for
+ * every string in the document, the final value is then allocated at its exact
+ * size once the closing quote has been found. */
+bool jx_string_buf_append(jx_cntx *cntx, const char *src, size_t n)
+{
+    if (cntx->str_buf_len + n > cntx->str_buf_size) {
+        size_t new_size;
+        char *new_buf;
+
+        new_size = (cntx->str_buf_size > 0) ? cntx->str_buf_size : JX_DEFAULT_STRING_BUF_SIZE;
+
+        while (new_size < cntx->str_buf_len + n) {
+            new_size *= 2;
+        }
+
+        if ((new_buf = realloc(cntx->str_buf, new_size)) == NULL) {
+            jx_set_error(cntx, JX_ERROR_LIBC);
+            return false;
+        }
+
+        cntx->str_buf = new_buf;
+        cntx->str_buf_size = new_size;
+    }
+
+    memcpy(cntx->str_buf + cntx->str_buf_len, src, n);
+
+    cntx->str_buf_len += n;
+
+    return true;
+}
+
+bool jx_string_buf_push(jx_cntx *cntx, char c)
+{
+    if (cntx->str_buf_len < cntx->str_buf_size) {
+        cntx->str_buf[cntx->str_buf_len++] = c;
+        return true;
+    }
+
+    return jx_string_buf_append(cntx, &c, 1);
+}
+
+/* Numbers that lie entirely within the current chunk are validated and
+ * converted in one pass by jx_number_read(). Otherwise (or if the number is
+ * malformed, in which case we want the precise error) the number is validated
+ * a character at a time and its text accumulated in the context's string
+ * buffer, so that it can be resumed with the next chunk of input. */
 long jx_parse_number(jx_cntx *cntx, const char *src, long pos, long end_pos, bool *done)
 {
     jx_frame *frame;
@@ -864,6 +1264,8 @@ long jx_parse_number(jx_cntx *cntx, const char *src, long pos, long end_pos, boo
 
     char c;
 
+    long start;
+
     bool symbol_end = false;
 
     if (cntx == NULL || src == NULL || done == NULL) {
@@ -880,6 +1282,45 @@ long jx_parse_number(jx_cntx *cntx, const char *src, long pos, long end_pos, boo
 
     state = frame->state;
 
+    if (state == JX_NUM_DEFAULT) {
+        int64_t integer;
+        double num;
+        long n;
+
+        /* Integers are accumulated exactly, and everything else converted to a double. */
+        n = jx_number_read_int(src + pos, end_pos - pos + 1, &integer);
+
+        if (n > 0 && pos + n <= end_pos && !jx_number_char(src[pos + n])) {
+            if ((frame->value = jx_new_int(cntx, integer)) == NULL) {
+                return -1;
+            }
+
+            cntx->col += n;
+
+            *done = true;
+
+            return pos + n;
+        }
+
+        n = jx_number_read(src + pos, end_pos - pos + 1, &num);
+
+        if (n > 0 && pos + n <= end_pos && !jx_number_char(src[pos + n])) {
+            if ((frame->value = jx_new_number(cntx, num)) == NULL) {
+                return -1;
+            }
+
+            cntx->col += n;
+
+            *done = true;
+
+            return pos + n;
+        }
+
+        cntx->str_buf_len = 0;
+    }
+
+    start = pos;
+
     while (pos <= end_pos) {
         c = src[pos];
 
@@ -939,28 +1380,28 @@ long jx_parse_number(jx_cntx *cntx, const char *src, long pos, long end_pos, boo
             break;
         }
 
-        if (cntx->tok_buf_pos == JX_TOKEN_BUF_SIZE - 1) {
-            jx_set_error(cntx, JX_ERROR_ILLEGAL_TOKEN, cntx->line, cntx->col,
-                "number too large");
-            return -1;
-        }
-
-        cntx->tok_buf[cntx->tok_buf_pos++] = src[pos++];
+        pos++;
 
         cntx->col++;
     }
 
+    if (!jx_string_buf_append(cntx, src + start, pos - start)) {
+        return -1;
+    }
+
     if (symbol_end) {
         if (state & JX_NUM_IS_VALID) {
             jx_value *number;
+            int64_t integer;
 
-            cntx->tok_buf[cntx->tok_buf_pos] = '\0';
-            cntx->tok_buf_pos = 0;
-
-            number = jxv_number_new(strtod(cntx->tok_buf, NULL));
+            if (jx_number_read_int(cntx->str_buf, cntx->str_buf_len, &integer) == (long)cntx->str_buf_len) {
+                number = jx_new_int(cntx, integer);
+            }
+            else {
+                number = jx_new_number(cntx, jx_number_convert(cntx->str_buf, cntx->str_buf_len));
+            }
 
             if (number == NULL) {
-                jx_set_error(cntx, JX_ERROR_LIBC);
                 return -1;
             }
 
@@ -980,6 +1421,35 @@ long jx_parse_number(jx_cntx *cntx, const char *src, long pos, long end_pos, boo
     return pos;
 }
 
+/* Return the length of the run of bytes at the start of src that can be copied
+ * into a string verbatim, i.e. printable ASCII other than a quote or backslash. */
+long jx_scan_string(const unsigned char *src, long n)
+{
+    long i = 0;
+
+#ifdef JX_SIMD_WIDTH
+    while (i + JX_SIMD_WIDTH <= n) {
+        uint32_t special = jx_simd_string_special((const char *)src + i);
+
+        if (special) {
+            return i + jx_ctz32(special);
+        }
+
+        i += JX_SIMD_WIDTH;
+    }
+#endif
+
+    while (i < n) {
+        if (src[i] < 0x20 || src[i] > 0x7e || src[i] == '"' || src[i] == '\\') {
+            break;
+        }
+
+        i++;
+    }
+
+    return i;
+}
+
 long jx_parse_unicode_seq(jx_cntx *cntx, const char *src, long pos, long end_pos, bool *done)
 {
     jx_state state;
@@ -1073,10 +1543,10 @@ long jx_parse_unicode_seq(jx_cntx *cntx, const char *src, long pos, long end_pos
             if (code_point >= 0x20 && code_point != 0x7f) {
                 char utf8_buf[5];
 
-                jx_value * str = jx_get_value(cntx);
-
                 if (jx_unicode_to_utf8(utf8_buf, code_point)) {
-                    jxs_append_str(str, utf8_buf);
+                    if (!jx_string_buf_append(cntx, utf8_buf, strlen(utf8_buf))) {
+                        return -1;
+                    }
                 }
                 else {
                     jx_set_error(cntx, JX_ERROR_ILLEGAL_TOKEN, cntx->line, cntx->col,
@@ -1106,7 +1576,6 @@ long jx_parse_unicode_seq(jx_cntx *cntx, const char *src, long pos, long end_pos
 long jx_parse_string(jx_cntx *cntx, const char *src, long pos, long end_pos, bool *done)
 {
     jx_frame *frame;
-    jx_value *str;
 
     unsigned char *buf;
 
@@ -1114,6 +1583,8 @@ long jx_parse_string(jx_cntx *cntx, const char *src, long pos, long end_pos, boo
 
     bool escape_done;
 
+    char c;
+
     if (cntx == NULL || src == NULL || done == NULL) {
         return -1;
     }
@@ -1128,9 +1599,41 @@ long jx_parse_string(jx_cntx *cntx, const char *src, long pos, long end_pos, boo
 
     buf = (unsigned char *)src;
     state = frame->state;
-    str = frame->value;
 
     while (pos <= end_pos) {
+        if (state == 0) {
+            long n = jx_scan_string(buf + pos, end_pos - pos + 1);
+
+            /* The whole string is in this chunk and needs no unescaping: use it in place
+             * rather than copying it through the string buffer. */
+            if (cntx->str_buf_len == 0 && pos + n <= end_pos && buf[pos + n] == '"') {
+                if ((frame->value = jx_new_string(cntx, src + pos, n)) == NULL) {
+                    return -1;
+                }
+
+                cntx->col += n + 1;
+
+                frame->state = JX_STRING_END;
+
+                *done = true;
+
+                return pos + n + 1;
+            }
+
+            if (n > 0) {
+                if (!jx_string_buf_append(cntx, src + pos, n)) {
+                    return -1;
+                }
+
+                pos += n;
+                cntx->col += n;
+
+                if (pos > end_pos) {
+                    break;
+                }
+            }
+        }
+
         if (state & JX_STRING_ESCAPE) {
             if (buf[pos] != 'u' && (state & JX_STRING_SURROGATE)) {
                 jx_set_error(   cntx, JX_ERROR_ILLEGAL_TOKEN, cntx->line, cntx->col,
@@ -1139,26 +1642,28 @@ long jx_parse_string(jx_cntx *cntx, const char *src, long pos, long end_pos, boo
                 return -1;
             }
 
+            c = '\0';
+
             switch (buf[pos]) {
                 case '"':
                 case '\\':
                 case '/':
-                    jxs_append_chr(str, buf[pos]);
+                    c = buf[pos];
                     break;
                 case 'b':
-                    jxs_append_chr(str, '\b');
+                    c = '\b';
                     break;
                 case 'f':
-                    jxs_append_chr(str, '\f');
+                    c = '\f';
                     break;
                 case 'n':
-                    jxs_append_chr(str, '\n');
+                    c = '\n';
                     break;
                 case 'r':
-                    jxs_append_chr(str, '\r');
+                    c = '\r';
                     break;
                 case 't':
-                    jxs_append_chr(str, '\t');
+                    c = '\t';
                     break;
                 case 'u':
                     state |= JX_STRING_UNICODE;
@@ -1170,6 +1675,10 @@ long jx_parse_string(jx_cntx *cntx, const char *src, long pos, long end_pos, boo
                     return -1;
             }
 
+            if (c != '\0' && !jx_string_buf_push(cntx, c)) {
+                return -1;
+            }
+
             state &= ~JX_STRING_ESCAPE;
         }
         else if (state & JX_STRING_UTF8) {
@@ -1180,7 +1689,9 @@ long jx_parse_string(jx_cntx *cntx, const char *src, long pos, long end_pos, boo
                     return -1;
                 }
 
-                jxs_append_chr(str, buf[pos++]);
+                if (!jx_string_buf_push(cntx, buf[pos++])) {
+                    return -1;
+                }
 
                 if (--cntx->uni_tok_len == 0) {
                     state &= ~JX_STRING_UTF8;
@@ -1230,7 +1741,9 @@ long jx_parse_string(jx_cntx *cntx, const char *src, long pos, long end_pos, boo
                     return -1;
                 }
 
-                jxs_append_chr(str, buf[pos++]);
+                if (!jx_string_buf_push(cntx, buf[pos++])) {
+                    return -1;
+                }
 
                 len--;
 
@@ -1245,7 +1758,9 @@ long jx_parse_string(jx_cntx *cntx, const char *src, long pos, long end_pos, boo
             }
             else {
                 if (buf[pos] >= 0x20 && buf[pos] <= 0x7e) {
-                    jxs_append_chr(str, buf[pos]);
+                    if (!jx_string_buf_push(cntx, buf[pos])) {
+                        return -1;
+                    }
                 }
                 else {
                     jx_set_error(   cntx, JX_ERROR_ILLEGAL_TOKEN, cntx->line, cntx->col,
@@ -1259,6 +1774,10 @@ long jx_parse_string(jx_cntx *cntx, const char *src, long pos, long end_pos, boo
         cntx->col++;
 
         if (state == JX_STRING_END) {
+            if ((frame->value = jx_new_string(cntx, cntx->str_buf, cntx->str_buf_len)) == NULL) {
+                return -1;
+            }
+
             *done = true;
             break;
         }
@@ -1289,7 +1808,9 @@ long jx_parse_keyword(jx_cntx *cntx, const char *src, long pos, long end_pos, bo
         }
 
         if (strcmp(cntx->tok_buf, "null") == 0) {
-            jx_set_value(cntx, jxv_null());
+            if (!jx_set_keyword(cntx, jxv_null())) {
+                return -1;
+            }
 
             cntx->col += cntx->tok_buf_pos;
 
@@ -1298,7 +1819,9 @@ long jx_parse_keyword(jx_cntx *cntx, const char *src, long pos, long end_pos, bo
             break;
         }
         else if (strcmp(cntx->tok_buf, "true") == 0) {
-            jx_set_value(cntx, jxv_bool_new(true));
+            if (!jx_set_keyword(cntx, jxv_bool_new(true))) {
+                return -1;
+            }
 
             cntx->col += cntx->tok_buf_pos;
 
@@ -1307,7 +1830,9 @@ long jx_parse_keyword(jx_cntx *cntx, const char *src, long pos, long end_pos, bo
             break;
         }
         else if (strcmp(cntx->tok_buf, "false") == 0) {
-            jx_set_value(cntx, jxv_bool_new(false));
+            if (!jx_set_keyword(cntx, jxv_bool_new(false))) {
+                return -1;
+            }
 
             cntx->col += cntx->tok_buf_pos;
 
@@ -1347,10 +1872,9 @@ long jx_parse_utf8(jx_cntx *cntx, const char *src, long pos, long end_pos, bool
                 return -1;
             }
 
-            value = jx_unicode_token_object(type);
+            value = jx_unicode_token_object(cntx, type);
 
             if (value == NULL) {
-                jx_set_error(cntx, JX_ERROR_LIBC);
                 return -1;
             }
 
@@ -1398,6 +1922,10 @@ long jx_parse_token(jx_cntx *cntx, const char *src, long pos, long end_pos)
         if (done) {
             jx_value * obj = jx_get_value(cntx);
 
+            if (!jx_end_container(cntx, mode)) {
+                return -1;
+            }
+
             jx_pop_mode(cntx);
             jx_set_return(cntx, obj);
 
@@ -1521,10 +2049,7 @@ int jx_parse_json(jx_cntx *cntx, const char *src, long n_bytes)
         if (token == JX_TOKEN_ARRAY_BEGIN) {
             jx_value *array;
 
-            array = jxa_new(JX_DEFAULT_ARRAY_SIZE);
-
-            if (array == NULL) {
-                jx_set_error(cntx, JX_ERROR_LIBC);
+            if ((array = jx_new_container(cntx, JX_TYPE_ARRAY)) == NULL) {
                 return -1;
             }
 
@@ -1543,10 +2068,7 @@ int jx_parse_json(jx_cntx *cntx, const char *src, long n_bytes)
         else if (token == JX_TOKEN_OBJ_BEGIN) {
             jx_value *obj;
 
-            obj = jxd_new();
-
-            if (obj == NULL) {
-                jx_set_error(cntx, JX_ERROR_LIBC);
+            if ((obj = jx_new_container(cntx, JX_TYPE_OBJECT)) == NULL) {
                 return -1;
             }
 
@@ -1573,21 +2095,11 @@ int jx_parse_json(jx_cntx *cntx, const char *src, long n_bytes)
             cntx->inside_token = true;
         }
         else if (token == JX_TOKEN_STRING) {
-            jx_value *str;
-
-            str = jxs_new(NULL);
-
-            if (str == NULL) {
-                jx_set_error(cntx, JX_ERROR_LIBC);
-                return -1;
-            }
-
             if (!jx_push_mode(cntx, JX_MODE_PARSE_STRING)) {
-                jxv_free(str);
                 return -1;
             }
 
-            jx_set_value(cntx, str);
+            cntx->str_buf_len = 0;
 
             pos++;
 
@@ -1645,245 +2157,553 @@ jx_value *jx_get_result(jx_cntx *cntx)
 
     jx_set_return(cntx, NULL);
 
+    /* In callback mode the document was reported as it was parsed. */
+    if (jxv_is_placeholder(ret)) {
+        return NULL;
+    }
+
     return ret;
 }
 
-char *jx_serialize_json(jx_value *value, bool escape)
-{
-    jx_value *buf;
-    char *r;
+/* Serializer output.
+ *
+ * The serializer writes through a buffer that is either handed to a write callback each
+ * time it fills (so that a document of any size is written with a fixed amount of memory),
+ * or, without a callback, grown to hold the whole document, unless it is fixed (a buffer
+ * the caller provided, see jx_serialize_into()). An output that measures writes nothing,
+ * only counting the bytes it is given (see jx_serialized_size()). While escape is set, every
+ * byte written is escaped for a JSON string, which is how a document is enclosed in one
+ * (see jx_serialize_json()) without serializing it twice. */
 
-    jx_type type;
+#define JX_OUTPUT_MIN_SIZE 256
 
-    type = jxv_get_type(value);
+void jx_output_init(jx_output *out, jx_write_cb write_cb, void *user)
+{
+    memset(out, 0, sizeof(jx_output));
 
-    if (type != JX_TYPE_ARRAY && type != JX_TYPE_OBJECT)
-        return NULL;
+    out->write_cb = write_cb;
+    out->user = user;
+}
 
-    buf = jxs_new(NULL);
+bool jx_output_flush(jx_output *out)
+{
+    if (out->failed) {
+        return false;
+    }
 
-    if (buf == NULL)
-        return NULL;
+    if (out->write_cb != NULL && out->length > 0) {
+        if (!out->write_cb(out->user, out->buf, out->length)) {
+            out->failed = true;
+            return false;
+        }
 
-    if (!jx_serialize_value(buf, value)) {
-        jxv_free(buf);
-        return NULL;
+        out->length = 0;
     }
 
-    if (escape) {
-        buf = jx_serialize_escape(buf);
+    return true;
+}
 
-        if (buf == NULL) {
-            return NULL;
-        }
+bool jx_output_grow(jx_output *out, size_t n)
+{
+    size_t size = (out->size > 0) ? out->size : JX_OUTPUT_MIN_SIZE;
+    char *buf;
+
+    while (size - out->length < n) {
+        size *= 2;
     }
 
-    r = strdup(jxs_get_str(buf));
+    if ((buf = realloc(out->buf, size)) == NULL) {
+        out->failed = true;
+        return false;
+    }
 
-    jxv_free(buf);
+    out->buf = buf;
+    out->size = size;
 
-    return r;
+    return true;
 }
 
-jx_value *jx_serialize_escape(jx_value *src)
+/* Copy bytes to the output as they are, flushing (or growing) as often as it takes. */
+bool jx_output_put(jx_output *out, const char *data, size_t length)
 {
-    jx_value *dst;
-    char *ptr;
-
-    ptr = jxs_get_str(src);
-    dst = jxs_new(NULL);
+    if (out->failed) {
+        return false;
+    }
 
-    if (ptr == NULL || dst == NULL)
-        return NULL;
+    if (out->measure) {
+        out->length += length;
+        return true;
+    }
 
-    jxs_append_chr(dst, '"');
+    while (out->size - out->length < length) {
+        size_t n = out->size - out->length;
 
-    while (*ptr != '\0') {
-        if (*ptr == '\\' || *ptr == '"') {
-            jxs_append_chr(dst, '\\');
+        if (out->fixed) {
+            out->failed = true;
+            return false;
         }
 
-        jxs_append_chr(dst, *ptr++);
+        if (out->write_cb == NULL) {
+            if (!jx_output_grow(out, length)) {
+                return false;
+            }
 
-        if (!jxv_is_valid(dst))
             break;
-    }
+        }
 
-    jxs_append_chr(dst, '"');
+        memcpy(out->buf + out->length, data, n);
+        out->length += n;
 
-    jxv_free(src);
+        data += n;
+        length -= n;
 
-    if (!jxv_is_valid(dst)) {
-        jxv_free(dst);
-        return NULL;
+        if (!jx_output_flush(out)) {
+            return false;
+        }
     }
 
-    return dst;
+    memcpy(out->buf + out->length, data, length);
+    out->length += length;
+
+    return true;
 }
 
-bool jx_serialize_utf8_string(jx_value *buf, const char *str)
+bool jx_output_write(jx_output *out, const char *data, size_t length)
 {
-    const char *ptr;
+    size_t i, start;
 
-    jxs_append_chr(buf, '"');
+    if (!out->escape) {
+        return jx_output_put(out, data, length);
+    }
 
-    for (ptr = str; *ptr != '\0'; ptr++) {
-        switch (*ptr) {
-            case '\t':
-                jxs_append_str(buf, "\\t");
-                break;
-            case '\n':
-                jxs_append_str(buf, "\\n");
-                break;
-            case '\r':
-                jxs_append_str(buf, "\\r");
-                break;
-            case '\b':
-                jxs_append_str(buf, "\\b");
-                break;
-            case '\f':
-                jxs_append_str(buf, "\\f");
-                break;
-            default:
-                if (*ptr == '\\' || *ptr == '"')
-                    jxs_append_chr(buf, '\\');
+    for (i = start = 0; i < length; i++) {
+        if (data[i] == '"' || data[i] == '\\') {
+            if (!jx_output_put(out, data + start, i - start) || !jx_output_put(out, "\\", 1)) {
+                return false;
+            }
 
-                jxs_append_chr(buf, *ptr);
-                break;
+            start = i;
         }
     }
 
-    jxs_append_chr(buf, '"');
+    return jx_output_put(out, data + start, length - start);
+}
 
-    return jxv_is_valid(buf);
+bool jx_output_str(jx_output *out, const char *str)
+{
+    return jx_output_write(out, str, strlen(str));
 }
 
-void jx_serialize_kv(const char *key, jx_value *value, void *ptr)
+bool jx_output_chr(jx_output *out, char c)
 {
-    jx_value *buf = ptr;
+    if (!out->escape && out->length < out->size) {
+        out->buf[out->length++] = c;
+        return true;
+    }
 
-    jx_serialize_utf8_string(buf, key);
+    if (!out->escape && out->measure) {
+        out->length++;
+        return true;
+    }
+
+    return jx_output_write(out, &c, 1);
+}
 
-    jxs_append_chr(buf, ':');
+/* Serialize an array or object, enclosed in a string if escape is set. */
+bool jx_serialize_document(jx_output *out, jx_value *value, bool escape)
+{
+    jx_type type = jxv_get_type(value);
 
-    jx_serialize_value(buf, value);
+    if (type != JX_TYPE_ARRAY && type != JX_TYPE_OBJECT) {
+        return false;
+    }
 
-    jxs_append_chr(buf, ',');
+    if (escape) {
+        jx_output_chr(out, '"');
+        out->escape = true;
+    }
+
+    jx_serialize_value(out, value);
+
+    if (escape) {
+        out->escape = false;
+        jx_output_chr(out, '"');
+    }
+
+    return !out->failed;
 }
 
-bool jx_serialize_null(jx_value *buf, jx_value *value)
+char *jx_serialize_json(jx_value *value, bool escape)
 {
-    return jxs_append_str(buf, "null");
+    jx_output out;
+
+    jx_output_init(&out, NULL, NULL);
+
+    if (!jx_serialize_document(&out, value, escape) || !jx_output_put(&out, "", 1)) {
+        free(out.buf);
+        return NULL;
+    }
+
+    return out.buf;
 }
 
-bool jx_serialize_bool(jx_value *buf, jx_value *value)
+bool jx_serialize_to_sink(jx_value *value, jx_write_cb write_cb, void *user, const jx_serialize_opts *opts)
 {
-    if (jxv_get_bool(value)) {
-        return jxs_append_str(buf, "true");
+    jx_output out;
+    bool success;
+
+    if (write_cb == NULL) {
+        return false;
     }
-    else {
-        return jxs_append_str(buf, "false");
+
+    jx_output_init(&out, write_cb, user);
+
+    out.size = (opts != NULL && opts->buffer_size > 0) ? opts->buffer_size : JX_SERIALIZE_BUFFER_SIZE;
+
+    if ((out.buf = malloc(out.size)) == NULL) {
+        return false;
     }
+
+    success = jx_serialize_document(&out, value, opts != NULL && opts->escape) && jx_output_flush(&out);
+
+    free(out.buf);
+
+    return success;
 }
 
-bool jx_serialize_number(jx_value *buf, jx_value *number)
+/* The length of the document, without writing it, or 0 if it can't be serialized. */
+size_t jx_serialized_size(jx_value *value, const jx_serialize_opts *opts)
 {
-    double value = jxv_get_number(number);
+    jx_output out;
+
+    jx_output_init(&out, NULL, NULL);
+
+    out.measure = true;
+
+    if (!jx_serialize_document(&out, value, opts != NULL && opts->escape)) {
+        return 0;
+    }
 
-    return jxs_append_fmt(buf, "%g", value);
+    return out.length;
 }
 
-bool jx_serialize_string(jx_value *buf, jx_value *str)
+/* Serialize a document into buf, allocating nothing. The document isn't null-terminated;
+ * its length is returned, or 0 if it is longer than cap (see jx_serialized_size()) or
+ * can't be serialized, in which case the contents of buf are undefined. */
+size_t jx_serialize_into(jx_value *value, char *buf, size_t cap, const jx_serialize_opts *opts)
 {
-    return jx_serialize_utf8_string(buf, jxs_get_str(str));
+    jx_output out;
+
+    if (buf == NULL) {
+        return 0;
+    }
+
+    jx_output_init(&out, NULL, NULL);
+
+    out.buf = buf;
+    out.size = cap;
+    out.fixed = true;
+
+    if (!jx_serialize_document(&out, value, opts != NULL && opts->escape)) {
+        return 0;
+    }
+
+    return out.length;
 }
 
-bool jx_serialize_object(jx_value *buf, jx_value *obj)
+/* The character that follows the backslash in the escape for each byte, 'u' for
+ * \u00XX, or 0 for the bytes that are written as they are. */
+static const char jx_escapes[256] =
 {
-    char c;
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    ['"'] = '"',
+    ['\\'] = '\\'
+};
+
+/* Copy the runs of bytes that need no escaping whole, finding the end of each a block
+ * at a time where SIMD is available. */
+bool jx_serialize_utf8_string(jx_output *out, const char *str, size_t length)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    size_t i = 0, start = 0;
+
+    jx_output_chr(out, '"');
 
-    jxs_append_chr(buf, '{');
+    while (i < length) {
+        char escape[6];
+        unsigned char c;
 
-    jxd_iterate(obj, jx_serialize_kv, buf);
+#ifdef JX_SIMD_WIDTH
+        while (i + JX_SIMD_WIDTH <= length) {
+            uint32_t special = jx_simd_escape(str + i);
 
-    // Remove trailing comma, if any
-    while ((c = jxs_top(buf)) != '{') {
-        jxs_pop(buf);
+            if (special != 0) {
+                i += jx_ctz32(special);
+                break;
+            }
+
+            i += JX_SIMD_WIDTH;
+        }
+#endif
 
-        if (c == ',') {
+        while (i < length && jx_escapes[(unsigned char)str[i]] == 0) {
+            i++;
+        }
+
+        if (i == length) {
             break;
         }
+
+        c = (unsigned char)str[i];
+
+        escape[0] = '\\';
+        escape[1] = jx_escapes[c];
+
+        if (!jx_output_write(out, str + start, i - start)) {
+            return false;
+        }
+
+        if (escape[1] == 'u') {
+            escape[2] = '0';
+            escape[3] = '0';
+            escape[4] = hex[c >> 4];
+            escape[5] = hex[c & 0xf];
+
+            jx_output_write(out, escape, 6);
+        }
+        else {
+            jx_output_write(out, escape, 2);
+        }
+
+        start = ++i;
     }
 
-    jxs_append_chr(buf, '}');
+    jx_output_write(out, str + start, length - start);
+    jx_output_chr(out, '"');
 
-    return jxv_is_valid(buf);
+    return !out->failed;
 }
 
-bool jx_serialize_array(jx_value *buf, jx_value *array)
+bool jx_serialize_null(jx_output *out, jx_value *value)
 {
-    jx_value *value;
+    return jx_output_str(out, "null");
+}
+
+bool jx_serialize_bool(jx_output *out, jx_value *value)
+{
+    if (jxv_get_bool(value)) {
+        return jx_output_str(out, "true");
+    }
+    else {
+        return jx_output_str(out, "false");
+    }
+}
+
+/* JSON has no infinities or NaNs, which are written as null (as JavaScript does). */
+bool jx_serialize_double(jx_output *out, double num)
+{
+    char str[JX_NUMBER_DOUBLE_MAX_LENGTH];
 
-    size_t i, length;
+    if (!isfinite(num)) {
+        return jx_output_write(out, "null", 4);
+    }
+
+    return jx_output_write(out, str, jx_number_format_double(str, num));
+}
+
+bool jx_serialize_int(jx_output *out, int64_t num)
+{
+    char str[JX_NUMBER_INT_MAX_LENGTH];
+
+    return jx_output_write(out, str, jx_number_format_int(str, num));
+}
+
+bool jx_serialize_number(jx_output *out, jx_value *number)
+{
+    if (jxv_is_int(number)) {
+        return jx_serialize_int(out, jxv_get_int(number));
+    }
 
-    length = jxa_get_length(array);
+    return jx_serialize_double(out, jxv_get_number(number));
+}
 
-    jxs_append_chr(buf, '[');
+bool jx_serialize_string(jx_output *out, jx_value *str)
+{
+    return jx_serialize_utf8_string(out, jxs_get_str(str), jxs_get_length(str));
+}
 
-    for (i = 0; i < length; i++) {
-        value = jxa_get(array, i);
+/* Serialize a member of an object, preceded by a comma unless it is the first. */
+bool jx_serialize_member(jx_output *out, const char *key, size_t length, jx_value *value, bool first)
+{
+    if (!first) {
+        jx_output_chr(out, ',');
+    }
+
+    jx_serialize_utf8_string(out, key, length);
 
-        if (!jx_serialize_value(buf, value)) {
+    jx_output_chr(out, ':');
+
+    return jx_serialize_value(out, value);
+}
+
+bool jx_serialize_object(jx_output *out, jx_value *obj)
+{
+    jx_iter iter;
+    const char *key;
+    size_t length;
+    bool first = true;
+
+    jx_output_chr(out, '{');
+
+    jx_iter_init(&iter, obj);
+
+    while (jx_iter_next(&iter)) {
+        key = jx_iter_key(&iter, &length);
+
+        if (!jx_serialize_member(out, key, length, jx_iter_value(&iter), first)) {
+            jx_iter_end(&iter);
             return false;
         }
 
-        if (i != length - 1) {
-            jxs_append_chr(buf, ',');
+        first = false;
+    }
+
+    jx_output_chr(out, '}');
+
+    return !out->failed;
+}
+
+/* Serialize the items of an array from start up to end, each preceded by a comma unless
+ * it is the first of the array. Numbers are read as such, which leaves packed arrays packed
+ * (and the array unchanged, so that ranges of it may be serialized concurrently). */
+bool jx_serialize_items(jx_output *out, jx_value *array, size_t start, size_t end)
+{
+    size_t i;
+
+    for (i = start; i < end; i++) {
+        if (i > 0) {
+            jx_output_chr(out, ',');
+        }
+
+        if (jxa_is_int(array, i)) {
+            if (!jx_serialize_int(out, jxa_get_int(array, i))) {
+                return false;
+            }
+        }
+        else if (jxa_get_type(array, i) == JX_TYPE_NUMBER) {
+            if (!jx_serialize_double(out, jxa_get_number(array, i))) {
+                return false;
+            }
+        }
+        else if (!jx_serialize_value(out, jxa_get(array, i))) {
+            return false;
         }
     }
 
-    jxs_append_chr(buf, ']');
+    return !out->failed;
+}
+
+bool jx_serialize_array(jx_output *out, jx_value *array)
+{
+    jx_output_chr(out, '[');
+
+    if (!jx_serialize_items(out, array, 0, jxa_get_length(array))) {
+        return false;
+    }
 
-    return jxv_is_valid(buf);
+    jx_output_chr(out, ']');
+
+    return !out->failed;
 }
 
-bool jx_serialize_value(jx_value *buf, jx_value *value)
+/* Serialize an array or object that keeps its serialized bytes (see jxv_set_cache()),
+ * copying them if it hasn't changed since it was last serialized, and storing them
+ * otherwise. Outputs that don't allocate, measuring or written into a fixed buffer, leave
+ * caches that are stale as they are. */
+bool jx_serialize_cached(jx_output *out, jx_value *value)
 {
-    jx_type type;
+    jx_output cache;
+    const char *data;
+    size_t length;
+
+    if ((data = jxv_get_cache(value, &length)) != NULL) {
+        return jx_output_write(out, data, length);
+    }
+
+    if (out->measure || out->fixed) {
+        if (jxv_get_type(value) == JX_TYPE_ARRAY) {
+            return jx_serialize_array(out, value);
+        }
+
+        return jx_serialize_object(out, value);
+    }
 
-    if (buf == NULL || value == NULL)
+    jx_output_init(&cache, NULL, NULL);
+
+    if (jxv_get_type(value) == JX_TYPE_ARRAY) {
+        jx_serialize_array(&cache, value);
+    }
+    else {
+        jx_serialize_object(&cache, value);
+    }
+
+    if (cache.failed) {
+        free(cache.buf);
+        out->failed = true;
         return false;
+    }
+
+    jx_output_write(out, cache.buf, cache.length);
+
+    if (!jxv_put_cache(value, cache.buf, cache.length)) {
+        free(cache.buf);
+    }
 
-    if (jxv_get_type(buf) != JX_TYPE_STRING)
+    return !out->failed;
+}
+
+bool jx_serialize_value(jx_output *out, jx_value *value)
+{
+    jx_type type;
+
+    if (out == NULL || value == NULL)
         return false;
 
     type = jxv_get_type(value);
 
-    if (type == JX_TYPE_UNDEF || type == JX_TYPE_PTR)
+    if (type == JX_TYPE_UNDEF || type == JX_TYPE_PTR) {
+        out->failed = true;
         return false;
+    }
+
+    if ((type == JX_TYPE_ARRAY || type == JX_TYPE_OBJECT) && jxv_has_cache(value)) {
+        return jx_serialize_cached(out, value);
+    }
 
     switch (type) {
         case JX_TYPE_ARRAY:
-            jx_serialize_array(buf, value);
+            jx_serialize_array(out, value);
             break;
         case JX_TYPE_OBJECT:
-            jx_serialize_object(buf, value);
+            jx_serialize_object(out, value);
             break;
         case JX_TYPE_STRING:
-            jx_serialize_string(buf, value);
+            jx_serialize_string(out, value);
             break;
         case JX_TYPE_NUMBER:
-            jx_serialize_number(buf, value);
+            jx_serialize_number(out, value);
             break;
         case JX_TYPE_BOOL:
-            jx_serialize_bool(buf, value);
+            jx_serialize_bool(out, value);
             break;
         case JX_TYPE_NULL:
-            jx_serialize_null(buf, value);
+            jx_serialize_null(out, value);
             break;
         default:
             break;
     }
 
-    return jxv_is_valid(buf);
+    return !out->failed;
 }
\ No newline at end of file
@@ -70,6 +70,7 @@ typedef enum
     JX_ERROR_ILLEGAL_TOKEN,
     JX_ERROR_ILLEGAL_OBJ_KEY,
     JX_ERROR_INCOMPLETE_OBJECT,
+    JX_ERROR_ABORTED,
     JX_ERROR_GUARD
 } jx_error;
 
@@ -107,23 +108,65 @@ typedef enum
     JX_UNI_LOWER_PI
 } jx_utoken;
 
+/* Callbacks for parsing without building a tree (see jx_set_handlers()).
+ *
+ * Every handler is optional; integers (see jxv_int_new()) go to number when there is no
+ * integer handler. Keys and strings are passed as a pointer and a length, and
+ * are not null-terminated; when the whole string (without escape sequences) lies inside
+ * the chunk passed to jx_parse_json(), the pointer refers directly into that chunk,
+ * otherwise into a buffer owned by the context. Either way it is only valid until the
+ * handler returns. A handler returning false aborts the parse with JX_ERROR_ABORTED. */
+typedef struct
+{
+    bool (*start_object)(void *user);
+    bool (*end_object)(void *user);
+    bool (*start_array)(void *user);
+    bool (*end_array)(void *user);
+    bool (*key)(void *user, const char *key, size_t length);
+    bool (*string)(void *user, const char *str, size_t length);
+    bool (*number)(void *user, double num);
+    bool (*boolean)(void *user, bool value);
+    bool (*null)(void *user);
+    bool (*integer)(void *user, int64_t num);
+} jx_handlers;
+
+/* Where the streaming serializers (see jx_serialize_to_sink()) write to. Each call hands
+ * over the next length bytes of the document; returning false aborts the serialization. */
+typedef bool (*jx_write_cb)(void *user, const char *data, size_t length);
+
+#define JX_SERIALIZE_BUFFER_SIZE (64 * 1024)
+
+/* Options for the streaming serializers; passing NULL selects the defaults (all zero). */
+typedef struct
+{
+    /* Enclose the document in a JSON string, as jx_serialize_json() does when asked to. */
+    bool escape;
+
+    /* The size of the buffer written through, or 0 for JX_SERIALIZE_BUFFER_SIZE. */
+    size_t buffer_size;
+} jx_serialize_opts;
+
 #ifdef JX_INTERNAL
 
 #define JX_TOKEN_BUF_SIZE     26
 #define JX_ERROR_BUF_MAX_SIZE 2048
 
+struct jx_async_t;
+typedef struct jx_async_t jx_async;
+
 typedef struct
 {
     jx_value *value;
     jx_value *return_value;
     jx_value *key;
+    jx_value **slot;
 
     jx_state state;
 
     jx_mode mode;
 } jx_frame;
 
-typedef struct
+typedef struct jx_cntx
 {
     size_t line;
     size_t col;
@@ -132,7 +175,8 @@ typedef struct
 
     int tab_stop_width;
 
-    jx_value *object_stack;
+    jx_frame *frames;
+    size_t n_frames, frames_size;
 
     uint16_t code[2];
     int code_index, shifts;
@@ -140,6 +184,9 @@ typedef struct
     char tok_buf[JX_TOKEN_BUF_SIZE];
     int tok_buf_pos;
 
+    char *str_buf;
+    size_t str_buf_len, str_buf_size;
+
     char uni_tok[5];
     int uni_tok_len, uni_tok_i;
 
@@ -149,6 +196,19 @@ typedef struct
 
     jx_ext_set ext;
 
+    jx_arena *arena;
+    jx_intern *intern;
+    size_t n_keys;
+
+    jx_handlers handlers;
+    void *user;
+    bool callbacks;
+
+    /* Set by jx_parse_async_start(), so that jx_reset() can stop a worker without the
+     * parser depending on the background parsing module (and threads). */
+    jx_async *async;
+    void (*async_cancel)(struct jx_cntx *cntx);
+
     char error_msg[JX_ERROR_BUF_MAX_SIZE];
     jx_error error;
 } jx_cntx;
@@ -159,6 +219,7 @@ typedef struct jx_cntx jx_cntx;
 
 jx_cntx *jx_new();
 void jx_free(jx_cntx *cntx);
+void jx_reset(jx_cntx *cntx);
 
 #ifdef JX_INTERNAL
 void jx_set_error(jx_cntx *cntx, jx_error error, ...);
@@ -181,6 +242,8 @@ const char * const jx_get_error_message(jx_cntx *cntx);
 
 void jx_set_tab_stop_width(jx_cntx *cntx, int tab_width);
 void jx_set_extensions(jx_cntx *cntx, jx_ext_set ext);
+void jx_set_arena(jx_cntx *cntx, jx_arena *arena);
+void jx_set_handlers(jx_cntx *cntx, const jx_handlers *handlers, void *user);
 
 int jx_parse_json(jx_cntx *cntx, const char *src, long n_bytes);
 
@@ -188,14 +251,49 @@ jx_value *jx_get_result(jx_cntx * cntx);
 
 char *jx_serialize_json(jx_value *value, bool escape);
 
+/* Serialize an array or object through a buffer of fixed size, flushing it to write_cb
+ * whenever it fills, so that the memory used doesn't depend on the size of the document. */
+bool jx_serialize_to_sink(jx_value *value, jx_write_cb write_cb, void *user, const jx_serialize_opts *opts);
+
+/* Serialize in two passes, measuring the document and then writing it into a buffer of
+ * that size, e.g. a shared memory slot or a network buffer, with no allocation at all. */
+size_t jx_serialized_size(jx_value *value, const jx_serialize_opts *opts);
+size_t jx_serialize_into(jx_value *value, char *buf, size_t cap, const jx_serialize_opts *opts);
+
 #ifdef JX_INTERNAL
-jx_value *jx_serialize_escape(jx_value *src);
-bool jx_serialize_utf8_string(jx_value *buf, const char *str);
-bool jx_serialize_null(jx_value *buf, jx_value *value);
-bool jx_serialize_bool(jx_value *buf, jx_value *value);
-bool jx_serialize_number(jx_value *buf, jx_value *number);
-bool jx_serialize_string(jx_value *buf, jx_value *str);
-bool jx_serialize_object(jx_value *buf, jx_value *obj);
-bool jx_serialize_array(jx_value *buf, jx_value *array);
-bool jx_serialize_value(jx_value *buf, jx_value *value);
+typedef struct
+{
+    char *buf;
+    size_t length, size;
+
+    jx_write_cb write_cb;
+    void *user;
+
+    bool escape;
+    bool measure;
+    bool fixed;
+    bool failed;
+} jx_output;
+
+void jx_output_init(jx_output *out, jx_write_cb write_cb, void *user);
+bool jx_output_flush(jx_output *out);
+bool jx_output_put(jx_output *out, const char *data, size_t length);
+bool jx_output_write(jx_output *out, const char *data, size_t length);
+bool jx_output_str(jx_output *out, const char *str);
+bool jx_output_chr(jx_output *out, char c);
+
+bool jx_serialize_document(jx_output *out, jx_value *value, bool escape);
+bool jx_serialize_utf8_string(jx_output *out, const char *str, size_t length);
+bool jx_serialize_null(jx_output *out, jx_value *value);
+bool jx_serialize_bool(jx_output *out, jx_value *value);
+bool jx_serialize_double(jx_output *out, double num);
+bool jx_serialize_int(jx_output *out, int64_t num);
+bool jx_serialize_number(jx_output *out, jx_value *number);
+bool jx_serialize_string(jx_output *out, jx_value *str);
+bool jx_serialize_member(jx_output *out, const char *key, size_t length, jx_value *value, bool first);
+bool jx_serialize_object(jx_output *out, jx_value *obj);
+bool jx_serialize_items(jx_output *out, jx_value *array, size_t start, size_t end);
+bool jx_serialize_array(jx_output *out, jx_value *array);
+bool jx_serialize_cached(jx_output *out, jx_value *value);
+bool jx_serialize_value(jx_output *out, jx_value *value);
 #endif
\ No newline at end of file
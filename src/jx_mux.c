@@ -0,0 +1,303 @@
+/*---------------------------------------------------------------------
+| jx_mux.c
+----------------------------------------------------------------------
+| jxutil project
+|
+| Created by Cory Montgomery
+| cory.james.montgomery@gmail.com
+|
+| https://cjmont32.dev/jxutil
+| https://github.com/cjmont32/jxutil
+|
+----------------------------------------------------------------------
+| BSD 2-Clause License
+|
+| Copyright (c) 2018-2023, Cory Montgomery
+|
+| Redistribution and use in source and binary forms, with or without
+| modification, are permitted provided that the following conditions
+| are met:
+|
+|    1. Redistributions of source code must retain the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer.
+|    2. Redistributions in binary form must reproduce the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer in the documentation and/or other materials
+|       provided with the distribution.
+|
+| THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+| "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+| LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+| FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+| COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+| INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+| BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+| LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+| CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+| LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+| WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+| POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define JX_INTERNAL
+
+#include <errno.h>
+#include <string.h>
+
+#include <jx.h>
+#include <jx_util.h>
+
+#ifdef __linux__
+
+#include <unistd.h>
+#include <sys/epoll.h>
+
+/* Drives many (fd, context) pairs from a single epoll loop.
+ *
+ * Registrations are kept in a table indexed by descriptor, so that dispatching an event
+ * is an array lookup, and a pair removed while a batch of events is being dispatched
+ * (e.g. by the completion callback) is simply skipped. All reads go through one buffer
+ * owned by the multiplexer. */
+
+#define JX_MUX_DEFAULT_BUF_SIZE (64 * 1024)
+#define JX_MUX_MAX_EVENTS       256
+
+struct jx_mux_t
+{
+    int epoll_fd;
+
+    jx_cntx **cntxs;
+    size_t cntxs_size;
+    size_t n_registered;
+
+    char *buf;
+    size_t buf_size;
+
+    struct epoll_event events[JX_MUX_MAX_EVENTS];
+
+    jx_mux_cb cb;
+    void *user;
+};
+
+jx_mux *jx_mux_new(jx_mux_cb cb, void *user)
+{
+    jx_mux *mux;
+
+    if (cb == NULL) {
+        return NULL;
+    }
+
+    if ((mux = calloc(1, sizeof(jx_mux))) == NULL) {
+        return NULL;
+    }
+
+    mux->buf_size = JX_MUX_DEFAULT_BUF_SIZE;
+
+    if ((mux->buf = malloc(mux->buf_size)) == NULL) {
+        free(mux);
+        return NULL;
+    }
+
+    if ((mux->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+        free(mux->buf);
+        free(mux);
+        return NULL;
+    }
+
+    mux->cb = cb;
+    mux->user = user;
+
+    return mux;
+}
+
+void jx_mux_free(jx_mux *mux)
+{
+    if (mux == NULL) {
+        return;
+    }
+
+    close(mux->epoll_fd);
+
+    free(mux->cntxs);
+    free(mux->buf);
+    free(mux);
+}
+
+/* Watch fd, which should be non-blocking, and feed what is read from it to cntx. */
+bool jx_mux_add(jx_mux *mux, int fd, jx_cntx *cntx)
+{
+    struct epoll_event event;
+
+    if (mux == NULL || cntx == NULL || fd < 0) {
+        return false;
+    }
+
+    if ((size_t)fd >= mux->cntxs_size) {
+        size_t size = mux->cntxs_size ? mux->cntxs_size : 64;
+        jx_cntx **cntxs;
+
+        while (size <= (size_t)fd) {
+            size *= 2;
+        }
+
+        if ((cntxs = realloc(mux->cntxs, sizeof(jx_cntx *) * size)) == NULL) {
+            return false;
+        }
+
+        memset(cntxs + mux->cntxs_size, 0, sizeof(jx_cntx *) * (size - mux->cntxs_size));
+
+        mux->cntxs = cntxs;
+        mux->cntxs_size = size;
+    }
+
+    if (mux->cntxs[fd] != NULL) {
+        return false;
+    }
+
+    memset(&event, 0, sizeof(event));
+
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+
+    if (epoll_ctl(mux->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        jx_set_error(cntx, JX_ERROR_LIBC);
+        return false;
+    }
+
+    mux->cntxs[fd] = cntx;
+    mux->n_registered++;
+
+    return true;
+}
+
+/* Stop watching fd; neither the descriptor nor its context is closed or freed. */
+bool jx_mux_remove(jx_mux *mux, int fd)
+{
+    if (mux == NULL || fd < 0 || (size_t)fd >= mux->cntxs_size || mux->cntxs[fd] == NULL) {
+        return false;
+    }
+
+    epoll_ctl(mux->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+
+    mux->cntxs[fd] = NULL;
+    mux->n_registered--;
+
+    return true;
+}
+
+size_t jx_mux_get_size(jx_mux *mux)
+{
+    if (mux == NULL) {
+        return 0;
+    }
+
+    return mux->n_registered;
+}
+
+/* Read once from a ready descriptor. When its document is complete, or can no longer be
+ * completed (a read or syntax error, or end of file), the pair is removed and the
+ * callback receives the root, or NULL with the error set in the context. Returns true
+ * if the callback was invoked. */
+bool jx_mux_read(jx_mux *mux, int fd)
+{
+    jx_cntx *cntx = mux->cntxs[fd];
+    jx_value *root = NULL;
+    ssize_t n_read;
+
+    n_read = read(fd, mux->buf, mux->buf_size);
+
+    if (n_read == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return false;
+        }
+
+        jx_set_error(cntx, JX_ERROR_LIBC);
+    }
+    else if (n_read == 0) {
+        /* Sets an incomplete object error, unless the document was already complete. */
+        root = jx_get_result(cntx);
+    }
+    else {
+        int ret = jx_parse_json(cntx, mux->buf, n_read);
+
+        if (ret == 0) {
+            return false;
+        }
+
+        if (ret == 1) {
+            root = jx_get_result(cntx);
+        }
+    }
+
+    jx_mux_remove(mux, fd);
+
+    mux->cb(mux, fd, cntx, root, mux->user);
+
+    return true;
+}
+
+/* Wait up to timeout milliseconds (-1 to wait indefinitely) for registered descriptors
+ * to become readable, and service them. Returns the number of completion callbacks made,
+ * or -1 if waiting failed. */
+int jx_mux_run(jx_mux *mux, int timeout)
+{
+    int i, n_events, n_done = 0;
+
+    if (mux == NULL) {
+        return -1;
+    }
+
+    if ((n_events = epoll_wait(mux->epoll_fd, mux->events, JX_MUX_MAX_EVENTS, timeout)) == -1) {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    for (i = 0; i < n_events; i++) {
+        int fd = mux->events[i].data.fd;
+
+        /* Skip pairs removed by a callback earlier in this batch. */
+        if ((size_t)fd >= mux->cntxs_size || mux->cntxs[fd] == NULL) {
+            continue;
+        }
+
+        if (jx_mux_read(mux, fd)) {
+            n_done++;
+        }
+    }
+
+    return n_done;
+}
+
+#else
+
+jx_mux *jx_mux_new(jx_mux_cb cb, void *user)
+{
+    errno = ENOSYS;
+    return NULL;
+}
+
+void jx_mux_free(jx_mux *mux)
+{
+}
+
+bool jx_mux_add(jx_mux *mux, int fd, jx_cntx *cntx)
+{
+    return false;
+}
+
+bool jx_mux_remove(jx_mux *mux, int fd)
+{
+    return false;
+}
+
+size_t jx_mux_get_size(jx_mux *mux)
+{
+    return 0;
+}
+
+int jx_mux_run(jx_mux *mux, int timeout)
+{
+    return -1;
+}
+
+#endif
@@ -0,0 +1,1171 @@
+/*---------------------------------------------------------------------
+| jx_number.c
+----------------------------------------------------------------------
+| jxutil project
+|
+| Created by Cory Montgomery
+| cory.james.montgomery@gmail.com
+|
+| https://cjmont32.dev/jxutil
+| https://github.com/cjmont32/jxutil
+|
+----------------------------------------------------------------------
+| BSD 2-Clause License
+|
+| Copyright (c) 2018-2023, Cory Montgomery
+|
+| Redistribution and use in source and binary forms, with or without
+| modification, are permitted provided that the following conditions
+| are met:
+|
+|    1. Redistributions of source code must retain the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer.
+|    2. Redistributions in binary form must reproduce the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer in the documentation and/or other materials
+|       provided with the distribution.
+|
+| THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+| "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+| LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+| FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+| COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+| INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+| BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+| LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+| CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+| LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+| WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+| POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#include <jx_number.h>
+#include <jx_number_tables.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || defined(_WIN32)
+#define JX_SWAR_LITTLE_ENDIAN
+#endif
+
+#define JX_MANTISSA_BITS        52
+#define JX_EXPONENT_BIAS        1023
+#define JX_INFINITE_POWER       0x7FF
+
+#define JX_MAX_DIGITS           19
+#define JX_MAX_EXP_NUMBER       0x10000
+
+#define JX_DECIMAL_DIGITS       800
+#define JX_DECIMAL_MAX_SHIFT    60
+
+typedef struct
+{
+    uint8_t digits[JX_DECIMAL_DIGITS];
+
+    int num_digits;
+    int64_t decimal_point;
+
+    bool negative;
+    bool truncated;
+} jx_decimal;
+
+static const double jx_exact_pow10[] =
+{
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+bool jx_number_char(char c)
+{
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+bool jx_is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+#ifdef JX_SWAR_LITTLE_ENDIAN
+uint64_t jx_read_u64(const char *src)
+{
+    uint64_t v;
+
+    memcpy(&v, src, sizeof(v));
+
+    return v;
+}
+
+bool jx_is_eight_digits(uint64_t v)
+{
+    return ((v & 0xF0F0F0F0F0F0F0F0) |
+            (((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333;
+}
+
+/* Convert eight ASCII digits (first digit in the low byte) to their value, by
+ * combining pairs of digits, then pairs of pairs, with a multiply each. */
+uint32_t jx_parse_eight_digits(uint64_t v)
+{
+    const uint64_t mask = 0x000000FF000000FF;
+    const uint64_t mul1 = 0x000F424000000064;    /* 100 + (1000000 << 32) */
+    const uint64_t mul2 = 0x0000271000000001;    /* 1 + (10000 << 32) */
+
+    v -= 0x3030303030303030;
+    v = (v * 10) + (v >> 8);
+    v = (((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32;
+
+    return (uint32_t)v;
+}
+#endif
+
+/* Accumulate the run of digits at src[*pos], eight at a time when possible.
+ * The accumulator is allowed to wrap; callers recompute it when more than
+ * JX_MAX_DIGITS digits were read. */
+uint64_t jx_read_digits(const char *src, long n, long *pos, uint64_t i)
+{
+    long p = *pos;
+
+#ifdef JX_SWAR_LITTLE_ENDIAN
+    while (p + 8 <= n) {
+        uint64_t v = jx_read_u64(src + p);
+
+        if (!jx_is_eight_digits(v)) {
+            break;
+        }
+
+        i = i * 100000000 + jx_parse_eight_digits(v);
+        p += 8;
+    }
+#endif
+
+    while (p < n && jx_is_digit(src[p])) {
+        i = i * 10 + (uint64_t)(src[p] - '0');
+        p++;
+    }
+
+    *pos = p;
+
+    return i;
+}
+
+uint64_t jx_mul_128(uint64_t a, uint64_t b, uint64_t *hi)
+{
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 r = (unsigned __int128)a * b;
+
+    *hi = (uint64_t)(r >> 64);
+
+    return (uint64_t)r;
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return _umul128(a, b, hi);
+#else
+    uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+    uint64_t p0, p1, p2, p3, mid;
+
+    p0 = a_lo * b_lo;
+    p1 = a_lo * b_hi;
+    p2 = a_hi * b_lo;
+    p3 = a_hi * b_hi;
+
+    mid = (p0 >> 32) + (uint32_t)p1 + (uint32_t)p2;
+
+    *hi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+
+    return (mid << 32) | (uint32_t)p0;
+#endif
+}
+
+int jx_clz64(uint64_t v)
+{
+#if defined(_MSC_VER) && !defined(__clang__) && defined(_M_X64)
+    unsigned long i;
+
+    _BitScanReverse64(&i, v);
+
+    return 63 - (int)i;
+#elif defined(_MSC_VER) && !defined(__clang__)
+    int n = 0;
+
+    while (!(v & ((uint64_t)1 << 63))) {
+        v <<= 1;
+        n++;
+    }
+
+    return n;
+#else
+    return __builtin_clzll(v);
+#endif
+}
+
+double jx_double_from_bits(uint64_t mantissa, int power2, bool negative)
+{
+    uint64_t bits;
+    double d;
+
+    bits = mantissa | ((uint64_t)power2 << JX_MANTISSA_BITS);
+
+    if (negative) {
+        bits |= (uint64_t)1 << 63;
+    }
+
+    memcpy(&d, &bits, sizeof(d));
+
+    return d;
+}
+
+/* Eisel-Lemire: compute the double nearest to w * 10^q using a 128-bit
+ * approximation of 5^q. The result is returned as a mantissa (without the
+ * implicit bit) and a biased binary exponent. Exact for any w < 2^64. */
+int jx_eisel_lemire(int64_t q, uint64_t w, uint64_t *mantissa)
+{
+    uint64_t lo, hi, hi2, m;
+    int lz, upperbit, shift;
+    int64_t power2;
+    int index;
+
+    if (w == 0 || q < JX_POW5_MIN_Q) {
+        *mantissa = 0;
+        return 0;
+    }
+
+    if (q > JX_POW5_MAX_Q) {
+        *mantissa = 0;
+        return JX_INFINITE_POWER;
+    }
+
+    lz = jx_clz64(w);
+    w <<= lz;
+
+    index = (int)(q - JX_POW5_MIN_Q);
+
+    lo = jx_mul_128(w, jx_pow5_128[index][0], &hi);
+
+    /* The low bits of the high word are all ones, so the truncated product
+     * might have carried into the bits we keep, refine it with the low word
+     * of the power. */
+    if ((hi & 0x1FF) == 0x1FF) {
+        jx_mul_128(w, jx_pow5_128[index][1], &hi2);
+
+        lo += hi2;
+
+        if (hi2 > lo) {
+            hi++;
+        }
+    }
+
+    upperbit = (int)(hi >> 63);
+    shift = upperbit + 64 - JX_MANTISSA_BITS - 3;
+
+    m = hi >> shift;
+
+    /* floor(log2(10^q)) + 63, computed as floor(q * log2(10)) with a fixed
+     * point approximation of log2(10) that is exact for |q| < 1650. */
+    power2 = ((((int64_t)152170 + 65536) * q) >> 16) + 63;
+    power2 += upperbit - lz + JX_EXPONENT_BIAS;
+
+    if (power2 <= 0) {
+        /* Subnormal, (or zero if it's too small to represent). */
+        if (-power2 + 1 >= 64) {
+            *mantissa = 0;
+            return 0;
+        }
+
+        m >>= -power2 + 1;
+        m += m & 1;
+        m >>= 1;
+
+        *mantissa = m & ~((uint64_t)1 << JX_MANTISSA_BITS);
+
+        return (m < ((uint64_t)1 << JX_MANTISSA_BITS)) ? 0 : 1;
+    }
+
+    /* Exactly halfway between two doubles (only possible for small q), round
+     * to even rather than up. */
+    if (lo <= 1 && q >= -4 && q <= 23 && (m & 3) == 1) {
+        if ((m << shift) == hi) {
+            m &= ~(uint64_t)1;
+        }
+    }
+
+    m += m & 1;
+    m >>= 1;
+
+    if (m >= ((uint64_t)2 << JX_MANTISSA_BITS)) {
+        m = (uint64_t)1 << JX_MANTISSA_BITS;
+        power2++;
+    }
+
+    m &= ~((uint64_t)1 << JX_MANTISSA_BITS);
+
+    if (power2 >= JX_INFINITE_POWER) {
+        *mantissa = 0;
+        return JX_INFINITE_POWER;
+    }
+
+    *mantissa = m;
+
+    return (int)power2;
+}
+
+/* ----------------------------------------------------------------------*
+ * Arbitrary-precision decimal, used for the rare inputs that Eisel-Lemire *
+ * cannot round on its own (more than 19 significant digits, close to a   *
+ * halfway point). The value is 0.d[0]d[1]...d[n-1] * 10^decimal_point,    *
+ * and is converted by repeatedly shifting it by powers of two.            *
+ * ----------------------------------------------------------------------*/
+void jx_decimal_trim(jx_decimal *d)
+{
+    while (d->num_digits > 0 && d->digits[d->num_digits - 1] == 0) {
+        d->num_digits--;
+    }
+
+    if (d->num_digits == 0) {
+        d->decimal_point = 0;
+    }
+}
+
+void jx_decimal_set(jx_decimal *d, const char *src, long n)
+{
+    long i = 0;
+    int64_t exp = 0;
+    bool exp_negative = false;
+
+    d->num_digits = 0;
+    d->decimal_point = 0;
+    d->negative = false;
+    d->truncated = false;
+
+    if (i < n && src[i] == '-') {
+        d->negative = true;
+        i++;
+    }
+
+    for (; i < n && jx_is_digit(src[i]); i++) {
+        if (src[i] == '0' && d->num_digits == 0) {
+            continue;
+        }
+
+        if (d->num_digits < JX_DECIMAL_DIGITS) {
+            d->digits[d->num_digits++] = (uint8_t)(src[i] - '0');
+        }
+        else if (src[i] != '0') {
+            d->truncated = true;
+        }
+
+        d->decimal_point++;
+    }
+
+    if (i < n && src[i] == '.') {
+        for (i++; i < n && jx_is_digit(src[i]); i++) {
+            if (src[i] == '0' && d->num_digits == 0) {
+                d->decimal_point--;
+                continue;
+            }
+
+            if (d->num_digits < JX_DECIMAL_DIGITS) {
+                d->digits[d->num_digits++] = (uint8_t)(src[i] - '0');
+            }
+            else if (src[i] != '0') {
+                d->truncated = true;
+            }
+        }
+    }
+
+    if (i < n && (src[i] == 'e' || src[i] == 'E')) {
+        i++;
+
+        if (i < n && (src[i] == '-' || src[i] == '+')) {
+            exp_negative = src[i] == '-';
+            i++;
+        }
+
+        for (; i < n && jx_is_digit(src[i]); i++) {
+            if (exp < JX_MAX_EXP_NUMBER) {
+                exp = exp * 10 + (src[i] - '0');
+            }
+        }
+    }
+
+    d->decimal_point += exp_negative ? -exp : exp;
+
+    jx_decimal_trim(d);
+}
+
+void jx_decimal_right_shift(jx_decimal *d, int k)
+{
+    int r = 0, w = 0;
+    uint64_t n = 0, mask, digit;
+
+    for (; (n >> k) == 0; r++) {
+        if (r >= d->num_digits) {
+            if (n == 0) {
+                d->num_digits = 0;
+                return;
+            }
+
+            while ((n >> k) == 0) {
+                n *= 10;
+                r++;
+            }
+
+            break;
+        }
+
+        n = n * 10 + d->digits[r];
+    }
+
+    d->decimal_point -= r - 1;
+
+    mask = ((uint64_t)1 << k) - 1;
+
+    for (; r < d->num_digits; r++) {
+        digit = n >> k;
+        n &= mask;
+        d->digits[w++] = (uint8_t)digit;
+        n = n * 10 + d->digits[r];
+    }
+
+    while (n > 0) {
+        digit = n >> k;
+        n &= mask;
+
+        if (w < JX_DECIMAL_DIGITS) {
+            d->digits[w++] = (uint8_t)digit;
+        }
+        else if (digit > 0) {
+            d->truncated = true;
+        }
+
+        n *= 10;
+    }
+
+    d->num_digits = w;
+
+    jx_decimal_trim(d);
+}
+
+bool jx_decimal_prefix_less(jx_decimal *d, const char *cutoff)
+{
+    int i;
+
+    for (i = 0; cutoff[i] != '\0'; i++) {
+        if (i >= d->num_digits) {
+            return true;
+        }
+
+        if (d->digits[i] != cutoff[i] - '0') {
+            return d->digits[i] < cutoff[i] - '0';
+        }
+    }
+
+    return false;
+}
+
+void jx_decimal_left_shift(jx_decimal *d, int k)
+{
+    int delta, r, w;
+    uint64_t n = 0, quo, rem;
+
+    delta = jx_shift_cheats[k].delta;
+
+    if (jx_decimal_prefix_less(d, jx_shift_cheats[k].cutoff)) {
+        delta--;
+    }
+
+    r = d->num_digits;
+    w = d->num_digits + delta;
+
+    for (r--; r >= 0; r--) {
+        n += (uint64_t)d->digits[r] << k;
+        quo = n / 10;
+        rem = n - 10 * quo;
+
+        w--;
+
+        if (w < JX_DECIMAL_DIGITS) {
+            d->digits[w] = (uint8_t)rem;
+        }
+        else if (rem != 0) {
+            d->truncated = true;
+        }
+
+        n = quo;
+    }
+
+    while (n > 0) {
+        quo = n / 10;
+        rem = n - 10 * quo;
+
+        w--;
+
+        if (w < JX_DECIMAL_DIGITS) {
+            d->digits[w] = (uint8_t)rem;
+        }
+        else if (rem != 0) {
+            d->truncated = true;
+        }
+
+        n = quo;
+    }
+
+    d->num_digits += delta;
+
+    if (d->num_digits >= JX_DECIMAL_DIGITS) {
+        d->num_digits = JX_DECIMAL_DIGITS;
+    }
+
+    d->decimal_point += delta;
+
+    jx_decimal_trim(d);
+}
+
+void jx_decimal_shift(jx_decimal *d, int k)
+{
+    if (d->num_digits == 0) {
+        return;
+    }
+
+    if (k > 0) {
+        while (k > JX_DECIMAL_MAX_SHIFT) {
+            jx_decimal_left_shift(d, JX_DECIMAL_MAX_SHIFT);
+            k -= JX_DECIMAL_MAX_SHIFT;
+        }
+
+        jx_decimal_left_shift(d, k);
+    }
+    else if (k < 0) {
+        while (k < -JX_DECIMAL_MAX_SHIFT) {
+            jx_decimal_right_shift(d, JX_DECIMAL_MAX_SHIFT);
+            k += JX_DECIMAL_MAX_SHIFT;
+        }
+
+        jx_decimal_right_shift(d, -k);
+    }
+}
+
+bool jx_decimal_round_up(jx_decimal *d, int64_t nd)
+{
+    if (nd < 0 || nd >= d->num_digits) {
+        return false;
+    }
+
+    /* Exactly halfway, round to even. */
+    if (d->digits[nd] == 5 && nd + 1 == d->num_digits) {
+        if (d->truncated) {
+            return true;
+        }
+
+        return nd > 0 && (d->digits[nd - 1] % 2) != 0;
+    }
+
+    return d->digits[nd] >= 5;
+}
+
+uint64_t jx_decimal_rounded_integer(jx_decimal *d)
+{
+    int64_t i;
+    uint64_t n = 0;
+
+    if (d->decimal_point > 20) {
+        return UINT64_MAX;
+    }
+
+    for (i = 0; i < d->decimal_point && i < d->num_digits; i++) {
+        n = n * 10 + d->digits[i];
+    }
+
+    for (; i < d->decimal_point; i++) {
+        n *= 10;
+    }
+
+    if (jx_decimal_round_up(d, d->decimal_point)) {
+        n++;
+    }
+
+    return n;
+}
+
+double jx_decimal_to_double(jx_decimal *d)
+{
+    static const int powtab[] = { 1, 3, 6, 9, 13, 16, 19, 23, 26 };
+
+    uint64_t mantissa;
+    int64_t exp;
+    int n;
+
+    if (d->num_digits == 0 || d->decimal_point < -330) {
+        return jx_double_from_bits(0, 0, d->negative);
+    }
+
+    if (d->decimal_point > 310) {
+        return jx_double_from_bits(0, JX_INFINITE_POWER, d->negative);
+    }
+
+    exp = 0;
+
+    /* Scale to [1/2, 1), keeping track of the power of two. */
+    while (d->decimal_point > 0) {
+        n = (d->decimal_point >= 9) ? 27 : powtab[d->decimal_point];
+        jx_decimal_shift(d, -n);
+        exp += n;
+    }
+
+    while (d->num_digits > 0 && (d->decimal_point < 0 || (d->decimal_point == 0 && d->digits[0] < 5))) {
+        n = (-d->decimal_point >= 9) ? 27 : powtab[-d->decimal_point];
+        jx_decimal_shift(d, n);
+        exp -= n;
+    }
+
+    exp--;
+
+    /* Smallest normal exponent is 1 - bias, anything below is denormalized. */
+    if (exp < 1 - JX_EXPONENT_BIAS) {
+        n = (int)(1 - JX_EXPONENT_BIAS - exp);
+        jx_decimal_shift(d, -n);
+        exp += n;
+    }
+
+    if (exp + JX_EXPONENT_BIAS >= JX_INFINITE_POWER) {
+        return jx_double_from_bits(0, JX_INFINITE_POWER, d->negative);
+    }
+
+    jx_decimal_shift(d, 1 + JX_MANTISSA_BITS);
+
+    mantissa = jx_decimal_rounded_integer(d);
+
+    /* Rounding might have added a bit. */
+    if (mantissa == ((uint64_t)2 << JX_MANTISSA_BITS)) {
+        mantissa >>= 1;
+        exp++;
+
+        if (exp + JX_EXPONENT_BIAS >= JX_INFINITE_POWER) {
+            return jx_double_from_bits(0, JX_INFINITE_POWER, d->negative);
+        }
+    }
+
+    if (!(mantissa & ((uint64_t)1 << JX_MANTISSA_BITS))) {
+        exp = -JX_EXPONENT_BIAS;
+    }
+
+    mantissa &= ((uint64_t)1 << JX_MANTISSA_BITS) - 1;
+
+    return jx_double_from_bits(mantissa, (int)(exp + JX_EXPONENT_BIAS), d->negative);
+}
+
+double jx_number_slow_path(const char *src, long n)
+{
+    jx_decimal d;
+
+    jx_decimal_set(&d, src, n);
+
+    return jx_decimal_to_double(&d);
+}
+
+long jx_number_read(const char *src, long n, double *out)
+{
+    long p, int_start, int_end, frac_start, frac_end;
+    uint64_t i, m;
+    int64_t exp_number, exponent;
+    int power2;
+    bool negative, truncated;
+
+    p = 0;
+    i = 0;
+    negative = false;
+    truncated = false;
+    exp_number = 0;
+
+    if (p < n && src[p] == '-') {
+        negative = true;
+        p++;
+    }
+
+    if (p >= n || !jx_is_digit(src[p])) {
+        return -1;
+    }
+
+    int_start = p;
+
+    if (src[p] == '0') {
+        p++;
+    }
+    else {
+        i = jx_read_digits(src, n, &p, 0);
+    }
+
+    int_end = p;
+    frac_start = frac_end = p;
+
+    if (p < n && src[p] == '.') {
+        p++;
+
+        frac_start = p;
+
+        i = jx_read_digits(src, n, &p, i);
+
+        frac_end = p;
+
+        if (frac_end == frac_start) {
+            return -1;
+        }
+    }
+
+    if (p < n && (src[p] == 'e' || src[p] == 'E')) {
+        bool exp_negative = false;
+        long exp_start;
+
+        p++;
+
+        if (p < n && (src[p] == '-' || src[p] == '+')) {
+            exp_negative = src[p] == '-';
+            p++;
+        }
+
+        exp_start = p;
+
+        while (p < n && jx_is_digit(src[p])) {
+            if (exp_number < JX_MAX_EXP_NUMBER) {
+                exp_number = exp_number * 10 + (src[p] - '0');
+            }
+
+            p++;
+        }
+
+        if (p == exp_start) {
+            return -1;
+        }
+
+        if (exp_negative) {
+            exp_number = -exp_number;
+        }
+    }
+
+    exponent = exp_number - (frac_end - frac_start);
+
+    /* The accumulator may have wrapped, rebuild it from the first 19
+     * significant digits and remember whether anything non-zero was lost. */
+    if ((int_end - int_start) + (frac_end - frac_start) > JX_MAX_DIGITS) {
+        long j;
+        int n_sig = 0;
+
+        i = 0;
+        exponent = exp_number;
+
+        for (j = int_start; j < int_end; j++) {
+            if (n_sig == 0 && src[j] == '0') {
+                continue;
+            }
+
+            if (n_sig < JX_MAX_DIGITS) {
+                i = i * 10 + (uint64_t)(src[j] - '0');
+                n_sig++;
+            }
+            else {
+                truncated |= src[j] != '0';
+                exponent++;
+            }
+        }
+
+        for (j = frac_start; j < frac_end; j++) {
+            if (n_sig == 0 && src[j] == '0') {
+                exponent--;
+                continue;
+            }
+
+            if (n_sig < JX_MAX_DIGITS) {
+                i = i * 10 + (uint64_t)(src[j] - '0');
+                n_sig++;
+                exponent--;
+            }
+            else {
+                truncated |= src[j] != '0';
+            }
+        }
+    }
+
+    if (out == NULL) {
+        return p;
+    }
+
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+    /* Clinger: both the mantissa and the power of ten are exact doubles, so a
+     * single correctly rounded multiplication or division gives the result. */
+    if (!truncated && exponent >= -22 && exponent <= 22 && i <= ((uint64_t)1 << 53)) {
+        double d = (double)i;
+
+        d = (exponent < 0) ? d / jx_exact_pow10[-exponent] : d * jx_exact_pow10[exponent];
+
+        *out = negative ? -d : d;
+
+        return p;
+    }
+#endif
+
+    power2 = jx_eisel_lemire(exponent, i, &m);
+
+    /* With digits dropped the true value lies between i and i + 1 (times the
+     * power of ten), if both round the same way then so does the input. */
+    if (truncated) {
+        uint64_t m2;
+
+        if (jx_eisel_lemire(exponent, i + 1, &m2) != power2 || m2 != m) {
+            *out = jx_number_slow_path(src, p);
+            return p;
+        }
+    }
+
+    *out = jx_double_from_bits(m, power2, negative);
+
+    return p;
+}
+
+double jx_number_convert(const char *src, long n)
+{
+    double d = 0.0;
+
+    jx_number_read(src, n, &d);
+
+    return d;
+}
+
+long jx_number_read_int(const char *src, long n, int64_t *out)
+{
+    long p = 0, start;
+    uint64_t i = 0;
+    bool negative = false;
+
+    if (p < n && src[p] == '-') {
+        negative = true;
+        p++;
+    }
+
+    if (p >= n || !jx_is_digit(src[p])) {
+        return -1;
+    }
+
+    start = p;
+
+    if (src[p] == '0') {
+        p++;
+    }
+    else {
+        i = jx_read_digits(src, n, &p, 0);
+    }
+
+    /* Nineteen digits can't wrap the accumulator, but may still not fit; negative zero
+     * is left to jx_number_read(), as integers have no sign of zero. */
+    if (p - start > JX_MAX_DIGITS || i > (uint64_t)INT64_MAX + negative || (negative && i == 0)) {
+        return 0;
+    }
+
+    if (p < n && (src[p] == '.' || src[p] == 'e' || src[p] == 'E')) {
+        return 0;
+    }
+
+    *out = negative ? (int64_t)(0 - i) : (int64_t)i;
+
+    return p;
+}
+
+static const char jx_digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* Write the digits two at a time from the end, then move them to the front. */
+int jx_number_format_int(char *dst, int64_t num)
+{
+    char buf[JX_NUMBER_INT_MAX_LENGTH];
+    char *p = buf + sizeof(buf);
+    uint64_t u = num < 0 ? 0 - (uint64_t)num : (uint64_t)num;
+    int length;
+
+    while (u >= 100) {
+        p -= 2;
+        memcpy(p, jx_digit_pairs + (u % 100) * 2, 2);
+        u /= 100;
+    }
+
+    if (u >= 10) {
+        p -= 2;
+        memcpy(p, jx_digit_pairs + u * 2, 2);
+    }
+    else {
+        *--p = (char)('0' + u);
+    }
+
+    if (num < 0) {
+        *--p = '-';
+    }
+
+    length = (int)(buf + sizeof(buf) - p);
+
+    memcpy(dst, p, length);
+    dst[length] = '\0';
+
+    return length;
+}
+
+/* Shortest round-trip formatting of doubles: Grisu2 (Loitsch, "Printing Floating-Point
+ * Numbers Quickly and Accurately with Integers"). The double and the bounds of the
+ * interval of numbers that round to it are scaled by a cached power of ten into a
+ * range where their digits can be produced with 64-bit integer arithmetic, and digits
+ * are generated only until the number they spell lies within the interval. The result
+ * always reads back as the same double, and is the shortest such number for all but a
+ * small fraction of doubles (which get one more digit than they need). */
+
+typedef struct
+{
+    uint64_t f;
+    int e;
+} jx_diy_fp;
+
+static const uint64_t jx_pow10_u64[] =
+{
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+jx_diy_fp jx_diy_fp_mul(jx_diy_fp a, jx_diy_fp b)
+{
+    jx_diy_fp r;
+    uint64_t lo, hi;
+
+    lo = jx_mul_128(a.f, b.f, &hi);
+
+    /* Round the low half away. */
+    r.f = hi + (lo >> 63);
+    r.e = a.e + b.e + 64;
+
+    return r;
+}
+
+jx_diy_fp jx_diy_fp_normalize(jx_diy_fp v)
+{
+    int shift = jx_clz64(v.f);
+
+    v.f <<= shift;
+    v.e -= shift;
+
+    return v;
+}
+
+/* Move the last digit towards w while that stays inside the interval (of width delta)
+ * and brings the digits closer to w. */
+void jx_grisu_round(char *digits, int length, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+        (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        digits[length - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+/* Generate the digits of mp (the upper bound of the interval, scaled), stopping as soon as
+ * the rest is within delta of it; k is adjusted to the exponent of the last digit. */
+void jx_grisu_digits(jx_diy_fp w, jx_diy_fp mp, uint64_t delta, char *digits, int *length, int *k)
+{
+    jx_diy_fp one;
+    uint64_t wp_w, p2, rest;
+    uint32_t p1, d;
+    int kappa;
+
+    one.f = (uint64_t)1 << -mp.e;
+    one.e = mp.e;
+
+    wp_w = mp.f - w.f;
+
+    p1 = (uint32_t)(mp.f >> -one.e);
+    p2 = mp.f & (one.f - 1);
+
+    for (kappa = 1; kappa < 10 && p1 >= jx_pow10_u64[kappa]; kappa++) {
+        continue;
+    }
+
+    *length = 0;
+
+    /* The integral part. */
+    while (kappa > 0) {
+        d = p1 / (uint32_t)jx_pow10_u64[kappa - 1];
+        p1 %= (uint32_t)jx_pow10_u64[kappa - 1];
+
+        if (d != 0 || *length > 0) {
+            digits[(*length)++] = (char)('0' + d);
+        }
+
+        kappa--;
+
+        rest = ((uint64_t)p1 << -one.e) + p2;
+
+        if (rest <= delta) {
+            *k += kappa;
+            jx_grisu_round(digits, *length, delta, rest, jx_pow10_u64[kappa] << -one.e, wp_w);
+            return;
+        }
+    }
+
+    /* The fractional part. */
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+
+        d = (uint32_t)(p2 >> -one.e);
+
+        if (d != 0 || *length > 0) {
+            digits[(*length)++] = (char)('0' + d);
+        }
+
+        p2 &= one.f - 1;
+        kappa--;
+
+        if (p2 < delta) {
+            *k += kappa;
+            jx_grisu_round(digits, *length, delta, p2, one.f, (-kappa < 20) ? wp_w * jx_pow10_u64[-kappa] : 0);
+            return;
+        }
+    }
+}
+
+/* Write the digits of the positive, finite num, which is digits * 10^k. */
+void jx_grisu2(double num, char *digits, int *length, int *k)
+{
+    jx_diy_fp v, w, plus, minus, c;
+    uint64_t bits;
+    int biased_e, index;
+    double dk;
+
+    memcpy(&bits, &num, sizeof(bits));
+
+    biased_e = (int)((bits >> JX_MANTISSA_BITS) & JX_INFINITE_POWER);
+    v.f = bits & (((uint64_t)1 << JX_MANTISSA_BITS) - 1);
+
+    if (biased_e != 0) {
+        v.f += (uint64_t)1 << JX_MANTISSA_BITS;
+        v.e = biased_e - JX_EXPONENT_BIAS - JX_MANTISSA_BITS;
+    }
+    else {
+        v.e = 1 - JX_EXPONENT_BIAS - JX_MANTISSA_BITS;
+    }
+
+    /* The bounds are halfway to the neighbouring doubles, the lower one closer when v is
+     * a power of two (the gap below it being half the size). */
+    plus.f = (v.f << 1) + 1;
+    plus.e = v.e - 1;
+    plus = jx_diy_fp_normalize(plus);
+
+    if (v.f == (uint64_t)1 << JX_MANTISSA_BITS) {
+        minus.f = (v.f << 2) - 1;
+        minus.e = v.e - 2;
+    }
+    else {
+        minus.f = (v.f << 1) - 1;
+        minus.e = v.e - 1;
+    }
+
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    /* The cached power that brings the exponent of plus into [-60, -32]. */
+    dk = (-61 - plus.e) * 0.30102999566398114 + 347;
+    index = (int)dk;
+
+    if (dk - index > 0.0) {
+        index++;
+    }
+
+    index = (index >> 3) + 1;
+
+    *k = -(JX_CACHED_POW10_MIN_K + index * JX_CACHED_POW10_STEP);
+
+    c.f = jx_cached_pow10_f[index];
+    c.e = jx_cached_pow10_e[index];
+
+    w = jx_diy_fp_mul(jx_diy_fp_normalize(v), c);
+    plus = jx_diy_fp_mul(plus, c);
+    minus = jx_diy_fp_mul(minus, c);
+
+    /* Stay clear of the bounds themselves, which the scaling may have moved by one. */
+    plus.f--;
+    minus.f++;
+
+    jx_grisu_digits(w, plus, plus.f - minus.f, digits, length, k);
+}
+
+/* Lay the digits out as JavaScript does (as JSON.stringify() would): in positional
+ * notation from 1e-6 up to 1e21, with an exponent outside of that. Doubles that are
+ * integers below 2^53 take the integer path. */
+int jx_number_format_double(char *dst, double num)
+{
+    char digits[32], *p = dst;
+    int length, k, n, exp;
+
+    if (signbit(num)) {
+        *p++ = '-';
+        num = -num;
+    }
+
+    if (num == 0) {
+        *p++ = '0';
+        *p = '\0';
+
+        return (int)(p - dst);
+    }
+
+    if (num < 9007199254740992.0 && num == (double)(int64_t)num) {
+        return (int)(p - dst) + jx_number_format_int(p, (int64_t)num);
+    }
+
+    jx_grisu2(num, digits, &length, &k);
+
+    /* The position of the decimal point relative to the first digit. */
+    n = length + k;
+
+    if (length <= n && n <= 21) {
+        memcpy(p, digits, length);
+        memset(p + length, '0', n - length);
+        p += n;
+    }
+    else if (n > 0 && n <= 21) {
+        memcpy(p, digits, n);
+        p += n;
+        *p++ = '.';
+        memcpy(p, digits + n, length - n);
+        p += length - n;
+    }
+    else if (n > -6 && n <= 0) {
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', -n);
+        p += -n;
+        memcpy(p, digits, length);
+        p += length;
+    }
+    else {
+        *p++ = digits[0];
+
+        if (length > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, length - 1);
+            p += length - 1;
+        }
+
+        exp = n - 1;
+
+        *p++ = 'e';
+        *p++ = (exp < 0) ? '-' : '+';
+        p += jx_number_format_int(p, (exp < 0) ? -exp : exp);
+    }
+
+    *p = '\0';
+
+    return (int)(p - dst);
+}
@@ -0,0 +1,79 @@
+/*---------------------------------------------------------------------
+| jx_number.h
+----------------------------------------------------------------------
+| jxutil project
+|
+| Created by Cory Montgomery
+| cory.james.montgomery@gmail.com
+|
+| https://cjmont32.dev/jxutil
+| https://github.com/cjmont32/jxutil
+|
+----------------------------------------------------------------------
+| BSD 2-Clause License
+|
+| Copyright (c) 2018-2023, Cory Montgomery
+|
+| Redistribution and use in source and binary forms, with or without
+| modification, are permitted provided that the following conditions
+| are met:
+|
+|    1. Redistributions of source code must retain the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer.
+|    2. Redistributions in binary form must reproduce the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer in the documentation and/or other materials
+|       provided with the distribution.
+|
+| THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+| "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+| LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+| FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+| COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+| INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+| BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+| LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+| CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+| LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+| WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+| POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Locale-independent conversion between JSON number text and doubles.
+ *
+ * jx_number_read() validates and converts the JSON number at the start of src,
+ * reading no more than n bytes; it returns the number of bytes that make up the
+ * number, or -1 if src does not start with a valid number. Conversion is exact
+ * for integers up to 2^53 and correctly rounded for everything else: Clinger's
+ * fast path, then Eisel-Lemire on the first 19 significant digits, then an
+ * arbitrary-precision decimal for the cases Eisel-Lemire cannot decide. */
+
+bool jx_number_char(char c);
+long jx_number_read(const char *src, long n, double *out);
+double jx_number_convert(const char *src, long n);
+
+/* jx_number_read_int() is the integer fast path: it reads a JSON number with no
+ * fraction or exponent that fits in an int64_t, returning its length as above,
+ * or 0 if src starts with any other number (which jx_number_read() then reads).
+ * jx_number_format_int() writes num, null-terminated, to dst (which must have
+ * room for JX_NUMBER_INT_MAX_LENGTH bytes) and returns its length. */
+
+#define JX_NUMBER_INT_MAX_LENGTH 21
+
+long jx_number_read_int(const char *src, long n, int64_t *out);
+int jx_number_format_int(char *dst, int64_t num);
+
+/* jx_number_format_double() writes the shortest number that reads back as num (finite,
+ * null-terminated) to dst, which must have room for JX_NUMBER_DOUBLE_MAX_LENGTH bytes,
+ * and returns its length. */
+
+#define JX_NUMBER_DOUBLE_MAX_LENGTH 32
+
+int jx_number_format_double(char *dst, double num);
@@ -0,0 +1,404 @@
+/*---------------------------------------------------------------------
+| jx_parallel.c
+----------------------------------------------------------------------
+| jxutil project
+|
+| Created by Cory Montgomery
+| cory.james.montgomery@gmail.com
+|
+| https://cjmont32.dev/jxutil
+| https://github.com/cjmont32/jxutil
+|
+----------------------------------------------------------------------
+| BSD 2-Clause License
+|
+| Copyright (c) 2018-2023, Cory Montgomery
+|
+| Redistribution and use in source and binary forms, with or without
+| modification, are permitted provided that the following conditions
+| are met:
+|
+|    1. Redistributions of source code must retain the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer.
+|    2. Redistributions in binary form must reproduce the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer in the documentation and/or other materials
+|       provided with the distribution.
+|
+| THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+| "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+| LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+| FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+| COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+| INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+| BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+| LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+| CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+| LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+| WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+| POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define JX_INTERNAL
+
+#include <errno.h>
+#include <string.h>
+
+#include <jx.h>
+#include <jx_util.h>
+
+#ifndef WIN32
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+/* Parallel serialization.
+ *
+ * The members of a large array or object are split into contiguous ranges, several per
+ * thread so that ranges of uneven cost even out, which the threads take in turn from a
+ * shared counter and serialize into a buffer each. A range starts with the comma that
+ * separates it from the one before, so the document is just the ranges in order between
+ * the brackets: written to a descriptor with writev(), or copied into a single buffer,
+ * which the threads also do between them, each range to its own offset.
+ *
+ * The serializer only reads the document (packed arrays are read without being boxed), so
+ * the ranges need no locking; the one thing written is the cache of a container inside a
+ * range (see jxv_set_cache()), which no other range reaches. */
+
+#define JX_PARALLEL_RANGES_PER_THREAD   4
+#define JX_PARALLEL_MIN_RANGE           256
+#define JX_PARALLEL_MAX_THREADS         256
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/* A member of an object, whose key is kept at an offset in a buffer of keys, since the
+ * keys of tries only last until the iterator moves on. */
+typedef struct
+{
+    size_t key, length;
+    jx_value *value;
+} jx_parallel_member;
+
+typedef struct
+{
+    jx_value *value;
+    char open, close;
+
+    jx_parallel_member *members;
+    jx_output keys;
+
+    size_t n_items;
+    size_t n_ranges;
+    int n_threads;
+
+    jx_output *ranges;
+    size_t *offsets;
+    char *dst;
+    bool copying;
+
+    atomic_size_t next;
+    atomic_bool failed;
+} jx_parallel;
+
+void jx_parallel_free(jx_parallel *par)
+{
+    size_t i;
+
+    if (par->ranges != NULL) {
+        for (i = 0; i < par->n_ranges; i++) {
+            free(par->ranges[i].buf);
+        }
+    }
+
+    free(par->ranges);
+    free(par->offsets);
+    free(par->members);
+    free(par->keys.buf);
+}
+
+/* Collect the members of an object, so that it can be split like an array. */
+bool jx_parallel_members(jx_parallel *par)
+{
+    jx_iter iter;
+    const char *key;
+    size_t i = 0, length;
+
+    if ((par->members = malloc(par->n_items * sizeof(jx_parallel_member))) == NULL) {
+        return false;
+    }
+
+    jx_output_init(&par->keys, NULL, NULL);
+    jx_iter_init(&iter, par->value);
+
+    while (jx_iter_next(&iter)) {
+        if (i == par->n_items) {
+            jx_iter_end(&iter);
+            return false;
+        }
+
+        key = jx_iter_key(&iter, &length);
+
+        par->members[i].key = par->keys.length;
+        par->members[i].length = length;
+        par->members[i].value = jx_iter_value(&iter);
+
+        if (!jx_output_put(&par->keys, key, length)) {
+            jx_iter_end(&iter);
+            return false;
+        }
+
+        i++;
+    }
+
+    return !iter.failed && i == par->n_items;
+}
+
+/* Split value into ranges, returning false if it is better (or, short of memory, only
+ * possible) to serialize it on this thread: values other than arrays and objects, small
+ * ones, and those whose caches are up to date. */
+bool jx_parallel_init(jx_parallel *par, jx_value *value, int n_threads)
+{
+    jx_type type = jxv_get_type(value);
+    size_t length;
+
+    memset(par, 0, sizeof(jx_parallel));
+
+    if (type != JX_TYPE_ARRAY && type != JX_TYPE_OBJECT) {
+        return false;
+    }
+
+    if (jxv_get_cache(value, &length) != NULL) {
+        return false;
+    }
+
+    if (n_threads <= 0) {
+        long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        n_threads = (n_cpus > 0) ? (int)n_cpus : 1;
+    }
+
+    if (n_threads > JX_PARALLEL_MAX_THREADS) {
+        n_threads = JX_PARALLEL_MAX_THREADS;
+    }
+
+    par->value = value;
+    par->n_threads = n_threads;
+
+    if (type == JX_TYPE_ARRAY) {
+        par->n_items = jxa_get_length(value);
+        par->open = '[';
+        par->close = ']';
+    }
+    else {
+        par->n_items = jxd_size(value);
+        par->open = '{';
+        par->close = '}';
+    }
+
+    par->n_ranges = (size_t)n_threads * JX_PARALLEL_RANGES_PER_THREAD;
+
+    if (par->n_ranges > par->n_items / JX_PARALLEL_MIN_RANGE) {
+        par->n_ranges = par->n_items / JX_PARALLEL_MIN_RANGE;
+    }
+
+    if (n_threads < 2 || par->n_ranges < 2) {
+        return false;
+    }
+
+    if ((par->ranges = calloc(par->n_ranges, sizeof(jx_output))) == NULL ||
+        (par->offsets = malloc(par->n_ranges * sizeof(size_t))) == NULL ||
+        (type == JX_TYPE_OBJECT && !jx_parallel_members(par))) {
+        jx_parallel_free(par);
+        return false;
+    }
+
+    return true;
+}
+
+bool jx_parallel_range(jx_parallel *par, size_t r)
+{
+    jx_output *out = &par->ranges[r];
+    size_t start = par->n_items * r / par->n_ranges;
+    size_t end = par->n_items * (r + 1) / par->n_ranges;
+    size_t i;
+
+    jx_output_init(out, NULL, NULL);
+
+    if (par->members == NULL) {
+        return jx_serialize_items(out, par->value, start, end);
+    }
+
+    for (i = start; i < end; i++) {
+        jx_parallel_member *member = &par->members[i];
+
+        if (!jx_serialize_member(out, par->keys.buf + member->key, member->length, member->value, i == 0)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void *jx_parallel_worker(void *arg)
+{
+    jx_parallel *par = arg;
+    size_t r;
+
+    while ((r = atomic_fetch_add(&par->next, 1)) < par->n_ranges) {
+        if (par->copying) {
+            memcpy(par->dst + par->offsets[r], par->ranges[r].buf, par->ranges[r].length);
+        }
+        else if (!jx_parallel_range(par, r)) {
+            atomic_store(&par->failed, true);
+        }
+    }
+
+    return NULL;
+}
+
+/* Work through the ranges with up to n_threads threads, the calling one included, which
+ * carries on alone if no others can be started. */
+bool jx_parallel_run(jx_parallel *par)
+{
+    pthread_t threads[JX_PARALLEL_MAX_THREADS];
+    int i, n_started;
+
+    atomic_store(&par->next, 0);
+
+    for (n_started = 0; n_started < par->n_threads - 1; n_started++) {
+        if (pthread_create(&threads[n_started], NULL, jx_parallel_worker, par) != 0) {
+            break;
+        }
+    }
+
+    jx_parallel_worker(par);
+
+    for (i = 0; i < n_started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    return !atomic_load(&par->failed);
+}
+
+/* Equivalent to jx_serialize_json(value, false), using up to n_threads threads, or one per
+ * online processor if n_threads is 0. */
+char *jx_serialize_json_parallel(jx_value *value, int n_threads)
+{
+    jx_parallel par;
+    char *json = NULL;
+    size_t i, length;
+
+    if (!jx_parallel_init(&par, value, n_threads)) {
+        return jx_serialize_json(value, false);
+    }
+
+    if (jx_parallel_run(&par)) {
+        for (i = 0, length = 1; i < par.n_ranges; i++) {
+            par.offsets[i] = length;
+            length += par.ranges[i].length;
+        }
+
+        if ((json = malloc(length + 2)) != NULL) {
+            json[0] = par.open;
+            json[length] = par.close;
+            json[length + 1] = '\0';
+
+            par.dst = json;
+            par.copying = true;
+
+            jx_parallel_run(&par);
+        }
+    }
+
+    jx_parallel_free(&par);
+
+    return json;
+}
+
+bool jx_parallel_writev(jx_parallel *par, int fd)
+{
+    struct iovec *iov;
+    size_t i, n_iov = par->n_ranges + 2;
+    bool success = true;
+
+    if ((iov = malloc(n_iov * sizeof(struct iovec))) == NULL) {
+        return false;
+    }
+
+    iov[0].iov_base = &par->open;
+    iov[0].iov_len = 1;
+
+    for (i = 0; i < par->n_ranges; i++) {
+        iov[i + 1].iov_base = par->ranges[i].buf;
+        iov[i + 1].iov_len = par->ranges[i].length;
+    }
+
+    iov[n_iov - 1].iov_base = &par->close;
+    iov[n_iov - 1].iov_len = 1;
+
+    /* Write in batches of at most IOV_MAX buffers, picking up after partial writes. */
+    for (i = 0; i < n_iov; ) {
+        ssize_t n_written = writev(fd, iov + i, (n_iov - i < IOV_MAX) ? (int)(n_iov - i) : IOV_MAX);
+
+        if (n_written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            success = false;
+            break;
+        }
+
+        while (i < n_iov && (size_t)n_written >= iov[i].iov_len) {
+            n_written -= iov[i++].iov_len;
+        }
+
+        if (n_written > 0) {
+            iov[i].iov_base = (char *)iov[i].iov_base + n_written;
+            iov[i].iov_len -= n_written;
+        }
+    }
+
+    free(iov);
+
+    return success;
+}
+
+/* Equivalent to jx_serialize_to_fd(value, fd, NULL), using up to n_threads threads, or one
+ * per online processor if n_threads is 0. The ranges are written straight from their
+ * buffers, without being copied together. */
+bool jx_serialize_to_fd_parallel(jx_value *value, int fd, int n_threads)
+{
+    jx_parallel par;
+    bool success;
+
+    if (!jx_parallel_init(&par, value, n_threads)) {
+        return jx_serialize_to_fd(value, fd, NULL);
+    }
+
+    success = jx_parallel_run(&par) && jx_parallel_writev(&par, fd);
+
+    jx_parallel_free(&par);
+
+    return success;
+}
+
+#else
+
+char *jx_serialize_json_parallel(jx_value *value, int n_threads)
+{
+    return jx_serialize_json(value, false);
+}
+
+bool jx_serialize_to_fd_parallel(jx_value *value, int fd, int n_threads)
+{
+    return jx_serialize_to_fd(value, fd, NULL);
+}
+
+#endif
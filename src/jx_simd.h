@@ -0,0 +1,194 @@
+/*---------------------------------------------------------------------
+| jx_simd.h
+----------------------------------------------------------------------
+| jxutil project
+|
+| Created by Cory Montgomery
+| cory.james.montgomery@gmail.com
+|
+| https://cjmont32.dev/jxutil
+| https://github.com/cjmont32/jxutil
+|
+----------------------------------------------------------------------
+| BSD 2-Clause License
+|
+| Copyright (c) 2018-2023, Cory Montgomery
+|
+| Redistribution and use in source and binary forms, with or without
+| modification, are permitted provided that the following conditions
+| are met:
+|
+|    1. Redistributions of source code must retain the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer.
+|    2. Redistributions in binary form must reproduce the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer in the documentation and/or other materials
+|       provided with the distribution.
+|
+| THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+| "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+| LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+| FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+| COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+| INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+| BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+| LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+| CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+| LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+| WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+| POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+/* Internal helpers for scanning input a block at a time. The widest instruction
+ * set enabled at compile time is used (AVX2, then SSE2); when neither is
+ * available JX_SIMD_WIDTH is left undefined and callers use their scalar loops.
+ *
+ * Each classifier loads JX_SIMD_WIDTH bytes (unaligned) and returns one bit per
+ * byte, bit i corresponding to src[i]. */
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define JX_SIMD_WIDTH 32
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JX_SIMD_WIDTH 16
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+
+static __inline int jx_ctz32(uint32_t x)
+{
+    unsigned long i;
+
+    _BitScanForward(&i, x);
+
+    return (int)i;
+}
+
+static __inline int jx_msb32(uint32_t x)
+{
+    unsigned long i;
+
+    _BitScanReverse(&i, x);
+
+    return (int)i;
+}
+
+static __inline int jx_popcount32(uint32_t x)
+{
+    x = x - ((x >> 1) & 0x55555555);
+    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+    x = (x + (x >> 4)) & 0x0F0F0F0F;
+
+    return (int)((x * 0x01010101) >> 24);
+}
+#else
+/* Index of the lowest set bit, x must not be zero. */
+static inline int jx_ctz32(uint32_t x)
+{
+    return __builtin_ctz(x);
+}
+
+/* Index of the highest set bit, x must not be zero. */
+static inline int jx_msb32(uint32_t x)
+{
+    return 31 - __builtin_clz(x);
+}
+
+static inline int jx_popcount32(uint32_t x)
+{
+    return __builtin_popcount(x);
+}
+#endif
+
+#ifdef JX_SIMD_WIDTH
+
+#if JX_SIMD_WIDTH == 32
+
+typedef __m256i jx_simd_vec;
+
+#define jx_simd_load(p)         _mm256_loadu_si256((const __m256i *)(p))
+#define jx_simd_splat(c)        _mm256_set1_epi8((char)(c))
+#define jx_simd_eq(a, b)        _mm256_cmpeq_epi8((a), (b))
+#define jx_simd_lt(a, b)        _mm256_cmpgt_epi8((b), (a))
+#define jx_simd_or(a, b)        _mm256_or_si256((a), (b))
+#define jx_simd_min_u8(a, b)    _mm256_min_epu8((a), (b))
+#define jx_simd_mask(v)         ((uint32_t)_mm256_movemask_epi8(v))
+
+#else
+
+typedef __m128i jx_simd_vec;
+
+#define jx_simd_load(p)         _mm_loadu_si128((const __m128i *)(p))
+#define jx_simd_splat(c)        _mm_set1_epi8((char)(c))
+#define jx_simd_eq(a, b)        _mm_cmpeq_epi8((a), (b))
+#define jx_simd_lt(a, b)        _mm_cmplt_epi8((a), (b))
+#define jx_simd_or(a, b)        _mm_or_si128((a), (b))
+#define jx_simd_min_u8(a, b)    _mm_min_epu8((a), (b))
+#define jx_simd_mask(v)         ((uint32_t)_mm_movemask_epi8(v))
+
+#endif
+
+/* Find the bytes equal to c, e.g. the matching control bytes in a hash table group. */
+static inline uint32_t jx_simd_match(const void *src, uint8_t c)
+{
+    return jx_simd_mask(jx_simd_eq(jx_simd_load(src), jx_simd_splat(c)));
+}
+
+/* Classify the insignificant whitespace accepted by the parser (space, tab,
+ * line feed and vertical tab). The newline and tab masks are subsets of the
+ * returned whitespace mask. */
+static inline uint32_t jx_simd_whitespace(const char *src, uint32_t *newlines, uint32_t *tabs)
+{
+    jx_simd_vec block, nl, tab, ws;
+
+    block = jx_simd_load(src);
+
+    nl = jx_simd_or(jx_simd_eq(block, jx_simd_splat('\n')), jx_simd_eq(block, jx_simd_splat('\v')));
+    tab = jx_simd_eq(block, jx_simd_splat('\t'));
+    ws = jx_simd_or(jx_simd_or(nl, tab), jx_simd_eq(block, jx_simd_splat(' ')));
+
+    *newlines = jx_simd_mask(nl);
+    *tabs = jx_simd_mask(tab);
+
+    return jx_simd_mask(ws);
+}
+
+/* Classify the bytes that end a plain run inside a string literal: quotes,
+ * backslashes, control characters, DEL, and any byte with the high bit set
+ * (the signed compare against 0x20 catches both of the first and last). */
+static inline uint32_t jx_simd_string_special(const char *src)
+{
+    jx_simd_vec block, special;
+
+    block = jx_simd_load(src);
+
+    special = jx_simd_or(jx_simd_eq(block, jx_simd_splat('"')), jx_simd_eq(block, jx_simd_splat('\\')));
+    special = jx_simd_or(special, jx_simd_eq(block, jx_simd_splat(0x7f)));
+    special = jx_simd_or(special, jx_simd_lt(block, jx_simd_splat(0x20)));
+
+    return jx_simd_mask(special);
+}
+
+/* Classify the bytes the serializer escapes: quotes, backslashes and control characters
+ * (the bytes no greater than 0x1f, found with an unsigned minimum). Other bytes, UTF-8
+ * sequences included, are written as they are. */
+static inline uint32_t jx_simd_escape(const char *src)
+{
+    jx_simd_vec block, special;
+
+    block = jx_simd_load(src);
+
+    special = jx_simd_or(jx_simd_eq(block, jx_simd_splat('"')), jx_simd_eq(block, jx_simd_splat('\\')));
+    special = jx_simd_or(special, jx_simd_eq(jx_simd_min_u8(block, jx_simd_splat(0x1f)), block));
+
+    return jx_simd_mask(special);
+}
+
+#endif
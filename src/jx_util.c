@@ -141,4 +141,33 @@ jx_value *jx_obj_from_file(jx_cntx *cntx, const char *filename)
 void jx_set_read_buffer_size(jx_cntx *cntx, size_t sz)
 {
     cntx->read_buffer_size = sz;
+}
+
+/* Write all of data, however many calls to write() that takes. */
+bool jx_write_fd(void *user, const char *data, size_t length)
+{
+    int fd = *(int *)user;
+
+    while (length > 0) {
+        ssize_t n_written = write(fd, data, length);
+
+        if (n_written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        data += n_written;
+        length -= n_written;
+    }
+
+    return true;
+}
+
+/* The file descriptor is expected to block; on failure errno tells why. */
+bool jx_serialize_to_fd(jx_value *value, int fd, const jx_serialize_opts *opts)
+{
+    return jx_serialize_to_sink(value, jx_write_fd, &fd, opts);
 }
\ No newline at end of file
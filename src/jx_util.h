@@ -47,3 +47,32 @@ ssize_t jx_read(jx_cntx *cntx, int fd, size_t n_bytes);
 ssize_t jx_read_block(jx_cntx *cntx, int fd, ssize_t n_bytes);
 jx_value *jx_obj_from_file(jx_cntx *cntx, const char *filename);
 void jx_set_read_buffer_size(jx_cntx *cntx, size_t sz);
+
+bool jx_serialize_to_fd(jx_value *value, int fd, const jx_serialize_opts *opts);
+
+struct jx_writer_t;
+typedef struct jx_writer_t jx_writer;
+
+jx_writer *jx_writer_new(jx_value *value);
+void jx_writer_free(jx_writer *w);
+int jx_writer_write(jx_writer *w, int fd);
+
+char *jx_serialize_json_parallel(jx_value *value, int n_threads);
+bool jx_serialize_to_fd_parallel(jx_value *value, int fd, int n_threads);
+
+bool jx_parse_async_start(jx_cntx *cntx);
+bool jx_parse_async_feed(jx_cntx *cntx, const char *buf, size_t n);
+int jx_parse_async_finish(jx_cntx *cntx);
+void jx_parse_async_cancel(jx_cntx *cntx);
+
+struct jx_mux_t;
+typedef struct jx_mux_t jx_mux;
+
+typedef void (*jx_mux_cb)(jx_mux *mux, int fd, jx_cntx *cntx, jx_value *root, void *user);
+
+jx_mux *jx_mux_new(jx_mux_cb cb, void *user);
+void jx_mux_free(jx_mux *mux);
+bool jx_mux_add(jx_mux *mux, int fd, jx_cntx *cntx);
+bool jx_mux_remove(jx_mux *mux, int fd);
+size_t jx_mux_get_size(jx_mux *mux);
+int jx_mux_run(jx_mux *mux, int timeout);
@@ -40,12 +40,14 @@
 | POSSIBILITY OF SUCH DAMAGE.
 */
 
+#define JX_INTERNAL
 #define JX_VALUE_INTERNAL
 
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
 #include <math.h>
+#include <stdint.h>
 
 #include <jx.h>
 #include <jx_value.h>
@@ -59,33 +61,276 @@ jx_type jxv_get_type(jx_value *value)
     return value->type;
 }
 
-jx_value *jxv_new(jx_type type)
+/* Values allocated from an arena are flagged, so that jxv_free() knows to leave them
+ * alone; containers and strings also keep the arena in their payload, so that they grow
+ * inside the same arena. */
+jx_value *jxv_new(jx_arena *arena, jx_type type)
 {
     jx_value *value;
 
-    if ((value = calloc(1, sizeof(jx_value))) == NULL) {
+    if ((value = jx_mem_calloc(arena, sizeof(jx_value))) == NULL) {
         return NULL;
     }
 
     value->type = type;
 
+    if (arena != NULL) {
+        value->flags |= JX_VALUE_FLAG_ARENA;
+    }
+
     return value;
 }
 
+/* Only containers and strings remember their arena; NULL is returned for scalars. */
+jx_arena *jxv_get_arena(jx_value *value)
+{
+    if (value == NULL || value->v.vp == NULL) {
+        return NULL;
+    }
+
+    switch (value->type) {
+    case JX_TYPE_ARRAY:
+        return value->v.va->arena;
+    case JX_TYPE_OBJECT:
+        return (value->flags & JX_VALUE_FLAG_TRIE) ? value->v.vt->arena : value->v.vo->arena;
+    case JX_TYPE_STRING:
+        return (value->flags & JX_VALUE_FLAG_INLINE) ? NULL : value->v.vs->arena;
+    default:
+        return NULL;
+    }
+}
+
+/* Serialization caches (see jxv_set_cache()).
+ *
+ * A container's cache hangs off its payload, which leaves values that don't use one
+ * alone. Serializing a container whose cache is stale stores fresh caches for all the
+ * containers inside it, so a stale cache only ever has stale caches above it: marking a
+ * change stops at the first one, and costs no more than the path to it. */
+
+jx_cache **jxv_cache_slot(jx_value *value)
+{
+    if (value == NULL || value->v.vp == NULL) {
+        return NULL;
+    }
+
+    switch (value->type) {
+    case JX_TYPE_ARRAY:
+        return &value->v.va->cache;
+    case JX_TYPE_OBJECT:
+        return (value->flags & JX_VALUE_FLAG_TRIE) ? &value->v.vt->cache : &value->v.vo->cache;
+    default:
+        return NULL;
+    }
+}
+
+jx_cache *jxv_cache(jx_value *value)
+{
+    jx_cache **slot = jxv_cache_slot(value);
+
+    return (slot != NULL) ? *slot : NULL;
+}
+
+void jxv_cache_free(jx_value *value)
+{
+    jx_cache **slot = jxv_cache_slot(value);
+
+    if (slot != NULL && *slot != NULL) {
+        free((*slot)->data);
+        free(*slot);
+        *slot = NULL;
+    }
+}
+
+/* Turn the caches of the containers inside value on or off (the arrays holding only
+ * numbers, including the packed ones, have none). */
+bool jxv_set_cache_items(jx_value *value, bool enabled)
+{
+    jx_iter iter;
+    jx_value *item;
+    size_t i = 0;
+
+    if (value->type == JX_TYPE_ARRAY) {
+        if (value->flags & JX_VALUE_FLAG_PACKED) {
+            return true;
+        }
+
+        for (i = 0; i < value->v.va->length; i++) {
+            item = value->v.va->items[i];
+
+            if (jxv_cache_slot(item) == NULL) {
+                continue;
+            }
+
+            if (!enabled) {
+                jxv_set_cache(item, false);
+            }
+            else if (jxv_set_cache(item, true)) {
+                jxv_cache(item)->parent = value;
+            }
+            else {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    jx_iter_init(&iter, value);
+
+    while (jx_iter_next(&iter)) {
+        item = jx_iter_value(&iter);
+
+        if (jxv_cache_slot(item) == NULL) {
+            continue;
+        }
+
+        if (!enabled) {
+            jxv_set_cache(item, false);
+        }
+        else if (jxv_set_cache(item, true)) {
+            jxv_cache(item)->parent = value;
+        }
+        else {
+            jx_iter_end(&iter);
+            return false;
+        }
+    }
+
+    return !iter.failed;
+}
+
+bool jxv_set_cache(jx_value *value, bool enabled)
+{
+    jx_cache **slot = jxv_cache_slot(value);
+
+    if (slot == NULL) {
+        return false;
+    }
+
+    if (!enabled) {
+        if (*slot != NULL) {
+            jxv_cache_free(value);
+            jxv_set_cache_items(value, false);
+        }
+
+        return true;
+    }
+
+    if (*slot != NULL) {
+        return true;
+    }
+
+    if ((value->flags & JX_VALUE_FLAG_ARENA) || (*slot = calloc(1, sizeof(jx_cache))) == NULL) {
+        return false;
+    }
+
+    if (!jxv_set_cache_items(value, true)) {
+        jxv_set_cache(value, false);
+        return false;
+    }
+
+    return true;
+}
+
+/* Mark the cache of a container that is changing as stale, along with those above it. */
+void jxv_cache_invalidate(jx_value *value)
+{
+    jx_cache *cache;
+
+    while ((cache = jxv_cache(value)) != NULL && cache->valid) {
+        cache->valid = false;
+        value = cache->parent;
+    }
+}
+
+/* A container added to one that has a cache gets one too, so that changes to it are seen. */
+bool jxv_cache_adopt(jx_value *parent, jx_value *value)
+{
+    if (jxv_cache(parent) == NULL || jxv_cache_slot(value) == NULL) {
+        return true;
+    }
+
+    if (!jxv_set_cache(value, true)) {
+        return false;
+    }
+
+    jxv_cache(value)->parent = parent;
+
+    return true;
+}
+
+/* A container taken out of another one no longer changes it. */
+void jxv_cache_detach(jx_value *value)
+{
+    jx_cache *cache = jxv_cache(value);
+
+    if (cache != NULL) {
+        cache->parent = NULL;
+    }
+}
+
+bool jxv_has_cache(jx_value *value)
+{
+    return jxv_cache(value) != NULL;
+}
+
+/* The bytes a container was last serialized to, or NULL if it has changed since. */
+const char *jxv_get_cache(jx_value *value, size_t *length)
+{
+    jx_cache *cache = jxv_cache(value);
+
+    if (cache == NULL || !cache->valid) {
+        return NULL;
+    }
+
+    *length = cache->length;
+
+    return cache->data;
+}
+
+/* Store the bytes a container has been serialized to, taking ownership of data (which is
+ * left to the caller if the container has no cache). */
+bool jxv_put_cache(jx_value *value, char *data, size_t length)
+{
+    jx_cache *cache = jxv_cache(value);
+
+    if (cache == NULL) {
+        return false;
+    }
+
+    free(cache->data);
+
+    cache->data = data;
+    cache->length = length;
+    cache->valid = true;
+
+    return true;
+}
+
 jx_value *jxa_new(size_t capacity)
+{
+    return jxa_new_arena(NULL, capacity);
+}
+
+jx_value *jxa_new_arena(jx_arena *arena, size_t capacity)
 {
     jx_value *array;
 
-    if ((array = jxv_new(JX_TYPE_ARRAY)) == NULL) {
+    if ((array = jxv_new(arena, JX_TYPE_ARRAY)) == NULL) {
         return NULL;
     }
 
-    if ((array->v.vpp = malloc(sizeof(jx_value *) * capacity)) == NULL) {
-        free(array);
+    if ((array->v.va = jx_mem_alloc(arena, sizeof(jx_array) + sizeof(jx_value) * capacity)) == NULL) {
+        jx_mem_free(arena, array);
         return NULL;
     }
 
-    array->size = capacity;
+    array->v.va->size = capacity;
+    array->v.va->length = 0;
+    array->v.va->arena = arena;
+    array->v.va->cache = NULL;
+
+    array->flags |= JX_VALUE_FLAG_PACKED;
 
     return array;
 }
@@ -96,13 +341,17 @@ size_t jxa_get_length(jx_value *array)
         return 0;
     }
 
-    return array->length;
+    return array->v.va->length;
 }
 
 jx_type jxa_get_type(jx_value *array, size_t i)
 {
     jx_value *value;
 
+    if (array != NULL && array->type == JX_TYPE_ARRAY && (array->flags & JX_VALUE_FLAG_PACKED)) {
+        return i < array->v.va->length ? JX_TYPE_NUMBER : JX_TYPE_UNDEF;
+    }
+
     if ((value = jxa_get(array, i)) == NULL) {
         return JX_TYPE_UNDEF;
     }
@@ -110,57 +359,207 @@ jx_type jxa_get_type(jx_value *array, size_t i)
     return value->type;
 }
 
+/* Packed arrays hold values, boxed ones pointers to them. */
+size_t jxa_item_size(jx_value *array)
+{
+    return (array->flags & JX_VALUE_FLAG_PACKED) ? sizeof(jx_value) : sizeof(jx_value *);
+}
+
+/* Box the numbers of a packed array into a new payload, leaving the array as it was if
+ * that fails. */
+bool jxa_unpack(jx_value *array)
+{
+    jx_array *arr = array->v.va, *boxed;
+    jx_value *records = JX_ARRAY_RECORDS(arr);
+    size_t i;
+
+    if (!(array->flags & JX_VALUE_FLAG_PACKED)) {
+        return true;
+    }
+
+    if ((boxed = jx_mem_alloc(arr->arena, sizeof(jx_array) + sizeof(jx_value *) * arr->size)) == NULL) {
+        return false;
+    }
+
+    for (i = 0; i < arr->length; i++) {
+        jx_value *value;
+
+        if (records[i].flags & JX_VALUE_FLAG_INT) {
+            value = jxv_int_new_arena(arr->arena, records[i].v.vi);
+        }
+        else {
+            value = jxv_number_new_arena(arr->arena, records[i].v.vf);
+        }
+
+        if (value == NULL) {
+            while (i-- > 0) {
+                jxv_free(boxed->items[i]);
+            }
+
+            jx_mem_free(arr->arena, boxed);
+
+            return false;
+        }
+
+        boxed->items[i] = value;
+    }
+
+    boxed->size = arr->size;
+    boxed->length = arr->length;
+    boxed->arena = arr->arena;
+    boxed->cache = arr->cache;
+
+    jx_mem_free(arr->arena, arr);
+
+    array->v.va = boxed;
+    array->flags &= ~JX_VALUE_FLAG_PACKED;
+
+    return true;
+}
+
+/* Make room for one more item. */
+bool jxa_reserve(jx_value *array)
+{
+    jx_array *arr = array->v.va;
+    size_t itemSize = jxa_item_size(array);
+
+    if (arr->length == arr->size) {
+        jx_array *newArray;
+        size_t newSize;
+
+        newSize = arr->size > 0 ? arr->size * 2 : 4;
+        newArray = jx_mem_realloc(arr->arena, arr, sizeof(jx_array) + itemSize * arr->size,
+            sizeof(jx_array) + itemSize * newSize);
+
+        if (newArray == NULL) {
+            return false;
+        }
+
+        array->v.va = newArray;
+        newArray->size = newSize;
+    }
+
+    return true;
+}
+
+/* The items of a packed array are handed out as their records, so reading never
+ * changes the array. */
 jx_value *jxa_get(jx_value *array, size_t i)
 {
-    if (array == NULL || array->type != JX_TYPE_ARRAY || i >= array->length) {
+    if (array == NULL || array->type != JX_TYPE_ARRAY || i >= array->v.va->length) {
+        return NULL;
+    }
+
+    if (array->flags & JX_VALUE_FLAG_PACKED) {
+        return &JX_ARRAY_RECORDS(array->v.va)[i];
+    }
+
+    return array->v.va->items[i];
+}
+
+/* Add a number record to a packed array, to be filled in by the caller. */
+jx_value *jxa_push_record(jx_value *array)
+{
+    jx_value *record;
+
+    if (!jxa_reserve(array)) {
         return NULL;
     }
 
-    return array->v.vpp[i];
+    jxv_cache_invalidate(array);
+
+    record = &JX_ARRAY_RECORDS(array->v.va)[array->v.va->length++];
+
+    memset(record, 0, sizeof(jx_value));
+    record->type = JX_TYPE_NUMBER;
+    record->flags = JX_VALUE_FLAG_ITEM;
+
+    return record;
 }
 
+/* A number pushed to a packed array is copied into a record of its own, and the value
+ * freed; anything else boxes the array. */
 bool jxa_push(jx_value *array, jx_value *value)
 {
+    jx_value *record;
+
     if (array == NULL || array->type != JX_TYPE_ARRAY) {
         return false;
     }
 
-    if (array->length == array->size) {
-        void **newArray;
-        size_t newSize;
-
-        newSize = array->size * 2;
-        newArray = realloc(array->v.vpp, sizeof(jx_value *) * newSize);
-
-        if (newArray == NULL) {
+    if ((array->flags & JX_VALUE_FLAG_PACKED) && value != NULL && value->type == JX_TYPE_NUMBER) {
+        if ((record = jxa_push_record(array)) == NULL) {
             return false;
         }
 
-        array->v.vpp = newArray;
-        array->size = newSize;
+        record->v = value->v;
+        record->flags |= value->flags & JX_VALUE_FLAG_INT;
+
+        jxv_free(value);
+
+        return true;
+    }
+
+    if (!jxa_unpack(array) || !jxa_reserve(array) || !jxv_cache_adopt(array, value)) {
+        return false;
     }
 
-    array->v.vpp[array->length++] = value;
+    jxv_cache_invalidate(array);
+
+    array->v.va->items[array->v.va->length++] = value;
 
     return true;
 }
 
+/* The number popped from a packed array is returned in a new value. */
 jx_value *jxa_pop(jx_value * array)
 {
-    if (array == NULL || array->type != JX_TYPE_ARRAY || array->length == 0) {
+    jx_array *arr;
+
+    if (array == NULL || array->type != JX_TYPE_ARRAY || array->v.va->length == 0) {
         return NULL;
     }
 
-    return array->v.vpp[--array->length];
+    arr = array->v.va;
+
+    jxv_cache_invalidate(array);
+
+    if (array->flags & JX_VALUE_FLAG_PACKED) {
+        jx_value *record = &JX_ARRAY_RECORDS(arr)[arr->length - 1];
+        jx_value *value;
+
+        if (record->flags & JX_VALUE_FLAG_INT) {
+            value = jxv_int_new_arena(arr->arena, record->v.vi);
+        }
+        else {
+            value = jxv_number_new_arena(arr->arena, record->v.vf);
+        }
+
+        if (value != NULL) {
+            arr->length--;
+        }
+
+        return value;
+    }
+
+    jxv_cache_detach(arr->items[arr->length - 1]);
+
+    return arr->items[--arr->length];
 }
 
 jx_value *jxa_top(jx_value *array)
 {
-    if (array == NULL || array->type != JX_TYPE_ARRAY || array->length == 0) {
+    if (array == NULL || array->type != JX_TYPE_ARRAY || array->v.va->length == 0) {
         return NULL;
     }
 
-    return array->v.vpp[array->length - 1];
+    return jxa_get(array, array->v.va->length - 1);
+}
+
+/* Whether the array still holds nothing but numbers, stored in place. */
+bool jxa_is_packed(jx_value *array)
+{
+    return array != NULL && array->type == JX_TYPE_ARRAY && (array->flags & JX_VALUE_FLAG_PACKED);
 }
 
 bool jxa_push_number(jx_value *array, double num)
@@ -171,7 +570,17 @@ bool jxa_push_number(jx_value *array, double num)
         return false;
     }
 
-    if ((value = jxv_number_new(num)) == NULL) {
+    if (array->flags & JX_VALUE_FLAG_PACKED) {
+        if ((value = jxa_push_record(array)) == NULL) {
+            return false;
+        }
+
+        value->v.vf = num;
+
+        return true;
+    }
+
+    if ((value = jxv_number_new_arena(array->v.va->arena, num)) == NULL) {
         return false;
     }
 
@@ -183,17 +592,94 @@ bool jxa_push_number(jx_value *array, double num)
     return true;
 }
 
-double jxa_get_number(jx_value *array, size_t i)
+bool jxa_push_int(jx_value *array, int64_t num)
 {
     jx_value *value;
 
-    value = jxa_get(array, i);
+    if (array == NULL || array->type != JX_TYPE_ARRAY) {
+        return false;
+    }
+
+    if (array->flags & JX_VALUE_FLAG_PACKED) {
+        if ((value = jxa_push_record(array)) == NULL) {
+            return false;
+        }
+
+        value->v.vi = num;
+        value->flags |= JX_VALUE_FLAG_INT;
+
+        return true;
+    }
+
+    if ((value = jxv_int_new_arena(array->v.va->arena, num)) == NULL) {
+        return false;
+    }
+
+    if (!jxa_push(array, value)) {
+        jxv_free(value);
+        return false;
+    }
+
+    return true;
+}
 
-    if (value == NULL || value->type != JX_TYPE_NUMBER) {
+double jxa_get_number(jx_value *array, size_t i)
+{
+    if (jxa_get_type(array, i) != JX_TYPE_NUMBER) {
         return 0.0;
     }
 
-    return value->v.vf;
+    return jxv_get_number(jxa_get(array, i));
+}
+
+int64_t jxa_get_int(jx_value *array, size_t i)
+{
+    return jxv_get_int(jxa_get(array, i));
+}
+
+bool jxa_is_int(jx_value *array, size_t i)
+{
+    return jxv_is_int(jxa_get(array, i));
+}
+
+/* Copy up to n numbers, starting with item offset, to out, returning how many were
+ * copied (fewer than n only at the end of the array). Items that aren't numbers are
+ * copied as 0, as by jxa_get_number(). */
+size_t jxa_get_numbers(jx_value *array, double *out, size_t offset, size_t n)
+{
+    jx_array *arr;
+    size_t i;
+
+    if (array == NULL || array->type != JX_TYPE_ARRAY || out == NULL) {
+        return 0;
+    }
+
+    arr = array->v.va;
+
+    if (offset >= arr->length) {
+        return 0;
+    }
+
+    if (n > arr->length - offset) {
+        n = arr->length - offset;
+    }
+
+    if (array->flags & JX_VALUE_FLAG_PACKED) {
+        jx_value *records = JX_ARRAY_RECORDS(arr) + offset;
+
+        for (i = 0; i < n; i++) {
+            out[i] = jxv_get_number(&records[i]);
+        }
+    }
+    else {
+        for (i = 0; i < n; i++) {
+            jx_value *value = arr->items[offset + i];
+
+            out[i] = value->type == JX_TYPE_NUMBER ? jxv_get_number(value) : 0.0;
+        }
+    }
+
+    return n;
 }
 
 bool jxa_push_ptr(jx_value *array, void *ptr)
@@ -204,7 +690,7 @@ bool jxa_push_ptr(jx_value *array, void *ptr)
         return false;
     }
 
-    if ((value = jxv_new(JX_TYPE_PTR)) == NULL) {
+    if ((value = jxv_new(array->v.va->arena, JX_TYPE_PTR)) == NULL) {
         return false;
     }
 
@@ -236,7 +722,10 @@ void *jxv_get_ptr(jx_value *value)
     return value->v.vp;
 }
 
-void jx_trie_reduce_key_charset(char *dst_key, unsigned char *src_key, size_t dst_size)
+/* Spell out each of the length bytes of src_key (null bytes included) as two nibbles,
+ * offset by one so that the result, which needs length * 2 + 1 bytes, ends at its only
+ * null byte. */
+void jx_trie_reduce_key_charset(char *dst_key, const unsigned char *src_key, size_t length)
 {
     size_t src_i, dst_i;
 
@@ -244,40 +733,9 @@ void jx_trie_reduce_key_charset(char *dst_key, unsigned char *src_key, size_t ds
         return;
     }
 
-    src_i = 0;
-
-    for (dst_i = 0; dst_i < dst_size - 2; dst_i += 2) {
-        if (!src_key[src_i]) {
-            break;
-        }
-
+    for (src_i = 0, dst_i = 0; src_i < length; src_i++, dst_i += 2) {
         dst_key[dst_i] = (src_key[src_i] >> 4) + 1;
         dst_key[dst_i + 1] = (src_key[src_i] & 0x0F) + 1;
-
-        src_i++;
-    }
-
-    dst_key[dst_i] = '\0';
-}
-
-void jx_trie_expand_key_charset(unsigned char *dst_key, char *src_key, size_t dst_size)
-{
-    size_t src_i, dst_i;
-
-    if (dst_key == NULL || src_key == NULL) {
-        return;
-    }
-
-    src_i = 0;
-
-    for (dst_i = 0; dst_i < dst_size - 1; dst_i++) {
-        if (!src_key[src_i] || !src_key[src_i + 1]) {
-            break;
-        }
-
-        dst_key[dst_i] = ((src_key[src_i] - 1) << 4) | (src_key[src_i + 1] - 1);
-
-        src_i += 2;
     }
 
     dst_key[dst_i] = '\0';
@@ -289,7 +747,7 @@ void jx_trie_expand_key_charset(unsigned char *dst_key, char *src_key, size_t ds
  *
  * The node for the last character in the string is returned, so that the
  * caller can set the object on the it (and free the old one, if required). */
-jx_trie_node *jx_trie_add_key(jx_trie_node *node, char *key, int key_i)
+jx_trie_node *jx_trie_add_key(jx_trie_node *node, char *key, int key_i, jx_arena *arena)
 {
     if (node == NULL || key == NULL) {
         return NULL;
@@ -302,7 +760,7 @@ jx_trie_node *jx_trie_add_key(jx_trie_node *node, char *key, int key_i)
         int next_i = key[key_i] - 1;
 
         if (node->child_nodes[next_i] == NULL) {
-            jx_trie_node * new_ch_node = calloc(1, sizeof(jx_trie_node));
+            jx_trie_node * new_ch_node = jx_mem_calloc(arena, sizeof(jx_trie_node));
 
             if (new_ch_node == NULL) {
                 return NULL;
@@ -313,7 +771,7 @@ jx_trie_node *jx_trie_add_key(jx_trie_node *node, char *key, int key_i)
             node->child_nodes[next_i] = new_ch_node;
         }
 
-        return jx_trie_add_key(node->child_nodes[next_i], key, ++key_i);
+        return jx_trie_add_key(node->child_nodes[next_i], key, ++key_i, arena);
     }
 }
 
@@ -343,7 +801,7 @@ jx_trie_node *jx_trie_get_key(jx_trie_node *node, char *key, int key_i)
 /* Traverse the tree in character order of the key, if an object is found,
  * remove the object from the tree. The object itself is not freed but
  * returned to the caller to be used, or freed if not needed. */
-jx_value *jx_trie_del_key(jx_trie_node *node, char *key, int key_i)
+jx_value *jx_trie_del_key(jx_trie_node *node, char *key, int key_i, jx_arena *arena)
 {
     if (node == NULL || key == NULL) {
         return NULL;
@@ -363,7 +821,7 @@ jx_value *jx_trie_del_key(jx_trie_node *node, char *key, int key_i)
             return NULL;
         }
 
-        jx_value *value = jx_trie_del_key(node->child_nodes[next_i], key, ++key_i);
+        jx_value *value = jx_trie_del_key(node->child_nodes[next_i], key, ++key_i, arena);
 
         /* We have successfully found a key in the trie, check to see if the child
          * branch at our current index is empty and needs to be pruned. */
@@ -385,7 +843,7 @@ jx_value *jx_trie_del_key(jx_trie_node *node, char *key, int key_i)
             }
 
             if (!match) {
-                free(node->child_nodes[next_i]);
+                jx_mem_free(arena, node->child_nodes[next_i]);
                 node->child_nodes[next_i] = NULL;
             }
         }
@@ -394,192 +852,514 @@ jx_value *jx_trie_del_key(jx_trie_node *node, char *key, int key_i)
     }
 }
 
-/* Find all stored keys, invoking the callback passed in for each node that has an object.
- *
- * Details:
- *
- * Perform a depth first traversal of the trie (index tree), starting at the node passed in. This
- * search order discovers keys in lexicograpic order, in terms of byte value for each character.
- *
- * Note that to traverse the entire trie this function should be passed the root node of the trie,
- * and the prefix argument should be initialized (to a jx_value string) but be empty. The function
- * will recursively call itself to visit child nodes, and invoke the callback function for each
- * node that has a stored object, passing the callback the key, stored object, and the pointer
- * passed as the fourth arugment of this function. */
- bool jx_trie_iterate_keys(jx_trie_node *node, jx_value *prefix, jxd_iter_cb cb_func, void *ptr)
+/* The state of a jx_iter over a trie: the path from the root to the current node, each
+ * node with the next of its branches to visit, and the key the path spells. Since the
+ * depth of a trie is unbounded, this is the one part of an iteration that is allocated. */
+typedef struct
 {
-    int i;
+    jx_trie_node *node;
+    int branch;
+    bool visited;
+} jx_trie_iter_frame;
 
-    if (node == NULL || prefix == NULL || cb_func == NULL) {
-        return false;
+struct jx_trie_iter_t
+{
+    jx_trie_iter_frame *path;
+    size_t depth, size;
+
+    char *key;
+};
+
+/* Descend to node, adding its half of a key byte to the key. */
+bool jx_trie_iter_push(struct jx_trie_iter_t *trie, jx_trie_node *node)
+{
+    size_t level = trie->depth;
+
+    if (trie->depth == trie->size) {
+        size_t size = (trie->size > 0) ? trie->size * 2 : 32;
+        jx_trie_iter_frame *path;
+        char *key;
+
+        if ((path = realloc(trie->path, size * sizeof(jx_trie_iter_frame))) == NULL) {
+            return false;
+        }
+
+        trie->path = path;
+
+        if ((key = realloc(trie->key, size / 2 + 1)) == NULL) {
+            return false;
+        }
+
+        trie->key = key;
+        trie->size = size;
     }
 
-    if (!jxs_push(prefix, node->byte)) {
-        return false;
+    /* Below the root, odd levels hold the high half of a byte and even levels the low. */
+    if (level > 0) {
+        unsigned char nibble = node->byte - 1;
+
+        if (level % 2 == 1) {
+            trie->key[level / 2] = nibble << 4;
+        }
+        else {
+            trie->key[level / 2 - 1] = (trie->key[level / 2 - 1] & 0xF0) | nibble;
+        }
     }
 
-    if (node->value != NULL) {
-        int orig_key_size = (prefix->length / 2) + 1;
+    trie->path[trie->depth].node = node;
+    trie->path[trie->depth].branch = 0;
+    trie->path[trie->depth].visited = false;
 
-        char *orig_key = alloca(orig_key_size);
-        char *prefix_key = jxs_get_str(prefix);
+    trie->depth++;
+
+    return true;
+}
 
-        jx_trie_expand_key_charset((unsigned char *)orig_key, prefix_key, orig_key_size);
+void jx_trie_free_branch(jx_trie_node *node)
+{
+    int i;
 
-        cb_func(orig_key, node->value, ptr);
+    if (node == NULL) {
+        return;
     }
 
     for (i = 0; i < 16; i++) {
         if (node->child_nodes[i] != NULL) {
-            jx_trie_iterate_keys(node->child_nodes[i], prefix, cb_func, ptr);
+            jx_trie_free_branch(node->child_nodes[i]);
         }
     }
 
-    jxs_pop(prefix);
+    if (node->value != NULL) {
+        jxv_free(node->value);
+    }
 
-    return true;
+    free(node);
 }
 
-void jx_trie_free_branch(jx_trie_node *node)
+/* The root node is embedded in the object's payload, so only its branches are freed. */
+void jx_trie_free_root(jx_trie_node *root)
 {
     int i;
 
+    for (i = 0; i < 16; i++) {
+        jx_trie_free_branch(root->child_nodes[i]);
+    }
+
+    jxv_free(root->value);
+}
+
+/* The engine used for objects created from now on; see jx_dict_engine. */
+static jx_dict_engine jxd_default_engine = JX_DICT_HASH;
+
+void jxd_set_default_engine(jx_dict_engine engine)
+{
+    jxd_default_engine = engine;
+}
+
+jx_dict_engine jxd_get_default_engine()
+{
+    return jxd_default_engine;
+}
+
+jx_value *jxd_new()
+{
+    return jxd_new_arena(NULL);
+}
+
+jx_value *jxd_new_arena(jx_arena *arena)
+{
+    return jxd_new_keys(arena, 32);
+}
+
+/* A new object with room for keys_size bytes of keys of its own; the parser needs none
+ * once it shares keys through an intern table. */
+jx_value *jxd_new_keys(jx_arena *arena, size_t keys_size)
+{
+    jx_value *value;
+
+    if ((value = jxv_new(arena, JX_TYPE_OBJECT)) == NULL) {
+        return NULL;
+    }
+
+    if (jxd_default_engine == JX_DICT_TRIE) {
+        if ((value->v.vt = jx_mem_calloc(arena, sizeof(jx_trie_object))) == NULL) {
+            jx_mem_free(arena, value);
+            return NULL;
+        }
+
+        value->v.vt->arena = arena;
+        value->flags |= JX_VALUE_FLAG_TRIE;
+    }
+    else {
+        if ((value->v.vo = jx_hash_new(arena, keys_size)) == NULL) {
+            jx_mem_free(arena, value);
+            return NULL;
+        }
+    }
+
+    return value;
+}
+
+size_t jxd_size(jx_value *dict)
+{
+    if (dict == NULL || dict->type != JX_TYPE_OBJECT || dict->v.vp == NULL) {
+        return 0;
+    }
+
+    if (dict->flags & JX_VALUE_FLAG_TRIE) {
+        return dict->v.vt->length;
+    }
+
+    return dict->v.vo->length;
+}
+
+/* Find or add the member for key (which needn't be null-terminated), returning where to
+ * store its value; the old value, if any, is freed. The parser uses this to add each key
+ * as soon as it is read, sharing it from intern (if not NULL) where possible. The slot is
+ * only valid until the next change to the object. */
+jx_value **jxd_put_key(jx_value *dict, jx_intern *intern, const char *key, size_t length)
+{
+    char *lookup_key;
+
+    jx_trie_node *node;
+
+    if (!(dict->flags & JX_VALUE_FLAG_TRIE)) {
+        jx_dict_entry *entry = jx_hash_insert(&dict->v.vo, intern, key, length);
+
+        if (entry == NULL) {
+            return NULL;
+        }
+
+        jxv_free(entry->value);
+        entry->value = NULL;
+
+        return &entry->value;
+    }
+
+    lookup_key = alloca((length * 2) + 1);
+
+    jx_trie_reduce_key_charset(lookup_key, (const unsigned char *)key, length);
+
+    node = jx_trie_add_key(&dict->v.vt->root, lookup_key, 0, dict->v.vt->arena);
+
     if (node == NULL) {
-        return;
+        return NULL;
+    }
+
+    if (node->value != NULL) {
+        jxv_free(node->value);
+        node->value = NULL;
+    }
+    else {
+        dict->v.vt->length++;
+    }
+
+    return &node->value;
+}
+
+bool jxd_put_n(jx_value *dict, const char *key, size_t length, jx_value *value)
+{
+    jx_value **slot;
+
+    if (dict == NULL || dict->type != JX_TYPE_OBJECT || key == NULL || value == NULL) {
+        return false;
+    }
+
+    if (!jxv_cache_adopt(dict, value)) {
+        return false;
+    }
+
+    if ((slot = jxd_put_key(dict, NULL, key, length)) == NULL) {
+        jxv_cache_detach(value);
+        return false;
+    }
+
+    jxv_cache_invalidate(dict);
+
+    *slot = value;
+
+    return true;
+}
+
+bool jxd_put(jx_value *dict, char *key, jx_value *value)
+{
+    if (key == NULL) {
+        return false;
+    }
+
+    return jxd_put_n(dict, key, strlen(key), value);
+}
+
+jx_value *jxd_get_n(jx_value *dict, const char *key, size_t length)
+{
+    char *lookup_key;
+
+    jx_trie_node *node;
+
+    if (dict == NULL || dict->type != JX_TYPE_OBJECT || key == NULL) {
+        return NULL;
+    }
+
+    if (!(dict->flags & JX_VALUE_FLAG_TRIE)) {
+        jx_dict_entry *entry = jx_hash_get(dict->v.vo, key, length);
+
+        return (entry != NULL) ? entry->value : NULL;
+    }
+
+    lookup_key = alloca((length * 2) + 1);
+
+    jx_trie_reduce_key_charset(lookup_key, (const unsigned char *)key, length);
+
+    node = jx_trie_get_key(&dict->v.vt->root, lookup_key, 0);
+
+    if (node == NULL) {
+        return NULL;
+    }
+
+    return node->value;
+}
+
+jx_value *jxd_get(jx_value *dict, char *key)
+{
+    if (key == NULL) {
+        return NULL;
+    }
+
+    return jxd_get_n(dict, key, strlen(key));
+}
+
+/* Tries have no use for the hash, and are searched as for jxd_get_n(). */
+jx_value *jxd_get_k(jx_value *dict, jx_key *key)
+{
+    jx_dict_entry *entry;
+
+    if (dict == NULL || dict->type != JX_TYPE_OBJECT || key == NULL) {
+        return NULL;
+    }
+
+    if (dict->flags & JX_VALUE_FLAG_TRIE) {
+        return jxd_get_n(dict, key->data, key->length);
+    }
+
+    entry = jx_hash_find(dict->v.vo, key->data, key->length, key->hash);
+
+    return (entry != NULL) ? entry->value : NULL;
+}
+
+jx_value *jxd_del_n(jx_value *dict, const char *key, size_t length)
+{
+    char *lookup_key;
+
+    jx_value *value;
+
+    if (dict == NULL || dict->type != JX_TYPE_OBJECT || key == NULL) {
+        return NULL;
+    }
+
+    if (!(dict->flags & JX_VALUE_FLAG_TRIE)) {
+        value = jx_hash_del(dict->v.vo, key, length);
     }
+    else {
+        lookup_key = alloca((length * 2) + 1);
 
-    for (i = 0; i < 16; i++) {
-        if (node->child_nodes[i] != NULL) {
-            jx_trie_free_branch(node->child_nodes[i]);
+        jx_trie_reduce_key_charset(lookup_key, (const unsigned char *)key, length);
+
+        value = jx_trie_del_key(&dict->v.vt->root, lookup_key, 0, dict->v.vt->arena);
+
+        if (value != NULL) {
+            dict->v.vt->length--;
         }
     }
 
-    if (node->value != NULL) {
-        jxv_free(node->value);
+    if (value != NULL) {
+        jxv_cache_invalidate(dict);
+        jxv_cache_detach(value);
     }
 
-    free(node);
+    return value;
 }
 
-jx_value *jxd_new()
+jx_value *jxd_del(jx_value * dict, char *key)
 {
-    jx_value *value;
-
-    if ((value = jxv_new(JX_TYPE_OBJECT)) == NULL) {
+    if (key == NULL) {
         return NULL;
     }
 
-    if ((value->v.vp = calloc(1, sizeof(jx_trie_node))) == NULL) {
-        jxv_free(value);
-        return NULL;
-    }
-
-    return value;
+    return jxd_del_n(dict, key, strlen(key));
 }
 
-bool jxd_put(jx_value *dict, char *key, jx_value *value)
+bool jxd_del_free(jx_value *dict, char *key)
 {
-    char *lookup_key;
-    int lookup_key_size;
+    jx_value *v = jxd_del(dict, key);
 
-    jx_trie_node *node;
+    jxv_free(v);
 
-    if (dict == NULL || dict->type != JX_TYPE_OBJECT || key == NULL || value == NULL) {
+    return v != NULL;
+}
+
+/* Hash table objects are visited in insertion order, trie objects in key order. */
+bool jxd_iterate(jx_value *dict, jxd_iter_cb cb_func, void *ptr)
+{
+    jx_iter iter;
+
+    if (dict == NULL || dict->type != JX_TYPE_OBJECT || cb_func == NULL) {
         return false;
     }
 
-    lookup_key_size = (strlen(key) * 2) + 1;
-    lookup_key = alloca(lookup_key_size);
+    jx_iter_init(&iter, dict);
 
-    jx_trie_reduce_key_charset(lookup_key, (unsigned char *)key, lookup_key_size);
+    while (jx_iter_next(&iter)) {
+        cb_func(iter.key, iter.value, ptr);
+    }
 
-    node = jx_trie_add_key(dict->v.vp, lookup_key, 0);
+    return !iter.failed;
+}
 
-    if (node == NULL) {
+bool jx_iter_init(jx_iter *iter, jx_value *value)
+{
+    if (iter == NULL) {
         return false;
     }
 
-    if (node->value != NULL) {
-        jxv_free(node->value);
+    memset(iter, 0, sizeof(jx_iter));
+
+    if (value == NULL || (value->type != JX_TYPE_ARRAY && value->type != JX_TYPE_OBJECT)) {
+        return false;
     }
 
-    node->value = value;
+    iter->container = value;
 
     return true;
 }
 
-jx_value *jxd_get(jx_value *dict, char *key)
+/* Walk the trie depth first, visiting branches in order, which yields its keys sorted. */
+bool jx_iter_next_trie(jx_iter *iter)
 {
-    char *lookup_key;
-    int lookup_key_size;
-
-    jx_trie_node *node;
+    struct jx_trie_iter_t *trie = iter->trie;
 
-    if (dict == NULL || dict->type != JX_TYPE_OBJECT || key == NULL) {
-        return NULL;
+    if (trie == NULL) {
+        if ((trie = iter->trie = calloc(1, sizeof(struct jx_trie_iter_t))) == NULL ||
+            !jx_trie_iter_push(trie, &iter->container->v.vt->root)) {
+            iter->failed = true;
+            return false;
+        }
     }
 
-    lookup_key_size = (strlen(key) * 2) + 1;
-    lookup_key = alloca(lookup_key_size);
+    while (trie->depth > 0) {
+        jx_trie_iter_frame *top = &trie->path[trie->depth - 1];
+        jx_trie_node *node = top->node;
 
-    jx_trie_reduce_key_charset(lookup_key, (unsigned char *)key, lookup_key_size);
+        if (!top->visited) {
+            top->visited = true;
 
-    node = jx_trie_get_key(dict->v.vp, lookup_key, 0);
+            if (node->value != NULL) {
+                iter->key_length = (trie->depth - 1) / 2;
+                trie->key[iter->key_length] = '\0';
 
-    if (node == NULL) {
-        return NULL;
+                iter->key = trie->key;
+                iter->value = node->value;
+
+                return true;
+            }
+        }
+
+        while (top->branch < 16 && node->child_nodes[top->branch] == NULL) {
+            top->branch++;
+        }
+
+        if (top->branch == 16) {
+            trie->depth--;
+        }
+        else if (!jx_trie_iter_push(trie, node->child_nodes[top->branch++])) {
+            iter->failed = true;
+            return false;
+        }
     }
 
-    return node->value;
+    return false;
 }
 
-jx_value *jxd_del(jx_value * dict, char *key)
+bool jx_iter_next(jx_iter *iter)
 {
-    char *lookup_key;
-    int lookup_key_size;
+    jx_value *container;
 
-    if (dict == NULL || dict->type != JX_TYPE_OBJECT || key == NULL) {
-        return NULL;
+    if (iter == NULL || (container = iter->container) == NULL) {
+        return false;
     }
 
-    lookup_key_size = (strlen(key) * 2) + 1;
-    lookup_key = alloca(lookup_key_size);
+    if (container->type == JX_TYPE_ARRAY) {
+        if (iter->index < jxa_get_length(container)) {
+            iter->value = jxa_get(container, iter->index++);
+            return true;
+        }
+    }
+    else if (!(container->flags & JX_VALUE_FLAG_TRIE)) {
+        jx_object *obj = container->v.vo;
 
-    jx_trie_reduce_key_charset(lookup_key, (unsigned char *)key, lookup_key_size);
+        while (iter->index < obj->n_entries) {
+            jx_dict_entry *entry = &obj->entries[iter->index++];
 
-    return jx_trie_del_key(dict->v.vp, lookup_key, 0);
-}
+            if (entry->value != NULL) {
+                iter->key = entry->key;
+                iter->key_length = entry->length;
+                iter->value = entry->value;
 
-bool jxd_del_free(jx_value *dict, char *key)
-{
-    jx_value *v = jxd_del(dict, key);
+                return true;
+            }
+        }
+    }
+    else if (jx_iter_next_trie(iter)) {
+        return true;
+    }
 
-    jxv_free(v);
+    jx_iter_end(iter);
 
-    return v != NULL;
+    return false;
 }
 
-bool jxd_iterate(jx_value *dict, jxd_iter_cb cb_func, void *ptr)
+const char *jx_iter_key(jx_iter *iter, size_t *length)
 {
-    bool success;
+    if (iter == NULL || iter->key == NULL) {
+        if (length != NULL) {
+            *length = 0;
+        }
 
-    jx_value *prefix;
+        return NULL;
+    }
 
-    if (dict == NULL || dict->type != JX_TYPE_OBJECT || cb_func == NULL) {
-        return false;
+    if (length != NULL) {
+        *length = iter->key_length;
     }
 
-    prefix = jxs_new(NULL);
+    return iter->key;
+}
 
-    if (prefix == NULL) {
-        return false;
+jx_value *jx_iter_value(jx_iter *iter)
+{
+    if (iter == NULL) {
+        return NULL;
     }
 
-    success = jx_trie_iterate_keys(dict->v.vp, prefix, cb_func, ptr);
+    return iter->value;
+}
+
+void jx_iter_end(jx_iter *iter)
+{
+    if (iter == NULL) {
+        return;
+    }
 
-    jxv_free(prefix);
+    if (iter->trie != NULL) {
+        free(iter->trie->path);
+        free(iter->trie->key);
+        free(iter->trie);
+    }
 
-    return success;
+    iter->container = NULL;
+    iter->trie = NULL;
+    iter->key = NULL;
+    iter->key_length = 0;
+    iter->value = NULL;
 }
 
 bool jxd_has_key(jx_value *dict, char *key)
@@ -600,7 +1380,7 @@ jx_type jxd_get_type(jx_value *dict, char *key, bool *found)
 
 bool jxd_put_number(jx_value *dict, char *key, double num)
 {
-    jx_value *value = jxv_number_new(num);
+    jx_value *value = jxv_number_new_arena(jxv_get_arena(dict), num);
 
     if (value == NULL) {
         return false;
@@ -625,6 +1405,33 @@ double jxd_get_number(jx_value *dict, char *key, bool *found)
     return jxv_get_number(value);
 }
 
+bool jxd_put_int(jx_value *dict, char *key, int64_t num)
+{
+    jx_value *value = jxv_int_new_arena(jxv_get_arena(dict), num);
+
+    if (value == NULL) {
+        return false;
+    }
+
+    if (!jxd_put(dict, key, value)) {
+        jxv_free(value);
+        return false;
+    }
+
+    return true;
+}
+
+int64_t jxd_get_int(jx_value *dict, char *key, bool *found)
+{
+    jx_value *value = jxd_get(dict, key);
+
+    if (found) {
+        *found = jxv_get_type(value) == JX_TYPE_NUMBER;
+    }
+
+    return jxv_get_int(value);
+}
+
 bool jxd_put_bool(jx_value *dict, char *key, bool value)
 {
     return jxd_put(dict, key, jxv_bool_new(value));
@@ -643,7 +1450,7 @@ bool jxd_get_bool(jx_value *dict, char *key, bool *found)
 
 bool jxd_put_string(jx_value *dict, char *key, char *value)
 {
-    jx_value *str = jxs_new(value);
+    jx_value *str = jxs_new_arena(jxv_get_arena(dict), value);
 
     if (!str) {
         return false;
@@ -669,10 +1476,15 @@ char * jxd_get_string(jx_value *dict, char *key, bool *found)
 }
 
 jx_value *jxv_number_new(double num)
+{
+    return jxv_number_new_arena(NULL, num);
+}
+
+jx_value *jxv_number_new_arena(jx_arena *arena, double num)
 {
     jx_value *value;
 
-    if ((value = jxv_new(JX_TYPE_NUMBER)) == NULL) {
+    if ((value = jxv_new(arena, JX_TYPE_NUMBER)) == NULL) {
         return NULL;
     }
 
@@ -687,42 +1499,194 @@ double jxv_get_number(jx_value *v)
         return NAN;
     }
 
+    if (v->flags & JX_VALUE_FLAG_INT) {
+        return (double)v->v.vi;
+    }
+
     return v->v.vf;
 }
 
+jx_value *jxv_int_new(int64_t num)
+{
+    return jxv_int_new_arena(NULL, num);
+}
+
+jx_value *jxv_int_new_arena(jx_arena *arena, int64_t num)
+{
+    jx_value *value;
+
+    if ((value = jxv_new(arena, JX_TYPE_NUMBER)) == NULL) {
+        return NULL;
+    }
+
+    value->v.vi = num;
+    value->flags |= JX_VALUE_FLAG_INT;
+
+    return value;
+}
+
+/* Doubles are truncated toward zero, and saturate at the limits of int64_t. */
+int64_t jx_double_to_int(double num)
+{
+    if (num != num) {
+        return 0;
+    }
+
+    if (num >= 9223372036854775808.0) {
+        return INT64_MAX;
+    }
+
+    if (num < -9223372036854775808.0) {
+        return INT64_MIN;
+    }
+
+    return (int64_t)num;
+}
+
+int64_t jxv_get_int(jx_value *v)
+{
+    if (v == NULL || v->type != JX_TYPE_NUMBER) {
+        return 0;
+    }
+
+    if (v->flags & JX_VALUE_FLAG_INT) {
+        return v->v.vi;
+    }
+
+    return jx_double_to_int(v->v.vf);
+}
+
+bool jxv_is_int(jx_value *v)
+{
+    return v != NULL && v->type == JX_TYPE_NUMBER && (v->flags & JX_VALUE_FLAG_INT);
+}
+
 jx_value *jxs_new(const char * src)
+{
+    return jxs_new_arena(NULL, src);
+}
+
+/* Short heap strings are stored in the value itself, starting at its first byte. The
+ * last inline byte holds the number of unused bytes, so that it doubles as the null
+ * terminator once the string is full. Arena strings always use a payload, since there
+ * would be nowhere to keep the arena they need to grow in. */
+char *jxs_inline(jx_value *str)
+{
+    return (char *)str;
+}
+
+char *jxs_data(jx_value *str)
+{
+    return (str->flags & JX_VALUE_FLAG_INLINE) ? jxs_inline(str) : str->v.vs->data;
+}
+
+size_t jxs_length(jx_value *str)
+{
+    if (str->flags & JX_VALUE_FLAG_INLINE) {
+        return (JX_STRING_INLINE_SIZE - 1) - jxs_inline(str)[JX_STRING_INLINE_SIZE - 1];
+    }
+
+    return str->v.vs->length;
+}
+
+size_t jxs_size(jx_value *str)
+{
+    return (str->flags & JX_VALUE_FLAG_INLINE) ? JX_STRING_INLINE_SIZE : str->v.vs->size;
+}
+
+/* Set the length of the string and write its null terminator. */
+void jxs_set_length(jx_value *str, size_t length)
+{
+    char *data = jxs_data(str);
+
+    data[length] = '\0';
+
+    if (str->flags & JX_VALUE_FLAG_INLINE) {
+        data[JX_STRING_INLINE_SIZE - 1] = (JX_STRING_INLINE_SIZE - 1) - length;
+    }
+    else {
+        str->v.vs->length = length;
+    }
+}
+
+/* Allocate an empty string value with room for size bytes (including the null terminator). */
+jx_value *jxs_alloc(jx_arena *arena, size_t size)
 {
     jx_value *str;
 
-    if ((str = jxv_new(JX_TYPE_STRING)) == NULL) {
+    if ((str = jxv_new(arena, JX_TYPE_STRING)) == NULL) {
         return NULL;
     }
 
-    if (src == NULL) {
-        str->length = 0;
+    if (arena == NULL && size <= JX_STRING_INLINE_SIZE) {
+        str->flags |= JX_VALUE_FLAG_INLINE;
     }
     else {
-        str->length = strlen(src);
+        if ((str->v.vs = jx_mem_alloc(arena, sizeof(jx_string) + size)) == NULL) {
+            jx_mem_free(arena, str);
+            return NULL;
+        }
+
+        str->v.vs->size = size;
+        str->v.vs->arena = arena;
     }
 
-    str->size = 16;
+    jxs_set_length(str, 0);
+
+    return str;
+}
+
+jx_value *jxs_new_arena(jx_arena *arena, const char *src)
+{
+    jx_value *str;
+    size_t length, size;
+
+    length = (src == NULL) ? 0 : strlen(src);
+
+    size = 16;
 
-    while (str->size < str->length + 1) {
-        str->size *= 2;
+    while (size < length + 1) {
+        size *= 2;
     }
 
-    if ((str->v.vp = malloc(sizeof(char) * str->size)) == NULL) {
-        jxv_free(str);
+    if (arena == NULL && length < JX_STRING_INLINE_SIZE) {
+        size = length + 1;
+    }
+
+    if ((str = jxs_alloc(arena, size)) == NULL) {
         return NULL;
     }
 
-    if (src == NULL) {
-        ((char *)str->v.vp)[0] = '\0';
+    if (length > 0) {
+        memcpy(jxs_data(str), src, length);
     }
-    else {
-        strcpy(str->v.vp, src);
+
+    jxs_set_length(str, length);
+
+    return str;
+}
+
+/* Create a string from the first length bytes of src, allocating exactly
+ * enough space for them (and the null terminator). */
+jx_value *jxs_new_n(const char *src, size_t length)
+{
+    return jxs_new_n_arena(NULL, src, length);
+}
+
+jx_value *jxs_new_n_arena(jx_arena *arena, const char *src, size_t length)
+{
+    jx_value *str;
+
+    if ((str = jxs_alloc(arena, length + 1)) == NULL) {
+        return NULL;
     }
 
+    if (length > 0) {
+        memcpy(jxs_data(str), src, length);
+    }
+
+    jxs_set_length(str, length);
+
     return str;
 }
 
@@ -732,56 +1696,83 @@ char *jxs_get_str(jx_value *str)
         return NULL;
     }
 
-    return str->v.vp;
+    return jxs_data(str);
+}
+
+size_t jxs_get_length(jx_value *str)
+{
+    if (str == NULL || str->type != JX_TYPE_STRING) {
+        return 0;
+    }
+
+    return jxs_length(str);
 }
 
+/* Grow the string to hold at least size bytes, moving an inline string to the heap. */
 bool jxs_resize(jx_value *str, size_t size)
 {
+    jx_string *new_str;
     size_t new_size;
-    char *new_str;
 
-    if (str->size >= size) {
+    if (jxs_size(str) >= size) {
         return false;
     }
 
-    new_size = str->size;
+    new_size = (str->flags & JX_VALUE_FLAG_INLINE) ? 16 : str->v.vs->size;
 
     while (new_size < size) {
         new_size *= 2;
     }
 
-    new_str = realloc(str->v.vp, new_size);
+    if (str->flags & JX_VALUE_FLAG_INLINE) {
+        size_t length = jxs_length(str);
+
+        if ((new_str = malloc(sizeof(jx_string) + new_size)) != NULL) {
+            memcpy(new_str->data, jxs_inline(str), length + 1);
+
+            new_str->length = length;
+            new_str->arena = NULL;
+
+            str->flags &= ~JX_VALUE_FLAG_INLINE;
+            memset(str->tail, 0, sizeof(str->tail));
+        }
+    }
+    else {
+        new_str = jx_mem_realloc(str->v.vs->arena, str->v.vs,
+            sizeof(jx_string) + str->v.vs->size, sizeof(jx_string) + new_size);
+    }
 
     if (new_str == NULL) {
-        str->error = true;
+        str->flags |= JX_VALUE_FLAG_ERROR;
         return false;
     }
 
-    str->v.vp = new_str;
-    str->size = new_size;
+    str->v.vs = new_str;
+    new_str->size = new_size;
 
     return true;
 }
 
 bool jxs_append_str(jx_value *dst, char *src)
 {
-    size_t new_length;
+    size_t length, new_length;
 
-    if (dst == NULL || dst->type != JX_TYPE_STRING || dst->error) {
+    if (dst == NULL || dst->type != JX_TYPE_STRING || (dst->flags & JX_VALUE_FLAG_ERROR)) {
         return false;
     }
 
-    new_length = dst->length + strlen(src);
+    length = jxs_length(dst);
+    new_length = length + strlen(src);
 
-    if (dst->size < new_length + 1) {
+    if (jxs_size(dst) < new_length + 1) {
         if (!jxs_resize(dst, new_length + 1)) {
             return false;
         }
     }
 
-    strcat(dst->v.vp, src);
+    memcpy(jxs_data(dst) + length, src, new_length - length);
 
-    dst->length = new_length;
+    jxs_set_length(dst, new_length);
 
     return true;
 }
@@ -800,34 +1791,38 @@ bool jxs_append_fmt(jx_value *dst, char *fmt, ...)
 {
     va_list ap;
 
-    size_t new_length;
+    size_t length, new_length;
 
-    if (dst == NULL || dst->type != JX_TYPE_STRING || dst->error) {
+    if (dst == NULL || dst->type != JX_TYPE_STRING || (dst->flags & JX_VALUE_FLAG_ERROR)) {
         return false;
     }
 
+    length = jxs_length(dst);
+
     va_start(ap, fmt);
-    new_length = dst->length + vsnprintf(NULL, 0, fmt, ap);
+    new_length = length + vsnprintf(NULL, 0, fmt, ap);
     va_end(ap);
 
-    if (dst->size < new_length + 1) {
+    if (jxs_size(dst) < new_length + 1) {
         if (!jxs_resize(dst, new_length + 1)) {
             return false;
         }
     }
 
     va_start(ap, fmt);
-    vsprintf((char *)dst->v.vp + dst->length, fmt, ap);
+    vsprintf(jxs_data(dst) + length, fmt, ap);
     va_end(ap);
 
-    dst->length = new_length;
+    jxs_set_length(dst, new_length);
 
     return true;
 }
 
 bool jxs_append_chr(jx_value *dst, char c)
 {
-    if (dst == NULL || dst->type != JX_TYPE_STRING || dst->error) {
+    size_t length;
+
+    if (dst == NULL || dst->type != JX_TYPE_STRING || (dst->flags & JX_VALUE_FLAG_ERROR)) {
         return false;
     }
 
@@ -835,14 +1830,17 @@ bool jxs_append_chr(jx_value *dst, char c)
         return true;
     }
 
-    if (dst->size < dst->length + 2) {
-        if (!jxs_resize(dst, dst->length + 2)) {
+    length = jxs_length(dst);
+
+    if (jxs_size(dst) < length + 2) {
+        if (!jxs_resize(dst, length + 2)) {
             return false;
         }
     }
 
-    ((char *)dst->v.vp)[dst->length++] = c;
-    ((char *)dst->v.vp)[dst->length] = '\0';
+    jxs_data(dst)[length] = c;
+
+    jxs_set_length(dst, length + 1);
 
     return true;
 }
@@ -854,35 +1852,63 @@ bool jxs_push(jx_value *str, char c)
 
 char jxs_top(jx_value *str)
 {
-    char *ptr;
+    size_t length;
 
-    if (str == NULL || str->type != JX_TYPE_STRING || str->length == 0) {
+    if (str == NULL || str->type != JX_TYPE_STRING || (length = jxs_length(str)) == 0) {
         return '\0';
     }
 
-    ptr = str->v.vp;
-
-    return ptr[str->length - 1];
+    return jxs_data(str)[length - 1];
 }
 
 char jxs_pop(jx_value *str)
 {
-    char *ptr;
+    size_t length;
     char c;
 
-    if (str == NULL || str->type != JX_TYPE_STRING || str->length == 0) {
+    if (str == NULL || str->type != JX_TYPE_STRING || (length = jxs_length(str)) == 0) {
         return '\0';
     }
 
-    ptr = (char *)str->v.vp;
+    c = jxs_data(str)[length - 1];
 
-    c = ptr[--str->length];
-
-    ptr[str->length] = '\0';
+    jxs_set_length(str, length - 1);
 
     return c;
 }
 
+/* Typed stand-ins for values that the parser reports without building, i.e. in callback
+ * mode; they carry no payload, and jxv_free() ignores them. */
+static jx_value jxv_placeholders[] = {
+    { .type = JX_TYPE_UNDEF },
+    { .type = JX_TYPE_NULL },
+    { .type = JX_TYPE_ARRAY },
+    { .type = JX_TYPE_OBJECT },
+    { .type = JX_TYPE_NUMBER },
+    { .type = JX_TYPE_BOOL },
+    { .type = JX_TYPE_STRING },
+    { .type = JX_TYPE_PTR }
+};
+
+#define JX_N_PLACEHOLDERS (sizeof(jxv_placeholders) / sizeof(jxv_placeholders[0]))
+
+jx_value *jxv_placeholder(jx_type type)
+{
+    if ((size_t)type >= JX_N_PLACEHOLDERS) {
+        return NULL;
+    }
+
+    return &jxv_placeholders[type];
+}
+
+bool jxv_is_placeholder(jx_value *value)
+{
+    uintptr_t addr = (uintptr_t)value;
+
+    return  addr >= (uintptr_t)&jxv_placeholders[0] &&
+            addr < (uintptr_t)&jxv_placeholders[JX_N_PLACEHOLDERS];
+}
+
 jx_value *jxv_null()
 {
     static bool init = false;
@@ -936,7 +1962,7 @@ bool jxv_get_bool(jx_value *value)
 
 bool jxv_is_valid(jx_value *value)
 {
-    return !value->error;
+    return !(value->flags & JX_VALUE_FLAG_ERROR);
 }
 
 void jxv_free(jx_value *value)
@@ -947,24 +1973,43 @@ void jxv_free(jx_value *value)
         return;
     }
 
+    /* Arena values are released all at once by jx_arena_reset(), and the items of packed
+     * arrays along with the array. */
+    if ((value->flags & (JX_VALUE_FLAG_ARENA | JX_VALUE_FLAG_ITEM)) || jxv_is_placeholder(value)) {
+        return;
+    }
+
     type = jxv_get_type(value);
 
     if (type == JX_TYPE_STRING || type == JX_TYPE_PTR) {
-        if (value->v.vp != NULL) {
+        if (value->v.vp != NULL && !(value->flags & JX_VALUE_FLAG_INLINE)) {
             free(value->v.vp);
         }
     }
     else if (type == JX_TYPE_ARRAY) {
         size_t i;
 
-        for (i = 0; i < jxa_get_length(value); i++) {
-            jxv_free(jxa_get(value, i));
+        jxv_cache_free(value);
+
+        if (!(value->flags & JX_VALUE_FLAG_PACKED)) {
+            for (i = 0; i < value->v.va->length; i++) {
+                jxv_free(value->v.va->items[i]);
+            }
         }
 
-        free(value->v.vpp);
+        free(value->v.va);
     }
     else if (type == JX_TYPE_OBJECT) {
-        jx_trie_free_branch(value->v.vp);
+        jxv_cache_free(value);
+
+        if (value->flags & JX_VALUE_FLAG_TRIE) {
+            jx_trie_free_root(&value->v.vt->root);
+        }
+        else {
+            jx_hash_free(value->v.vo);
+        }
+
+        free(value->v.vp);
     }
     else if (type == JX_TYPE_NULL || type == JX_TYPE_BOOL) {
         return;
@@ -41,8 +41,11 @@
 */
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdbool.h>
 
+#include <jx_arena.h>
+
 typedef enum
 {
     JX_TYPE_UNDEF,
@@ -55,27 +58,90 @@ typedef enum
     JX_TYPE_PTR
 } jx_type;
 
+/* The representation used for objects created by jxd_new() and by the parser. The hash
+ * table (the default) keeps keys in insertion order; the trie keeps them sorted. */
+typedef enum
+{
+    JX_DICT_HASH,
+    JX_DICT_TRIE
+} jx_dict_engine;
+
 struct jx_value_t;
 struct jx_trie_node_t;
+struct jx_intern_t;
+struct jx_key_t;
+struct jx_cache_t;
 
 #ifdef JX_VALUE_INTERNAL
 
+#define JX_VALUE_FLAG_ERROR     (1 << 0)
+#define JX_VALUE_FLAG_ARENA     (1 << 1)
+#define JX_VALUE_FLAG_INLINE    (1 << 2)
+#define JX_VALUE_FLAG_TRIE      (1 << 3)
+#define JX_VALUE_FLAG_PACKED    (1 << 4)
+#define JX_VALUE_FLAG_INT       (1 << 5)
+#define JX_VALUE_FLAG_ITEM      (1 << 6)
+
+/* Bytes available to a string stored inside the value itself (see jxs_inline()). */
+#define JX_STRING_INLINE_SIZE   14
+
+/* A value is 16 bytes: scalars are stored inline, while arrays, objects and strings
+ * point to a payload that holds their length, capacity and arena (so that they can
+ * grow in place, and so that small values don't pay for bookkeeping they never use).
+ *
+ * Short heap strings (JX_VALUE_FLAG_INLINE) have no payload; their bytes occupy v and
+ * tail, which is why the type and flags come last. */
 typedef struct jx_value_t
 {
     union {
         bool vb;
         double vf;
+        int64_t vi;
         void *vp;
-        void **vpp;
+        struct jx_array_t *va;
+        struct jx_object_t *vo;
+        struct jx_trie_object_t *vt;
+        struct jx_string_t *vs;
     } v;
 
-    jx_type type;
+    char tail[JX_STRING_INLINE_SIZE - sizeof(double)];
+
+    uint8_t flags;
+    uint8_t type;
+} jx_value;
 
+/* Arrays start out packed (JX_VALUE_FLAG_PACKED). As long as only numbers are added,
+ * each item is a whole 16-byte number value (a record), stored in the payload where a
+ * boxed array keeps its pointers; it is not a bare double or int64_t. jxa_get() needs a
+ * value to hand out without allocating or changing the array, and each record keeps its
+ * own kind (JX_VALUE_FLAG_INT), so integers stay integers whatever is added after them.
+ * That is twice the size of a bare number, and about half of what a boxed one costs.
+ *
+ * Records are flagged JX_VALUE_FLAG_ITEM, so that jxv_free() leaves them alone, and move
+ * when the payload grows. The first value of any other kind boxes them all, for good,
+ * into a payload of pointers. */
+typedef struct jx_array_t
+{
     size_t size;
     size_t length;
 
-    bool error;
-} jx_value;
+    struct jx_arena_t *arena;
+    struct jx_cache_t *cache;
+
+    struct jx_value_t *items[];
+} jx_array;
+
+#define JX_ARRAY_RECORDS(arr)   ((struct jx_value_t *)(arr)->items)
+
+typedef struct jx_string_t
+{
+    size_t size;
+    size_t length;
+
+    struct jx_arena_t *arena;
+
+    char data[];
+} jx_string;
 
 typedef struct jx_trie_node_t
 {
@@ -86,32 +152,132 @@ typedef struct jx_trie_node_t
     char byte;
 } jx_trie_node;
 
+typedef struct jx_trie_object_t
+{
+    struct jx_arena_t *arena;
+    struct jx_cache_t *cache;
+
+    size_t length;
+
+    jx_trie_node root;
+} jx_trie_object;
+
+/* The serialized bytes of an array or object that keeps them (see jxv_set_cache()), and
+ * the container it was last added to, whose cache goes stale along with its own. */
+typedef struct jx_cache_t
+{
+    struct jx_value_t *parent;
+
+    char *data;
+    size_t length;
+
+    bool valid;
+} jx_cache;
+
+/* A key with its hash, as stored in a key intern table (see jx_intern_get()) and as
+ * returned by jx_key_prepare(). */
+typedef struct jx_key_t
+{
+    uint32_t hash;
+    uint32_t length;
+
+    char data[];
+} jx_key;
+
+/* An entry of an object, in insertion order. Deleted entries of an indexed object have
+ * no key or value until the object is next compacted. */
+typedef struct
+{
+    char *key;
+    uint32_t length;
+    uint32_t hash;
+
+    struct jx_value_t *value;
+} jx_dict_entry;
+
+/* An object is a single block holding this header, its entries and then the bytes of
+ * their keys, except for keys shared from the intern table (a heap table holds a
+ * reference for each object that uses it). Objects with up to JX_DICT_FLAT_MAX keys are searched linearly; larger
+ * ones get a Swiss-style index: ctrl holds one byte per slot (empty, deleted, or the
+ * low 7 bits of the hash of the entry it indexes), which are compared a SIMD group at a
+ * time, and slots holds the index of that entry. */
+#define JX_DICT_FLAT_MAX        8
+
+typedef struct jx_object_t
+{
+    struct jx_arena_t *arena;
+    struct jx_intern_t *intern;
+    struct jx_cache_t *cache;
+
+    uint32_t *slots;
+    uint8_t *ctrl;
+
+    uint32_t length;
+    uint32_t n_entries, entries_size;
+    uint32_t keys_length, keys_size;
+    uint32_t capacity, growth_left;
+
+    jx_dict_entry entries[];
+} jx_object;
+
 #else
 
 typedef struct jx_value_t jx_value;
 typedef struct jx_trie_node_t jx_trie_node;
-typedef struct jx_iter_t jx_iter;
+typedef struct jx_key_t jx_key;
 
 #endif
 
 typedef void (*jxd_iter_cb)(const char *key, jx_value *value, void *ptr);
 
+/* An external iterator over the items of an array or the members of an object (see
+ * jx_iter_init()). It is meant to live on the caller's stack, which is why its fields are
+ * visible, but they are private. */
+struct jx_trie_iter_t;
+
+typedef struct jx_iter_t
+{
+    struct jx_value_t *container;
+    size_t index;
+
+    const char *key;
+    size_t key_length;
+    struct jx_value_t *value;
+
+    struct jx_trie_iter_t *trie;
+    bool failed;
+} jx_iter;
+
 jx_type jxv_get_type(jx_value *value);
 
+/* The items of an array belong to it. Those of a packed array (see jxa_is_packed()) are
+ * stored in the array itself, so a pointer returned by jxa_get() or jxa_top() is only
+ * valid until the array next changes; a number pushed to one as a value is copied, and
+ * the value freed. */
 jx_value *jxa_new(size_t capacity);
+jx_value *jxa_new_arena(jx_arena *arena, size_t capacity);
 size_t jxa_get_length(jx_value *array);
 jx_type jxa_get_type(jx_value *array, size_t i);
 jx_value *jxa_get(jx_value *array, size_t i);
 bool jxa_push(jx_value *array, jx_value *value);
 jx_value *jxa_pop(jx_value *array);
 jx_value *jxa_top(jx_value *array);
+bool jxa_is_packed(jx_value *array);
 bool jxa_push_number(jx_value *array, double num);
 double jxa_get_number(jx_value *arr, size_t i);
+size_t jxa_get_numbers(jx_value *array, double *out, size_t offset, size_t n);
+bool jxa_push_int(jx_value *array, int64_t num);
+int64_t jxa_get_int(jx_value *array, size_t i);
+bool jxa_is_int(jx_value *array, size_t i);
 bool jxa_push_ptr(jx_value *array, void *ptr);
 void *jxa_get_ptr(jx_value *array, size_t i);
 void *jxv_get_ptr(jx_value *value);
 
 jx_value *jxd_new();
+jx_value *jxd_new_arena(jx_arena *arena);
+void jxd_set_default_engine(jx_dict_engine engine);
+jx_dict_engine jxd_get_default_engine();
+size_t jxd_size(jx_value *dict);
 bool jxd_put(jx_value *dict, char *key, jx_value *value);
 jx_value *jxd_get(jx_value *dict, char *key);
 jx_value *jxd_del(jx_value *dict, char *key);
@@ -120,16 +286,65 @@ bool jxd_has(jx_value *dict, char *key);
 jx_type jxd_get_type(jx_value *dict, char *key, bool *found);
 bool jxd_put_number(jx_value *dict, char *key, double num);
 double jxd_get_number(jx_value *dict, char *key, bool *found);
+bool jxd_put_int(jx_value *dict, char *key, int64_t num);
+int64_t jxd_get_int(jx_value *dict, char *key, bool *found);
 bool jxd_put_bool(jx_value *dict, char *key, bool value);
 bool jxd_get_bool(jx_value *dict, char *key, bool *found);
 bool jxd_put_string(jx_value *dict, char *key, char *value);
 char *jxd_get_string(jx_value *dict, char *key, bool *found);
 bool jxd_iterate(jx_value *dict, jxd_iter_cb cb_func, void *ptr);
 
+/* Iterate over an array's items or an object's members, without recursion, and without
+ * allocating unless the object is stored in a trie (the numbers of a packed array are
+ * handed out as they are stored, as by jxa_get()):
+ *
+ *     jx_iter iter;
+ *
+ *     jx_iter_init(&iter, value);
+ *
+ *     while (jx_iter_next(&iter)) {
+ *         key = jx_iter_key(&iter, &length);
+ *         item = jx_iter_value(&iter);
+ *     }
+ *
+ * Members come in the order jxd_iterate() visits them in. Their keys (null-terminated as
+ * well; arrays have none) are valid until the next call to jx_iter_next(), which returns
+ * false at the end, or if a trie's iteration runs out of memory. The value must not change
+ * during the iteration. One stopped early is ended with jx_iter_end(), which is harmless
+ * to call at any point. */
+bool jx_iter_init(jx_iter *iter, jx_value *value);
+bool jx_iter_next(jx_iter *iter);
+const char *jx_iter_key(jx_iter *iter, size_t *length);
+jx_value *jx_iter_value(jx_iter *iter);
+void jx_iter_end(jx_iter *iter);
+
+/* Variants taking the length of the key, which needn't be null-terminated. */
+bool jxd_put_n(jx_value *dict, const char *key, size_t length, jx_value *value);
+jx_value *jxd_get_n(jx_value *dict, const char *key, size_t length);
+jx_value *jxd_del_n(jx_value *dict, const char *key, size_t length);
+
+/* A prepared key is hashed once, for looking up the same member of many objects. It is
+ * immutable, so it may be shared between threads, and is freed with jx_key_free(). */
+jx_key *jx_key_prepare(const char *key);
+jx_key *jx_key_prepare_n(const char *key, size_t length);
+void jx_key_free(jx_key *key);
+jx_value *jxd_get_k(jx_value *dict, jx_key *key);
+
 jx_value *jxv_number_new(double num);
+jx_value *jxv_number_new_arena(jx_arena *arena, double num);
 double jxv_get_number(jx_value *value);
 
+/* Integers are numbers (JX_TYPE_NUMBER) that are kept exact, as an int64_t; the parser
+ * reads numbers without a fraction or exponent as integers when they fit. */
+jx_value *jxv_int_new(int64_t num);
+jx_value *jxv_int_new_arena(jx_arena *arena, int64_t num);
+int64_t jxv_get_int(jx_value *value);
+bool jxv_is_int(jx_value *value);
+
 jx_value *jxs_new(const char *src);
+jx_value *jxs_new_n(const char *src, size_t length);
+jx_value *jxs_new_arena(jx_arena *arena, const char *src);
+jx_value *jxs_new_n_arena(jx_arena *arena, const char *src, size_t length);
 bool jxs_append_jxs(jx_value *dst, jx_value *src);
 bool jxs_append_str(jx_value *dst, char *src);
 bool jxs_append_fmt(jx_value *dst, char *fmt, ...);
@@ -138,6 +353,7 @@ bool jxs_push(jx_value *str, char c);
 char jxs_top(jx_value *str);
 char jxs_pop(jx_value *str);
 char *jxs_get_str(jx_value *str);
+size_t jxs_get_length(jx_value *str);
 
 jx_value *jxv_null();
 bool jxv_is_null(jx_value *value);
@@ -147,4 +363,51 @@ bool jxv_get_bool(jx_value *value);
 
 bool jxv_is_valid(jx_value *value);
 
-void jxv_free(jx_value *value);
\ No newline at end of file
+jx_arena *jxv_get_arena(jx_value *value);
+
+/* Keep the serialized bytes of an array or object, and of every one inside it, so that
+ * serializing it again only serializes what changed since: the containers changed through
+ * jxd_put(), jxd_del(), jxa_push(), jxa_pop() (and their variants), and those they are
+ * inside. Containers added to one that keeps its bytes keep theirs too. Scalars changed in
+ * place aren't noticed; replace them instead. A value inside two containers is only seen
+ * to change in the one it was added to last. Caching is turned off for a whole document
+ * at its root, and isn't available to values allocated from an arena. */
+bool jxv_set_cache(jx_value *value, bool enabled);
+
+void jxv_free(jx_value *value);
+
+#ifdef JX_INTERNAL
+jx_value *jxv_placeholder(jx_type type);
+bool jxv_is_placeholder(jx_value *value);
+
+typedef struct jx_intern_t jx_intern;
+
+jx_intern *jx_intern_new();
+jx_intern *jx_intern_get(jx_arena *arena);
+void jx_intern_release(jx_intern *intern);
+
+jx_value *jxd_new_keys(jx_arena *arena, size_t keys_size);
+jx_value **jxd_put_key(jx_value *dict, jx_intern *intern, const char *key, size_t length);
+
+bool jxv_has_cache(jx_value *value);
+const char *jxv_get_cache(jx_value *value, size_t *length);
+bool jxv_put_cache(jx_value *value, char *data, size_t length);
+#endif
+
+#ifdef JX_VALUE_INTERNAL
+char *jxs_data(jx_value *str);
+size_t jxs_length(jx_value *str);
+size_t jxs_size(jx_value *str);
+void jxs_set_length(jx_value *str, size_t length);
+bool jxs_resize(jx_value *str, size_t size);
+
+int64_t jx_double_to_int(double num);
+
+uint32_t jx_hash_key(const char *key, size_t length);
+jx_object *jx_hash_new(jx_arena *arena, size_t keys_size);
+jx_dict_entry *jx_hash_get(jx_object *obj, const char *key, size_t length);
+jx_dict_entry *jx_hash_find(jx_object *obj, const char *key, size_t length, uint32_t hash);
+jx_dict_entry *jx_hash_insert(jx_object **obj, jx_intern *intern, const char *key, size_t length);
+jx_value *jx_hash_del(jx_object *obj, const char *key, size_t length);
+void jx_hash_free(jx_object *obj);
+#endif
\ No newline at end of file
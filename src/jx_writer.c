@@ -0,0 +1,271 @@
+/*---------------------------------------------------------------------
+| jx_writer.c
+----------------------------------------------------------------------
+| jxutil project
+|
+| Created by Cory Montgomery
+| cory.james.montgomery@gmail.com
+|
+| https://cjmont32.dev/jxutil
+| https://github.com/cjmont32/jxutil
+|
+----------------------------------------------------------------------
+| BSD 2-Clause License
+|
+| Copyright (c) 2018-2023, Cory Montgomery
+|
+| Redistribution and use in source and binary forms, with or without
+| modification, are permitted provided that the following conditions
+| are met:
+|
+|    1. Redistributions of source code must retain the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer.
+|    2. Redistributions in binary form must reproduce the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer in the documentation and/or other materials
+|       provided with the distribution.
+|
+| THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+| "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+| LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+| FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+| COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+| INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+| BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+| LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+| CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+| LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+| WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+| POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define JX_INTERNAL
+
+#include <errno.h>
+#include <string.h>
+
+#include <jx.h>
+#include <jx_util.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+/* Serializes a document to a non-blocking descriptor a piece at a time.
+ *
+ * Rather than recursing, the writer keeps the containers it is inside on a stack of its
+ * own, each with an iterator saying where it is in it, so that it can stop after any value
+ * and pick up from there on the next call. Output is produced into a buffer a chunk at a
+ * time, and the chunk is only refilled once all of it has been written, so a call that
+ * stops in the middle of one (because the descriptor would block) resumes at the byte
+ * where the last write left off. */
+
+#define JX_WRITER_CHUNK_SIZE (16 * 1024)
+
+typedef struct
+{
+    jx_iter iter;
+    bool first;
+} jx_writer_frame;
+
+struct jx_writer_t
+{
+    jx_value *root;
+
+    jx_writer_frame *frames;
+    size_t n_frames, frames_size;
+
+    jx_output out;
+    size_t sent;
+
+    bool started;
+    bool done;
+};
+
+jx_writer *jx_writer_new(jx_value *value)
+{
+    jx_writer *w;
+    jx_type type = jxv_get_type(value);
+
+    if (type != JX_TYPE_ARRAY && type != JX_TYPE_OBJECT) {
+        return NULL;
+    }
+
+    if ((w = calloc(1, sizeof(jx_writer))) == NULL) {
+        return NULL;
+    }
+
+    w->root = value;
+
+    jx_output_init(&w->out, NULL, NULL);
+
+    return w;
+}
+
+void jx_writer_free(jx_writer *w)
+{
+    if (w == NULL) {
+        return;
+    }
+
+    while (w->n_frames > 0) {
+        jx_iter_end(&w->frames[--w->n_frames].iter);
+    }
+
+    free(w->frames);
+    free(w->out.buf);
+    free(w);
+}
+
+/* Open an array or object, and make it the container the writer is in. */
+bool jx_writer_push(jx_writer *w, jx_value *value)
+{
+    jx_writer_frame *frame;
+
+    if (w->n_frames == w->frames_size) {
+        size_t size = w->frames_size ? w->frames_size * 2 : 16;
+        jx_writer_frame *frames;
+
+        if ((frames = realloc(w->frames, size * sizeof(jx_writer_frame))) == NULL) {
+            w->out.failed = true;
+            return false;
+        }
+
+        w->frames = frames;
+        w->frames_size = size;
+    }
+
+    frame = &w->frames[w->n_frames++];
+
+    jx_iter_init(&frame->iter, value);
+    frame->first = true;
+
+    return jx_output_chr(&w->out, jxv_get_type(value) == JX_TYPE_ARRAY ? '[' : '{');
+}
+
+bool jx_writer_value(jx_writer *w, jx_value *value)
+{
+    jx_type type = jxv_get_type(value);
+
+    if (type == JX_TYPE_ARRAY || type == JX_TYPE_OBJECT) {
+        return jx_writer_push(w, value);
+    }
+
+    return jx_serialize_value(&w->out, value);
+}
+
+/* Write the next value of the array the writer is in, or open it if it is a container.
+ * Numbers are read as such, which leaves packed arrays packed. */
+bool jx_writer_item(jx_writer *w, jx_iter *iter)
+{
+    jx_value *array = iter->container;
+    size_t i = iter->index - 1;
+
+    if (jxa_is_int(array, i)) {
+        return jx_serialize_int(&w->out, jxa_get_int(array, i));
+    }
+    else if (jxa_get_type(array, i) == JX_TYPE_NUMBER) {
+        return jx_serialize_double(&w->out, jxa_get_number(array, i));
+    }
+
+    return jx_writer_value(w, jxa_get(array, i));
+}
+
+/* Advance by one member of the innermost container, or close it when there are no more. */
+bool jx_writer_step(jx_writer *w)
+{
+    jx_writer_frame *frame;
+    jx_iter *iter;
+    bool is_array;
+
+    if (!w->started) {
+        w->started = true;
+        return jx_writer_push(w, w->root);
+    }
+
+    frame = &w->frames[w->n_frames - 1];
+    iter = &frame->iter;
+
+    is_array = jxv_get_type(iter->container) == JX_TYPE_ARRAY;
+
+    if (!jx_iter_next(iter)) {
+        if (iter->failed) {
+            w->out.failed = true;
+            return false;
+        }
+
+        if (--w->n_frames == 0) {
+            w->done = true;
+        }
+
+        return jx_output_chr(&w->out, is_array ? ']' : '}');
+    }
+
+    if (!frame->first) {
+        jx_output_chr(&w->out, ',');
+    }
+
+    frame->first = false;
+
+    if (is_array) {
+        return jx_writer_item(w, iter);
+    }
+    else {
+        const char *key;
+        size_t length;
+
+        key = jx_iter_key(iter, &length);
+
+        jx_serialize_utf8_string(&w->out, key, length);
+        jx_output_chr(&w->out, ':');
+
+        return jx_writer_value(w, jx_iter_value(iter));
+    }
+}
+
+/* Write as much of the document to fd, which should be non-blocking, as it will take.
+ * Returns 1 once the whole document has been written, 0 if fd would block before then (call
+ * again when it is writable), and -1 on error, with errno set if a write failed. */
+int jx_writer_write(jx_writer *w, int fd)
+{
+    if (w == NULL || w->out.failed) {
+        return -1;
+    }
+
+    for (;;) {
+        ssize_t n_written;
+
+        if (w->sent == w->out.length) {
+            if (w->done) {
+                return 1;
+            }
+
+            w->out.length = w->sent = 0;
+
+            while (!w->done && w->out.length < JX_WRITER_CHUNK_SIZE) {
+                if (!jx_writer_step(w)) {
+                    return -1;
+                }
+            }
+
+            continue;
+        }
+
+        n_written = write(fd, w->out.buf + w->sent, w->out.length - w->sent);
+
+        if (n_written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+
+            return -1;
+        }
+
+        w->sent += n_written;
+    }
+}
@@ -0,0 +1,1337 @@
+/*---------------------------------------------------------------------
+| jx_bench.c
+----------------------------------------------------------------------
+| jxutil project
+|
+| Created by Cory Montgomery
+| cory.james.montgomery@gmail.com
+|
+| https://cjmont32.dev/jxutil
+| https://github.com/cjmont32/jxutil
+|
+----------------------------------------------------------------------
+| BSD 2-Clause License
+|
+| Copyright (c) 2018-2023, Cory Montgomery
+|
+| Redistribution and use in source and binary forms, with or without
+| modification, are permitted provided that the following conditions
+| are met:
+|
+|    1. Redistributions of source code must retain the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer.
+|    2. Redistributions in binary form must reproduce the above
+|       copyright notice, this list of conditions and the following
+|       disclaimer in the documentation and/or other materials
+|       provided with the distribution.
+|
+| THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+| "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+| LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+| FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+| COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+| INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+| BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+| LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+| CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+| LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+| WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+| POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Parser/serializer micro-benchmarks.
+ *
+ * Each benchmark parses an in-memory corpus generated at startup, feeding it to the
+ * parser in fixed-size chunks, and reports throughput along with the number of heap
+ * allocations made, and heap bytes held by the result, per parsed value. Allocations
+ * are only counted when the binary is linked with
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free and built with
+ * JX_BENCH_COUNT_ALLOCS defined (the Makefile's bench target does this on Linux). */
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#endif
+
+#include <jx.h>
+#include <jx_util.h>
+#include <jx_getopt.h>
+
+#define BENCH_DEFAULT_ITERATIONS 20
+#define BENCH_DEFAULT_CHUNK_SIZE 4096
+
+#define BENCH_REUSE_CONTEXT (1 << 0)
+#define BENCH_ARENA         (1 << 1)
+#define BENCH_CALLBACKS     (1 << 2)
+#define BENCH_ASYNC         (1 << 3)
+#define BENCH_TRIE          (1 << 4)
+#define BENCH_KEY_LENGTH    (1 << 5)
+#define BENCH_KEY_PREPARED  (1 << 6)
+#define BENCH_STREAM        (1 << 7)
+#define BENCH_WRITER        (1 << 8)
+#define BENCH_INTO          (1 << 9)
+#define BENCH_CACHE         (1 << 10)
+#define BENCH_PARALLEL      (1 << 11)
+
+#define BENCH_PIPE_BUF_SIZE (64 * 1024)
+
+typedef struct
+{
+    char *data;
+    size_t length, size;
+    size_t values;
+} bench_corpus;
+
+typedef struct bench_case
+{
+    const char *name;
+    const char *description;
+    bool (*build)(bench_corpus *corpus);
+    bool (*run)(struct bench_case *bench);
+    int flags;
+} bench_case;
+
+static struct
+{
+    const char *name;
+    int iterations;
+    long chunk_size;
+    int threads;
+} bench_opts;
+
+static size_t bench_allocs;
+
+/* Heap bytes currently allocated (as reported by malloc_usable_size()); only differences
+ * between two readings are meaningful, since allocations made inside libc are not seen. */
+static long long bench_bytes;
+
+/* The most bench_bytes has been since it was last reset. */
+static long long bench_peak;
+
+#ifdef JX_BENCH_COUNT_ALLOCS
+#include <malloc.h>
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *bench_count(void *ptr)
+{
+    bench_allocs++;
+
+    if (ptr != NULL) {
+        bench_bytes += malloc_usable_size(ptr);
+
+        if (bench_bytes > bench_peak) {
+            bench_peak = bench_bytes;
+        }
+    }
+
+    return ptr;
+}
+
+void *__wrap_malloc(size_t size)
+{
+    return bench_count(__real_malloc(size));
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    return bench_count(__real_calloc(count, size));
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    size_t old_size = ptr != NULL ? malloc_usable_size(ptr) : 0;
+
+    if ((ptr = __real_realloc(ptr, size)) != NULL || size == 0) {
+        bench_bytes -= old_size;
+    }
+
+    return bench_count(ptr);
+}
+
+void __wrap_free(void *ptr)
+{
+    if (ptr != NULL) {
+        bench_bytes -= malloc_usable_size(ptr);
+    }
+
+    __real_free(ptr);
+}
+#endif
+
+double bench_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+bool corpus_append(bench_corpus *corpus, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    for (;;) {
+        size_t avail = corpus->size - corpus->length;
+
+        va_start(ap, fmt);
+        n = vsnprintf(corpus->data + corpus->length, avail, fmt, ap);
+        va_end(ap);
+
+        if (n < 0) {
+            return false;
+        }
+
+        if ((size_t)n < avail) {
+            corpus->length += n;
+            return true;
+        }
+
+        size_t size = corpus->size ? corpus->size * 2 : 1 << 16;
+        char *data;
+
+        while (size - corpus->length <= (size_t)n) {
+            size *= 2;
+        }
+
+        if ((data = realloc(corpus->data, size)) == NULL) {
+            return false;
+        }
+
+        corpus->data = data;
+        corpus->size = size;
+    }
+}
+
+/* A flat array of mixed scalars: integers, doubles, keywords and short strings. */
+bool build_scalars(bench_corpus *corpus)
+{
+    int i;
+
+    if (!corpus_append(corpus, "[")) {
+        return false;
+    }
+
+    for (i = 0; i < 200000; i++) {
+        bool ok;
+
+        switch (i % 6) {
+            case 0: ok = corpus_append(corpus, "%d", i); break;
+            case 1: ok = corpus_append(corpus, "%d.%03d", i, i % 1000); break;
+            case 2: ok = corpus_append(corpus, "true"); break;
+            case 3: ok = corpus_append(corpus, "false"); break;
+            case 4: ok = corpus_append(corpus, "null"); break;
+            default: ok = corpus_append(corpus, "\"s%d\"", i); break;
+        }
+
+        if (!ok || !corpus_append(corpus, i + 1 < 200000 ? ", " : "]")) {
+            return false;
+        }
+    }
+
+    corpus->values = 200000 + 1;
+
+    return true;
+}
+
+/* Pretty-printed records, the shape of a typical API response or log file. */
+bool build_records(bench_corpus *corpus)
+{
+    int i;
+
+    if (!corpus_append(corpus, "[\n")) {
+        return false;
+    }
+
+    for (i = 0; i < 20000; i++) {
+        if (!corpus_append(corpus,
+            "    {\n"
+            "        \"id\": %d,\n"
+            "        \"timestamp\": %d%06d,\n"
+            "        \"name\": \"user_%d\",\n"
+            "        \"active\": %s,\n"
+            "        \"score\": %d.%02d,\n"
+            "        \"tags\": [ \"alpha\", \"beta\", \"gamma\" ],\n"
+            "        \"location\": { \"lat\": 45.%04d, \"lon\": -122.%04d }\n"
+            "    }%s\n",
+            i, 1700, i, i, (i & 1) ? "true" : "false", i % 100, i % 97,
+            i % 10000, (i * 7) % 10000, i + 1 < 20000 ? "," : "")) {
+            return false;
+        }
+    }
+
+    if (!corpus_append(corpus, "]\n")) {
+        return false;
+    }
+
+    /* Each record: the object, 5 scalar members, the tags array and its 3 strings, and the
+     * location object with its 2 members. */
+    corpus->values = 20000 * 13 + 1;
+
+    return true;
+}
+
+/* A large array of numbers, half of them integers. */
+bool build_numbers(bench_corpus *corpus)
+{
+    int i;
+
+    if (!corpus_append(corpus, "[")) {
+        return false;
+    }
+
+    for (i = 0; i < 1000000; i++) {
+        if (!corpus_append(corpus, (i & 1) ? "%d.%d%s" : "%d%.0d%s", i * 31, i % 97,
+            i + 1 < 1000000 ? "," : "]")) {
+            return false;
+        }
+    }
+
+    corpus->values = 1000000 + 1;
+
+    return true;
+}
+
+/* A large array of 64-bit IDs, most of them beyond the integers doubles represent. */
+bool build_integers(bench_corpus *corpus)
+{
+    int i;
+
+    if (!corpus_append(corpus, "[")) {
+        return false;
+    }
+
+    for (i = 0; i < 1000000; i++) {
+        if (!corpus_append(corpus, "%lld%s", 1700000000000000000LL + (long long)i * 7919,
+            i + 1 < 1000000 ? "," : "]")) {
+            return false;
+        }
+    }
+
+    corpus->values = 1000000 + 1;
+
+    return true;
+}
+
+/* A large array of doubles with full precision and a wide range of magnitudes, the
+ * shape of sensor readings or coordinates. */
+bool build_floats(bench_corpus *corpus)
+{
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    int i;
+
+    if (!corpus_append(corpus, "[")) {
+        return false;
+    }
+
+    for (i = 0; i < 1000000; i++) {
+        double num;
+
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        num = (double)(state >> 11) / 9007199254740992.0;
+
+        switch (i % 4) {
+            case 0: num = num * 360 - 180; break;
+            case 1: num = num * 1e6; break;
+            case 2: num = num * 1e-3; break;
+            default: num = num * 1e15; break;
+        }
+
+        if (!corpus_append(corpus, "%.17g%s", num, i + 1 < 1000000 ? "," : "]")) {
+            return false;
+        }
+    }
+
+    corpus->values = 1000000 + 1;
+
+    return true;
+}
+
+/* Log messages: long strings, most of them clean, some with quotes, paths or newlines
+ * to escape, the shape of text-heavy documents. */
+bool build_text(bench_corpus *corpus)
+{
+    int i;
+
+    if (!corpus_append(corpus, "[")) {
+        return false;
+    }
+
+    for (i = 0; i < 100000; i++) {
+        if (!corpus_append(corpus, (i % 8 == 0) ?
+            "\"request %d failed: open(\\\"C:\\\\data\\\\cache\\\\%d.bin\\\") returned "
+            "access denied\\nretrying after %d ms with exponential backoff\"%s" :
+            "\"request %d completed: served /static/assets/bundle.%d.js from cache in %d ms to "
+            "client 10.0.0.1 using HTTP/1.1\"%s",
+            i, i * 7919, i % 1000, i + 1 < 100000 ? "," : "]")) {
+            return false;
+        }
+    }
+
+    corpus->values = 100000 + 1;
+
+    return true;
+}
+
+/* Deeply nested arrays, which exercise the parser's frame stack. */
+bool build_nested(bench_corpus *corpus)
+{
+    int i, j;
+
+    if (!corpus_append(corpus, "[")) {
+        return false;
+    }
+
+    for (i = 0; i < 1000; i++) {
+        for (j = 0; j < 64; j++) {
+            if (!corpus_append(corpus, "[")) {
+                return false;
+            }
+        }
+
+        if (!corpus_append(corpus, "%d", i)) {
+            return false;
+        }
+
+        for (j = 0; j < 64; j++) {
+            if (!corpus_append(corpus, "]")) {
+                return false;
+            }
+        }
+
+        if (!corpus_append(corpus, i + 1 < 1000 ? "," : "]")) {
+            return false;
+        }
+    }
+
+    corpus->values = 1000 * 65 + 1;
+
+    return true;
+}
+
+/* A million compact log events, too many members each for a linear search. */
+bool build_events(bench_corpus *corpus)
+{
+    int i;
+
+    if (!corpus_append(corpus, "[")) {
+        return false;
+    }
+
+    for (i = 0; i < 1000000; i++) {
+        if (!corpus_append(corpus,
+            "{\"id\":%d,\"timestamp\":%d%06d,\"level\":\"info\",\"host\":\"web-%d\","
+            "\"service\":\"api\",\"method\":\"GET\",\"path\":\"/v1/items/%d\",\"status\":%d,"
+            "\"bytes\":%d,\"duration\":%d.%03d,\"user\":\"u_%d\",\"region\":\"us-west-2\"}%s",
+            i, 1700, i, i % 16, i % 5000, (i % 50) ? 200 : 404, (i * 37) % 65536,
+            i % 100, i % 997, i % 10000, i + 1 < 1000000 ? "," : "]")) {
+            return false;
+        }
+    }
+
+    corpus->values = 1000000 * 13 + 1;
+
+    return true;
+}
+
+/* A single small message, parsed over and over as an ingest service would. */
+bool build_message(bench_corpus *corpus)
+{
+    if (!corpus_append(corpus,
+        "{\"type\": \"event\", \"id\": 8812731, \"ts\": 1700000000123, "
+        "\"user\": \"u_42\", \"ok\": true, \"vals\": [1.5, 2, 3]}")) {
+        return false;
+    }
+
+    corpus->values = 10;
+
+    return true;
+}
+
+bool bench_parse(bench_case *bench);
+bool bench_messages(bench_case *bench);
+bool bench_pipe(bench_case *bench);
+bool bench_mux(bench_case *bench);
+bool bench_lookup(bench_case *bench);
+bool bench_scan(bench_case *bench);
+bool bench_serialize(bench_case *bench);
+
+bench_case bench_cases[] = {
+    { "scalars", "flat array of mixed scalars", build_scalars, bench_parse },
+    { "records", "pretty-printed array of objects", build_records, bench_parse },
+    { "records-tr", "records, objects stored in tries", build_records, bench_parse, BENCH_TRIE },
+    { "records-ar", "records, allocated from an arena", build_records, bench_parse, BENCH_ARENA },
+    { "records-cb", "records, reported through callbacks", build_records, bench_parse,
+        BENCH_CALLBACKS },
+    { "numbers", "array of 1M numbers", build_numbers, bench_parse },
+    { "integers", "array of 1M 64-bit IDs", build_integers, bench_parse },
+    { "nested", "deeply nested arrays", build_nested, bench_parse },
+    { "lookup", "jxd_get of every record member", build_records, bench_lookup },
+    { "lookup-tr", "jxd_get of every record member, tries", build_records, bench_lookup,
+        BENCH_TRIE },
+    { "scan", "5 members of 1M events, jxd_get", build_events, bench_scan },
+    { "scan-n", "5 members of 1M events, jxd_get_n", build_events, bench_scan,
+        BENCH_KEY_LENGTH },
+    { "scan-k", "5 members of 1M events, prepared keys", build_events, bench_scan,
+        BENCH_KEY_PREPARED },
+    { "ser-records", "records to a string", build_records, bench_serialize },
+    { "ser-fd", "records streamed to /dev/null", build_records, bench_serialize,
+        BENCH_STREAM },
+    { "ser-writer", "records through a jx_writer to /dev/null", build_records, bench_serialize,
+        BENCH_WRITER },
+    { "ser-into", "records measured, then into a buffer", build_records, bench_serialize,
+        BENCH_INTO },
+    { "ser-cached", "records with caches, one change each", build_records, bench_serialize,
+        BENCH_CACHE },
+    { "ser-par", "records to a string, -t threads", build_records, bench_serialize,
+        BENCH_PARALLEL },
+    { "ser-par-fd", "records to /dev/null, -t threads", build_records, bench_serialize,
+        BENCH_PARALLEL | BENCH_STREAM },
+    { "ser-floats", "array of 1M full-precision doubles", build_floats, bench_serialize },
+    { "ser-text", "array of 100K log messages", build_text, bench_serialize },
+    { "pipe-sync", "records from a pipe, jx_read loop", build_records, bench_pipe },
+    { "pipe-async", "records from a pipe, background parse", build_records, bench_pipe,
+        BENCH_ASYNC },
+    { "mux", "small messages over many connections", build_message, bench_mux },
+    { "small-new", "small messages, jx_new per message", build_message, bench_messages },
+    { "small-reset", "small messages, one context + jx_reset", build_message, bench_messages,
+        BENCH_REUSE_CONTEXT },
+    { "small-arena", "small messages, jx_reset + arena", build_message, bench_messages,
+        BENCH_REUSE_CONTEXT | BENCH_ARENA },
+};
+
+#define BENCH_MESSAGES 200000
+
+/* Callbacks that do the least a real consumer would: look at every value. */
+bool count_event(void *user) { (*(size_t *)user)++; return true; }
+bool count_string(void *user, const char *str, size_t length) { (*(size_t *)user)++; return true; }
+bool count_number(void *user, double num) { (*(size_t *)user)++; return true; }
+bool count_bool(void *user, bool value) { (*(size_t *)user)++; return true; }
+
+jx_handlers count_handlers = {
+    NULL, count_event, NULL, count_event, NULL, count_string, count_number, count_bool, count_event
+};
+
+/* Release a parsed document the way the benchmark case is configured to. */
+void bench_release(bench_case *bench, jx_arena *arena, jx_value *value)
+{
+    if (bench->flags & BENCH_ARENA) {
+        jx_arena_reset(arena);
+    }
+    else {
+        jxv_free(value);
+    }
+}
+
+/* Parse the corpus iterations times, in chunks; the timing includes releasing the
+ * document, since that is part of the cost of every parse. */
+bool bench_parse(bench_case *bench)
+{
+    bench_corpus corpus;
+    double start, elapsed;
+    jx_arena *arena = NULL;
+    size_t allocs, events;
+    long long held = 0;
+    int i;
+
+    memset(&corpus, 0, sizeof(corpus));
+
+    if (!bench->build(&corpus)) {
+        fprintf(stderr, "%s: failed to build corpus\n", bench->name);
+        free(corpus.data);
+        return false;
+    }
+
+    if ((bench->flags & BENCH_ARENA) && (arena = jx_arena_new(0)) == NULL) {
+        free(corpus.data);
+        return false;
+    }
+
+    elapsed = 0;
+    allocs = 0;
+
+    for (i = 0; i < bench_opts.iterations; i++) {
+        jx_cntx *cntx;
+        jx_value *value;
+        size_t pos;
+        int ret = 0;
+
+        if ((cntx = jx_new()) == NULL) {
+            jx_arena_free(arena);
+            free(corpus.data);
+            return false;
+        }
+
+        jx_set_arena(cntx, arena);
+
+        if (bench->flags & BENCH_CALLBACKS) {
+            jx_set_handlers(cntx, &count_handlers, &events);
+        }
+
+        events = 0;
+        bench_allocs = 0;
+        held = bench_bytes;
+        start = bench_now();
+
+        for (pos = 0; pos < corpus.length; pos += bench_opts.chunk_size) {
+            long n = corpus.length - pos;
+
+            if (n > bench_opts.chunk_size) {
+                n = bench_opts.chunk_size;
+            }
+
+            if ((ret = jx_parse_json(cntx, corpus.data + pos, n)) == -1) {
+                break;
+            }
+        }
+
+        value = jx_get_result(cntx);
+
+        held = bench_bytes - held + (arena != NULL ? jx_arena_get_size(arena) : 0);
+
+        if (ret != 1 || (value == NULL && !(bench->flags & BENCH_CALLBACKS))) {
+            fprintf(stderr, "%s: %s\n", bench->name, jx_get_error_message(cntx));
+            jx_free(cntx);
+            jx_arena_free(arena);
+            free(corpus.data);
+            return false;
+        }
+
+        bench_release(bench, arena, value);
+
+        elapsed += bench_now() - start;
+
+        if ((bench->flags & BENCH_CALLBACKS) && events != corpus.values) {
+            fprintf(stderr, "%s: expected %lu values, got %lu\n", bench->name, corpus.values, events);
+        }
+
+        allocs += bench_allocs;
+
+        jx_free(cntx);
+    }
+
+    jx_arena_free(arena);
+
+    printf("%-11s %-40s %9.1f MB/s", bench->name, bench->description,
+        (double)corpus.length * bench_opts.iterations / elapsed / 1e6);
+
+#ifdef JX_BENCH_COUNT_ALLOCS
+    printf("  %6.3f allocs/value  %6.1f bytes/value", (double)allocs / bench_opts.iterations / corpus.values,
+        (double)held / corpus.values);
+#endif
+
+    printf("\n");
+
+    free(corpus.data);
+
+    return true;
+}
+
+/* Parse the corpus once, then look up every member of every record (and of its nested
+ * location object) by name. */
+bool bench_lookup(bench_case *bench)
+{
+    const char *keys[] = { "id", "timestamp", "name", "active", "score", "tags", "location" };
+    const int n_keys = sizeof(keys) / sizeof(keys[0]);
+
+    bench_corpus corpus;
+    double start, elapsed;
+    jx_cntx *cntx;
+    jx_value *root;
+    size_t i, length, found, lookups;
+    int iteration, k;
+
+    memset(&corpus, 0, sizeof(corpus));
+
+    if (!bench->build(&corpus) || (cntx = jx_new()) == NULL) {
+        fprintf(stderr, "%s: failed to build corpus\n", bench->name);
+        free(corpus.data);
+        return false;
+    }
+
+    jx_parse_json(cntx, corpus.data, corpus.length);
+
+    if ((root = jx_get_result(cntx)) == NULL) {
+        fprintf(stderr, "%s: %s\n", bench->name, jx_get_error_message(cntx));
+        jx_free(cntx);
+        free(corpus.data);
+        return false;
+    }
+
+    length = jxa_get_length(root);
+    found = 0;
+
+    start = bench_now();
+
+    for (iteration = 0; iteration < bench_opts.iterations * 5; iteration++) {
+        for (i = 0; i < length; i++) {
+            jx_value *record = jxa_get(root, i);
+
+            for (k = 0; k < n_keys; k++) {
+                found += jxd_get(record, (char *)keys[k]) != NULL;
+            }
+
+            found += jxd_get(jxd_get(record, "location"), "lat") != NULL;
+        }
+    }
+
+    elapsed = bench_now() - start;
+
+    /* The members, "location" once more, and "lat" (only the last two are counted once). */
+    lookups = (size_t)bench_opts.iterations * 5 * length * (n_keys + 2);
+
+    if (found != (size_t)bench_opts.iterations * 5 * length * (n_keys + 1)) {
+        fprintf(stderr, "%s: %lu of %lu lookups failed\n", bench->name,
+            (unsigned long)(lookups - found), (unsigned long)lookups);
+    }
+
+    printf("%-11s %-40s %9.1f ns/lookup\n", bench->name, bench->description, elapsed / lookups * 1e9);
+
+    jxv_free(root);
+    jx_free(cntx);
+    free(corpus.data);
+
+    return true;
+}
+
+/* The same few members of every record, the inner loop of a report or an export. */
+bool bench_scan(bench_case *bench)
+{
+    const char *keys[] = { "timestamp", "status", "bytes", "duration", "user" };
+    const int n_keys = sizeof(keys) / sizeof(keys[0]);
+
+    bench_corpus corpus;
+    double start, elapsed;
+    jx_cntx *cntx;
+    jx_value *root;
+    jx_key *prepared[sizeof(keys) / sizeof(keys[0])];
+    size_t lengths[sizeof(keys) / sizeof(keys[0])];
+    size_t i, length, found, lookups;
+    int iteration, iterations, k;
+
+    memset(&corpus, 0, sizeof(corpus));
+
+    if (!bench->build(&corpus) || (cntx = jx_new()) == NULL) {
+        fprintf(stderr, "%s: failed to build corpus\n", bench->name);
+        free(corpus.data);
+        return false;
+    }
+
+    jx_parse_json(cntx, corpus.data, corpus.length);
+
+    if ((root = jx_get_result(cntx)) == NULL) {
+        fprintf(stderr, "%s: %s\n", bench->name, jx_get_error_message(cntx));
+        jx_free(cntx);
+        free(corpus.data);
+        return false;
+    }
+
+    for (k = 0; k < n_keys; k++) {
+        prepared[k] = jx_key_prepare(keys[k]);
+        lengths[k] = strlen(keys[k]);
+    }
+
+    length = jxa_get_length(root);
+    iterations = bench_opts.iterations / 4 > 0 ? bench_opts.iterations / 4 : 1;
+    found = 0;
+
+    start = bench_now();
+
+    for (iteration = 0; iteration < iterations; iteration++) {
+        for (i = 0; i < length; i++) {
+            jx_value *record = jxa_get(root, i);
+
+            if (bench->flags & BENCH_KEY_PREPARED) {
+                for (k = 0; k < n_keys; k++) {
+                    found += jxd_get_k(record, prepared[k]) != NULL;
+                }
+            }
+            else if (bench->flags & BENCH_KEY_LENGTH) {
+                for (k = 0; k < n_keys; k++) {
+                    found += jxd_get_n(record, keys[k], lengths[k]) != NULL;
+                }
+            }
+            else {
+                for (k = 0; k < n_keys; k++) {
+                    found += jxd_get(record, (char *)keys[k]) != NULL;
+                }
+            }
+        }
+    }
+
+    elapsed = bench_now() - start;
+
+    lookups = (size_t)iterations * length * n_keys;
+
+    if (found != lookups) {
+        fprintf(stderr, "%s: %lu of %lu lookups failed\n", bench->name,
+            (unsigned long)(lookups - found), (unsigned long)lookups);
+    }
+
+    printf("%-11s %-40s %9.1f ns/lookup\n", bench->name, bench->description, elapsed / lookups * 1e9);
+
+    for (k = 0; k < n_keys; k++) {
+        jx_key_free(prepared[k]);
+    }
+
+    jxv_free(root);
+    jx_free(cntx);
+    free(corpus.data);
+
+    return true;
+}
+
+/* Serialize a parsed document iterations times, measuring the output rate and the most
+ * memory held at once beyond the document itself. */
+bool bench_serialize(bench_case *bench)
+{
+    bench_corpus corpus;
+    double start, elapsed;
+    jx_cntx *cntx;
+    jx_value *root;
+    char *out, *buf = NULL;
+    size_t length = 0;
+    long long base;
+    int i, fd = -1;
+
+    memset(&corpus, 0, sizeof(corpus));
+
+    if (!bench->build(&corpus) || (cntx = jx_new()) == NULL) {
+        fprintf(stderr, "%s: failed to build corpus\n", bench->name);
+        free(corpus.data);
+        return false;
+    }
+
+    jx_parse_json(cntx, corpus.data, corpus.length);
+
+    if ((root = jx_get_result(cntx)) == NULL) {
+        fprintf(stderr, "%s: %s\n", bench->name, jx_get_error_message(cntx));
+        jx_free(cntx);
+        free(corpus.data);
+        return false;
+    }
+
+    if ((bench->flags & (BENCH_STREAM | BENCH_WRITER)) && (fd = open("/dev/null", O_WRONLY)) == -1) {
+        fprintf(stderr, "%s: %s\n", bench->name, strerror(errno));
+        jxv_free(root);
+        jx_free(cntx);
+        free(corpus.data);
+        return false;
+    }
+
+    if ((bench->flags & BENCH_CACHE) && !jxv_set_cache(root, true)) {
+        fprintf(stderr, "%s: failed to enable caches\n", bench->name);
+        jxv_free(root);
+        jx_free(cntx);
+        free(corpus.data);
+        return false;
+    }
+
+    /* The output's length, which the timed loop doesn't see when streaming. This also
+     * fills the caches, as serving the first subscriber would. */
+    if ((out = jx_serialize_json(root, false)) != NULL) {
+        length = strlen(out);
+        free(out);
+    }
+
+    /* The buffer written into, allocated once as a shared memory slot would be. */
+    if ((bench->flags & BENCH_INTO) && (buf = malloc(length)) == NULL) {
+        fprintf(stderr, "%s: %s\n", bench->name, strerror(errno));
+        jxv_free(root);
+        jx_free(cntx);
+        free(corpus.data);
+        return false;
+    }
+
+    base = bench_peak = bench_bytes;
+    start = bench_now();
+
+    for (i = 0; i < bench_opts.iterations; i++) {
+        if (bench->flags & BENCH_PARALLEL) {
+            if (bench->flags & BENCH_STREAM) {
+                if (!jx_serialize_to_fd_parallel(root, fd, bench_opts.threads)) {
+                    break;
+                }
+            }
+            else {
+                if ((out = jx_serialize_json_parallel(root, bench_opts.threads)) == NULL) {
+                    break;
+                }
+
+                free(out);
+            }
+        }
+        else if (bench->flags & BENCH_STREAM) {
+            if (!jx_serialize_to_fd(root, fd, NULL)) {
+                break;
+            }
+        }
+        else if (bench->flags & BENCH_INTO) {
+            size_t size = jx_serialized_size(root, NULL);
+
+            if (size > length || jx_serialize_into(root, buf, size, NULL) != size) {
+                break;
+            }
+        }
+        else if (bench->flags & BENCH_WRITER) {
+            jx_writer *w = jx_writer_new(root);
+
+            if (w == NULL || jx_writer_write(w, fd) != 1) {
+                jx_writer_free(w);
+                break;
+            }
+
+            jx_writer_free(w);
+        }
+        else {
+            /* A state document with one member changing between serializations. */
+            if ((bench->flags & BENCH_CACHE) &&
+                !jxd_put_bool(jxa_get(root, (i * 7919) % jxa_get_length(root)), "active", i & 1)) {
+                break;
+            }
+
+            if ((out = jx_serialize_json(root, false)) == NULL) {
+                break;
+            }
+
+            free(out);
+        }
+    }
+
+    elapsed = bench_now() - start;
+
+    if (i < bench_opts.iterations) {
+        fprintf(stderr, "%s: serialization failed\n", bench->name);
+    }
+
+    printf("%-11s %-40s %9.1f MB/s  %6.1f ns/value", bench->name, bench->description,
+        (double)length * bench_opts.iterations / elapsed / 1e6,
+        elapsed / bench_opts.iterations / corpus.values * 1e9);
+
+#ifdef JX_BENCH_COUNT_ALLOCS
+    printf("  %9.1f KB peak", (double)(bench_peak - base) / 1024);
+#endif
+
+    printf("\n");
+
+    if (fd != -1) {
+        close(fd);
+    }
+
+    free(buf);
+    jxv_free(root);
+    jx_free(cntx);
+    free(corpus.data);
+
+    return true;
+}
+
+bool bench_messages(bench_case *bench)
+{
+    bench_corpus corpus;
+    double start, elapsed;
+    jx_cntx *cntx = NULL;
+    jx_arena *arena = NULL;
+    jx_value *value;
+    size_t allocs;
+    long i, n;
+
+    memset(&corpus, 0, sizeof(corpus));
+
+    if (!bench->build(&corpus)) {
+        fprintf(stderr, "%s: failed to build corpus\n", bench->name);
+        free(corpus.data);
+        return false;
+    }
+
+    n = (long)BENCH_MESSAGES * bench_opts.iterations / BENCH_DEFAULT_ITERATIONS;
+
+    if ((bench->flags & BENCH_ARENA) && (arena = jx_arena_new(0)) == NULL) {
+        free(corpus.data);
+        return false;
+    }
+
+    if ((bench->flags & BENCH_REUSE_CONTEXT) && (cntx = jx_new()) == NULL) {
+        jx_arena_free(arena);
+        free(corpus.data);
+        return false;
+    }
+
+    bench_allocs = 0;
+    start = bench_now();
+
+    for (i = 0; i < n; i++) {
+        if (bench->flags & BENCH_REUSE_CONTEXT) {
+            jx_reset(cntx);
+        }
+        else if ((cntx = jx_new()) == NULL) {
+            jx_arena_free(arena);
+            free(corpus.data);
+            return false;
+        }
+
+        jx_set_arena(cntx, arena);
+
+        jx_parse_json(cntx, corpus.data, corpus.length);
+
+        if ((value = jx_get_result(cntx)) == NULL) {
+            fprintf(stderr, "%s: %s\n", bench->name, jx_get_error_message(cntx));
+            jx_free(cntx);
+            jx_arena_free(arena);
+            free(corpus.data);
+            return false;
+        }
+
+        bench_release(bench, arena, value);
+
+        if (!(bench->flags & BENCH_REUSE_CONTEXT)) {
+            jx_free(cntx);
+        }
+    }
+
+    elapsed = bench_now() - start;
+    allocs = bench_allocs;
+
+    if (bench->flags & BENCH_REUSE_CONTEXT) {
+        jx_free(cntx);
+    }
+
+    jx_arena_free(arena);
+
+    printf("%-11s %-40s %9.1f MB/s  %8.0f msgs/s", bench->name, bench->description,
+        (double)corpus.length * n / elapsed / 1e6, n / elapsed);
+
+#ifdef JX_BENCH_COUNT_ALLOCS
+    printf("  %6.3f allocs/value", (double)allocs / n / corpus.values);
+#endif
+
+    printf("\n");
+
+    free(corpus.data);
+
+    return true;
+}
+
+/* Parse the corpus as it arrives through a pipe from a child process, either with the
+ * synchronous jx_read() loop, or by reading on this thread and parsing on a worker. */
+bool bench_pipe_parse(bench_case *bench, jx_cntx *cntx, int fd)
+{
+    ssize_t n;
+
+    if (!(bench->flags & BENCH_ASYNC)) {
+        do {
+            n = jx_read(cntx, fd, BENCH_PIPE_BUF_SIZE);
+        } while (n > 0 || n == -1);
+
+        return n == 0;
+    }
+    else {
+        char *buf;
+        bool ok = true;
+
+        if ((buf = malloc(BENCH_PIPE_BUF_SIZE)) == NULL || !jx_parse_async_start(cntx)) {
+            free(buf);
+            return false;
+        }
+
+        while (ok && (n = read(fd, buf, BENCH_PIPE_BUF_SIZE)) != 0) {
+            if (n > 0) {
+                ok = jx_parse_async_feed(cntx, buf, n);
+            }
+        }
+
+        free(buf);
+
+        return jx_parse_async_finish(cntx) == 1 && ok;
+    }
+}
+
+bool bench_pipe(bench_case *bench)
+{
+    bench_corpus corpus;
+    double start, elapsed;
+    int i;
+
+    memset(&corpus, 0, sizeof(corpus));
+
+    if (!bench->build(&corpus)) {
+        fprintf(stderr, "%s: failed to build corpus\n", bench->name);
+        free(corpus.data);
+        return false;
+    }
+
+    elapsed = 0;
+
+    for (i = 0; i < bench_opts.iterations; i++) {
+        jx_cntx *cntx;
+        int fds[2];
+        pid_t pid;
+        bool ok;
+
+        if ((cntx = jx_new()) == NULL || pipe(fds) == -1) {
+            jx_free(cntx);
+            free(corpus.data);
+            return false;
+        }
+
+        start = bench_now();
+
+        if ((pid = fork()) == 0) {
+            size_t pos;
+            ssize_t n;
+
+            close(fds[0]);
+
+            for (pos = 0; pos < corpus.length; pos += n) {
+                if ((n = write(fds[1], corpus.data + pos, corpus.length - pos)) == -1) {
+                    _exit(1);
+                }
+            }
+
+            _exit(0);
+        }
+
+        close(fds[1]);
+
+        ok = pid != -1 && bench_pipe_parse(bench, cntx, fds[0]);
+
+        close(fds[0]);
+
+        if (pid != -1) {
+            waitpid(pid, NULL, 0);
+        }
+
+        if (ok) {
+            jxv_free(jx_get_result(cntx));
+        }
+
+        elapsed += bench_now() - start;
+
+        if (!ok) {
+            fprintf(stderr, "%s: %s\n", bench->name, jx_get_error_message(cntx));
+            jx_free(cntx);
+            free(corpus.data);
+            return false;
+        }
+
+        jx_free(cntx);
+    }
+
+    printf("%-11s %-40s %9.1f MB/s  %8.1f ms\n", bench->name, bench->description,
+        (double)corpus.length * bench_opts.iterations / elapsed / 1e6,
+        elapsed / bench_opts.iterations * 1e3);
+
+    free(corpus.data);
+
+    return true;
+}
+
+void mux_done(jx_mux *mux, int fd, jx_cntx *cntx, jx_value *root, void *user)
+{
+    if (root == NULL) {
+        fprintf(stderr, "mux: %s\n", jx_get_error_message(cntx));
+    }
+    else {
+        (*(size_t *)user)++;
+    }
+
+    jxv_free(root);
+}
+
+/* Send one message over each of n connections in two halves, and time how long the
+ * multiplexer takes to collect them all. */
+bool bench_mux_connections(bench_case *bench, bench_corpus *corpus, size_t n)
+{
+    jx_mux *mux;
+    jx_cntx **cntxs;
+    int (*fds)[2];
+    size_t i, completed = 0, half = corpus->length / 2;
+    double start, elapsed;
+    bool ok = true;
+
+    cntxs = calloc(n, sizeof(jx_cntx *));
+    fds = malloc(n * sizeof(fds[0]));
+
+    if (cntxs == NULL || fds == NULL || (mux = jx_mux_new(mux_done, &completed)) == NULL) {
+        free(cntxs);
+        free(fds);
+        return false;
+    }
+
+    for (i = 0; i < n && ok; i++) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]) == -1) {
+            fprintf(stderr, "%s: socketpair: %s\n", bench->name, strerror(errno));
+            n = i;
+            ok = false;
+            break;
+        }
+
+        fcntl(fds[i][0], F_SETFL, fcntl(fds[i][0], F_GETFL) | O_NONBLOCK);
+
+        if ((cntxs[i] = jx_new()) == NULL || !jx_mux_add(mux, fds[i][0], cntxs[i])) {
+            n = i + 1;
+            ok = false;
+        }
+    }
+
+    start = bench_now();
+
+    if (ok) {
+        for (i = 0; i < n; i++) {
+            ok = ok && write(fds[i][1], corpus->data, half) == half;
+        }
+
+        /* Epoll reports a bounded number of events per call; enough calls to see every
+         * connection once, so that each message is parsed in two pieces. */
+        for (i = 0; i < n / 256 + 1; i++) {
+            jx_mux_run(mux, 0);
+        }
+
+        for (i = 0; i < n; i++) {
+            ok = ok && write(fds[i][1], corpus->data + half, corpus->length - half) == corpus->length - half;
+        }
+
+        while (ok && jx_mux_get_size(mux) > 0) {
+            ok = jx_mux_run(mux, 1000) != -1;
+        }
+    }
+
+    elapsed = bench_now() - start;
+
+    if (ok && completed == n) {
+        char description[64];
+
+        snprintf(description, sizeof(description), "%lu connections over socketpairs", n);
+
+        printf("%-11s %-40s %9.1f MB/s  %8.0f msgs/s  %6.2f us/msg\n", bench->name, description,
+            (double)corpus->length * n / elapsed / 1e6, n / elapsed, elapsed / n * 1e6);
+    }
+
+    for (i = 0; i < n; i++) {
+        close(fds[i][0]);
+        close(fds[i][1]);
+        jx_free(cntxs[i]);
+    }
+
+    jx_mux_free(mux);
+    free(cntxs);
+    free(fds);
+
+    return ok && completed == n;
+}
+
+bool bench_mux(bench_case *bench)
+{
+    static const size_t connections[] = { 100, 1000, 10000 };
+
+    bench_corpus corpus;
+    struct rlimit limit;
+    size_t i, max_connections;
+    bool ok = true;
+
+    memset(&corpus, 0, sizeof(corpus));
+
+    if (!bench->build(&corpus)) {
+        free(corpus.data);
+        return false;
+    }
+
+    /* Two descriptors per connection, and a few to spare. */
+    getrlimit(RLIMIT_NOFILE, &limit);
+
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    max_connections = (limit.rlim_cur - 64) / 2;
+
+    for (i = 0; i < sizeof(connections) / sizeof(connections[0]) && ok; i++) {
+        size_t n = connections[i];
+
+        if (n > max_connections) {
+            printf("%-11s (%lu connections limited to %lu by RLIMIT_NOFILE)\n", bench->name, n, max_connections);
+            n = max_connections;
+        }
+
+        ok = bench_mux_connections(bench, &corpus, n);
+    }
+
+    free(corpus.data);
+
+    return ok;
+}
+
+void show_usage(const char *name)
+{
+    size_t i;
+
+    printf("usage: %s [-b benchmark] [-n iterations] [-c chunk-size] [-t threads]\n\n", name);
+
+    for (i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++) {
+        printf("    %-11s %s\n", bench_cases[i].name, bench_cases[i].description);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool ok = true;
+    size_t i;
+    int ch;
+
+    bench_opts.iterations = BENCH_DEFAULT_ITERATIONS;
+    bench_opts.chunk_size = BENCH_DEFAULT_CHUNK_SIZE;
+
+    while ((ch = getopt(argc, argv, "b:n:c:t:h")) != -1) {
+        switch (ch) {
+            case 'b':
+                bench_opts.name = optarg;
+                break;
+            case 'n':
+                bench_opts.iterations = atoi(optarg);
+                break;
+            case 'c':
+                bench_opts.chunk_size = atol(optarg);
+                break;
+            case 't':
+                bench_opts.threads = atoi(optarg);
+                break;
+            default:
+                show_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (bench_opts.iterations <= 0 || bench_opts.chunk_size <= 0) {
+        show_usage(argv[0]);
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++) {
+        if (bench_opts.name != NULL && strcmp(bench_opts.name, bench_cases[i].name) != 0) {
+            continue;
+        }
+
+        jxd_set_default_engine((bench_cases[i].flags & BENCH_TRIE) ? JX_DICT_TRIE : JX_DICT_HASH);
+
+        if (!bench_cases[i].run(&bench_cases[i])) {
+            ok = false;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
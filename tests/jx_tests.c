@@ -45,15 +45,23 @@
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <math.h>
 
 #ifndef WIN32
 #include <unistd.h>
+#include <sys/socket.h>
 #endif
 
 #include <jx.h>
 #include <jx_util.h>
 #include <jx_getopt.h>
+#include <jx_simd.h>
 
+/* The block size of the library's scans, which chunked input should straddle. */
+#ifndef JX_SIMD_WIDTH
+#define JX_SIMD_WIDTH 16
+#endif
 
 enum
 {
@@ -98,8 +106,11 @@ struct json_test
     { true, "[ -1.5e4, -1.5, -1, 0, 0.5, 2, 3.14, 1024 ]" },
     { true, "[[[1024]]]" },
     { true, "[[[5, 9 ]]]" },
+    { true, "[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[1]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]" },
     { true, "[ [ 9, 3, 2], [ 1.5, 99.9999, 0.9999 ], [ -40 ], -99.5e-4 ]" },
     { true, "[ true, false, null, null, false, true, [true,false,null,null,false], null ]" },
+    { true, "[ 3.14159265358979323846264338327950288419716939937510582097494459 ]" },
+    { true, "[ -123456789012345678901234567890e-10, 0.0000000000000000000000000000001 ]" },
 
     { false, "" },
     { false, "99" },
@@ -445,180 +456,2430 @@ bool execute_ext_utf8_pi_test()
     return true;
 }
 
-bool execute_simple_tests()
+bool execute_number_test()
 {
-    int i;
-    int n_tests, n_passed;
-    float score;
-    bool output = false;
+    jx_cntx *cntx;
+    jx_value *array;
+
+    size_t i;
+    bool success = true;
+
+    const char *json = "[ 0.1, 1e23, 2.2250738585072011e-308, 9007199254740993, false, -42, "
+                       "0.30000000000000004, 1.00000000000000011102230246251565404236316680908203126 ]";
+
+    double expected[] = {
+        0.1, 1e23, 2.2250738585072011e-308, 9007199254740992.0, 0.0, -42.0,
+        0.30000000000000004, 1.0000000000000002
+    };
+
+    printf("Testing number conversion:\n");
+
+    if ((cntx = jx_new()) == NULL) {
+        fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
+        return false;
+    }
+
+    /* Split every number across chunks. */
+    for (i = 0; i < strlen(json); i++) {
+        jx_parse_json(cntx, json + i, 1);
+    }
+
+    if ((array = jx_get_result(cntx)) == NULL) {
+        fprintf(stderr, "%s\n", jx_get_error_message(cntx));
+        jx_free(cntx);
+        return false;
+    }
+
+    jx_free(cntx);
+
+    for (i = 0; i < sizeof(expected) / sizeof(double); i++) {
+        if (jxa_get_type(array, i) == JX_TYPE_BOOL) {
+            continue;
+        }
+
+        if (jxa_get_number(array, i) != expected[i]) {
+            fprintf(stderr, "Error: number at index %lu is %.17g, expected %.17g.\n",
+                (unsigned long)i, jxa_get_number(array, i), expected[i]);
+            success = false;
+        }
+    }
+
+    if (success) {
+        printf("All numbers converted correctly\n");
+    }
+
+    jxv_free(array);
+
+    return success;
+}
+
+bool execute_number_format_test()
+{
+    const double numbers[] = {
+        3.14159265, 0.1, 0.30000000000000004, -2.5, 1e21, 1e20, 123456789012345680000.0, 1.5e-7,
+        0.000001, 5e-324, 1.7976931348623157e308, 2.2250738585072014e-308, 1.0 / 3, 100, -0.0
+    };
+    const char *expected = "[3.14159265,0.1,0.30000000000000004,-2.5,1e+21,100000000000000000000,"
+        "123456789012345680000,1.5e-7,0.000001,5e-324,1.7976931348623157e+308,2.2250738585072014e-308,"
+        "0.3333333333333333,100,-0,null]";
 
     jx_cntx *cntx;
-    jx_value *value;
+    jx_value *array, *parsed = NULL;
+    char *out;
+    size_t i;
+    bool success = true;
 
-    printf("Executing simple tests:\n");
+    printf("Testing number formatting:\n");
 
-    n_tests = sizeof(simple_tests) / sizeof(struct json_test);
-    n_passed = 0;
+    array = jxa_new(16);
 
-    for (i = 0; i < n_tests; i++) {
-        bool passed = false;
+    for (i = 0; i < sizeof(numbers) / sizeof(double); i++) {
+        jxa_push_number(array, numbers[i]);
+    }
 
-        if ((cntx = jx_new()) == NULL) {
-            fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
-            break;
+    /* Infinities and NaNs have no JSON form. */
+    jxa_push_number(array, HUGE_VAL);
+
+    if ((out = jx_serialize_json(array, false)) == NULL || strcmp(out, expected) != 0) {
+        fprintf(stderr, "Error: expected [%s], got [%s].\n", expected, out);
+        success = false;
+    }
+
+    /* Every number reads back as itself. */
+    if (success && (cntx = jx_new()) != NULL) {
+        jx_parse_json(cntx, out, strlen(out));
+
+        if ((parsed = jx_get_result(cntx)) == NULL) {
+            fprintf(stderr, "%s\n", jx_get_error_message(cntx));
+            success = false;
         }
 
-        jx_parse_json(cntx, simple_tests[i].json, strlen(simple_tests[i].json));
+        for (i = 0; i < sizeof(numbers) / sizeof(double) && success; i++) {
+            double num = jxa_get_number(parsed, i);
 
-        if ((value = jx_get_result(cntx)) != NULL) {
-            jxv_free(value);
-            passed = true;
+            if (memcmp(&num, &numbers[i], sizeof(double)) != 0) {
+                fprintf(stderr, "Error: number at index %lu read back as %.17g.\n", (unsigned long)i, num);
+                success = false;
+            }
         }
 
-        if (cmd_opts.verbose || passed != simple_tests[i].should_pass) {
-            if (!output) {
-                printf("----------------------------------------------------------\n");
-                output = true;
+        jxv_free(parsed);
+        jx_free(cntx);
+    }
+
+    free(out);
+    jxv_free(array);
+
+    if (success) {
+        printf("Success\n");
+    }
+
+    return success;
+}
+
+/* The serializer's escaping, a byte at a time. */
+void escape_string(char *dst, const char *src, size_t length)
+{
+    size_t i;
+
+    *dst++ = '"';
+
+    for (i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)src[i];
+
+        switch (c) {
+            case '"': dst += sprintf(dst, "\\\""); break;
+            case '\\': dst += sprintf(dst, "\\\\"); break;
+            case '\b': dst += sprintf(dst, "\\b"); break;
+            case '\f': dst += sprintf(dst, "\\f"); break;
+            case '\n': dst += sprintf(dst, "\\n"); break;
+            case '\r': dst += sprintf(dst, "\\r"); break;
+            case '\t': dst += sprintf(dst, "\\t"); break;
+            default:
+                if (c < 0x20) {
+                    dst += sprintf(dst, "\\u%04x", c);
+                }
+                else {
+                    *dst++ = c;
+                }
+                break;
+        }
+    }
+
+    *dst++ = '"';
+    *dst = '\0';
+}
+
+bool execute_escape_test()
+{
+    const char specials[] = { '"', '\\', '\n', '\t', 0x01, 0x1f, 0x7f, (char)0xc3, 0x00 };
+
+    char str[128], expected[1024];
+    jx_value *value;
+    char *out;
+    size_t length, pos;
+    bool success = true;
+    int s;
+
+    printf("Testing string escaping:\n");
+
+    /* Each kind of byte at each position of strings shorter and longer than a block. */
+    for (length = 1; length < 100 && success; length++) {
+        for (pos = 0; pos < length && success; pos++) {
+            for (s = 0; s < (int)sizeof(specials) && success; s++) {
+                memset(str, 'a' + (int)(length % 26), length);
+                str[pos] = specials[s];
+
+                value = jxa_new(1);
+                jxa_push(value, jxs_new_n(str, length));
+
+                expected[0] = '[';
+                escape_string(expected + 1, str, length);
+                strcat(expected, "]");
+
+                if ((out = jx_serialize_json(value, false)) == NULL || strcmp(out, expected) != 0) {
+                    fprintf(stderr, "Error: expected [%s], got [%s].\n", expected, out);
+                    success = false;
+                }
+
+                free(out);
+                jxv_free(value);
             }
+        }
+    }
 
-            printf("Json: %s\nResult: %s\nExpected Result: %s\nMessage: %s\n",
-                simple_tests[i].json,
-                passed ? "Passed" : "Failed",
-                simple_tests[i].should_pass ? "Pass" : "Fail",
-                !passed ? jx_get_error_message(cntx) : "OK");
+    /* Escaped strings parse back to themselves (the parser rejects control characters
+     * other than the named ones, even escaped). */
+    if (success) {
+        const char *json = "[\"tab\\there\\r\\n \\\"quoted\\\" back\\\\slash caf\\u00e9 \\/ end\"]";
+        jx_cntx *cntx = jx_new();
+        jx_value *reparsed = NULL;
 
-            printf("----------------------------------------------------------\n");
+        jx_parse_json(cntx, json, strlen(json));
+
+        if ((value = jx_get_result(cntx)) == NULL || (out = jx_serialize_json(value, false)) == NULL) {
+            fprintf(stderr, "Error: %s\n", jx_get_error_message(cntx));
+            success = false;
         }
+        else {
+            jx_reset(cntx);
+            jx_parse_json(cntx, out, strlen(out));
+
+            if ((reparsed = jx_get_result(cntx)) == NULL ||
+                jxs_get_length(jxa_get(reparsed, 0)) != jxs_get_length(jxa_get(value, 0)) ||
+                memcmp(jxs_get_str(jxa_get(reparsed, 0)), jxs_get_str(jxa_get(value, 0)),
+                    jxs_get_length(jxa_get(value, 0))) != 0) {
+                fprintf(stderr, "Error: [%s] didn't read back as the same string.\n", out);
+                success = false;
+            }
 
-        if (passed == simple_tests[i].should_pass) {
-            n_passed++;
+            free(out);
         }
 
+        jxv_free(reparsed);
+        jxv_free(value);
         jx_free(cntx);
     }
 
-    score = ((float)n_passed / (float)n_tests) * 100.0f;
-
-    printf("%d of %d Tests Passed (%.1f%%)\n", n_passed, n_tests, score);
+    if (success) {
+        printf("Success\n");
+    }
 
-    return n_tests == n_passed;
+    return success;
 }
 
-bool run_tests()
+bool execute_position_test()
 {
-    if (!execute_simple_tests()) {
-        return false;
-    }
+    jx_cntx *cntx;
+    char single[256];
+    bool success;
+    size_t chunk, pos, length;
 
-    printf("\n");
+    const char *json =
+        "{\n"
+        "    \"values\": [\n"
+        "\t\t1,\n"
+        "                                        2,\n"
+        "\t  \t  3 $\n"
+        "    ]\n"
+        "}";
 
-    if (!strings_test()) {
+    const char *expected = "Syntax Error [5:13]: Illegal token ($).";
+
+    printf("Testing line and column tracking:\n");
+
+    if ((cntx = jx_new()) == NULL) {
+        fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
         return false;
     }
 
-    printf("\n");
+    length = strlen(json);
 
-    if (!execute_muli_part_parse_test()) {
-        return false;
+    jx_parse_json(cntx, json, length);
+
+    snprintf(single, sizeof(single), "%s", jx_get_error_message(cntx));
+
+    if (!(success = strcmp(single, expected) == 0)) {
+        fprintf(stderr, "Error: expected [%s], got [%s].\n", expected, single);
     }
 
-    printf("\n");
+    /* The position is carried over from chunk to chunk, whichever way the chunks fall
+     * across the blocks the line and column counts are taken over. */
+    for (chunk = 1; chunk <= 2 * JX_SIMD_WIDTH && success; chunk++) {
+        jx_reset(cntx);
 
-    if (!execute_ext_utf8_pi_test()) {
-        return false;
+        for (pos = 0; pos < length; pos += chunk) {
+            if (jx_parse_json(cntx, json + pos, pos + chunk < length ? chunk : length - pos) != 0) {
+                break;
+            }
+        }
+
+        if (strcmp(jx_get_error_message(cntx), single) != 0) {
+            fprintf(stderr, "Error: in chunks of %lu, expected [%s], got [%s].\n", chunk, single,
+                jx_get_error_message(cntx));
+            success = false;
+        }
     }
 
-    return true;
+    if (success) {
+        printf("Success\n");
+    }
+
+    jx_free(cntx);
+
+    return success;
 }
 
-bool validate_json_string(const char *json)
+bool execute_reset_test()
 {
     jx_cntx *cntx;
     jx_value *value;
     char *out;
+    bool success = true;
+
+    /* Each step parses one document with the same context; only the last step must fail. */
+    struct
+    {
+        const char *json;
+        bool complete;
+        const char *expected;
+    } steps[] = {
+        { "[ 1, 2, [ \"three\" ], ]", true, "[1,2,[\"three\"]]" },
+        { "[ 99, $ ]", false, NULL },
+        { "{ \"abandoned\": [ 1, { \"x\": \"partial str", false, NULL },
+        { "{ \"a\": [ true, null, ], \"b\": -1.5 }", true, "{\"a\":[true,null],\"b\":-1.5}" },
+        { "[\n  $ ]", false, "Syntax Error [2:3]: Illegal token ($)." }
+    };
 
-    if (json == NULL) {
-        return false;
-    }
+    int i, n_steps = sizeof(steps) / sizeof(steps[0]);
+
+    printf("Testing context reuse:\n");
 
     if ((cntx = jx_new()) == NULL) {
         fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
         return false;
     }
 
-    jx_set_extensions(cntx, global_extensions);
+    jx_set_extensions(cntx, JX_EXT_ARRAY_TRAILING_COMMA);
 
-    jx_parse_json(cntx, json, strlen(json));
+    for (i = 0; i < n_steps && success; i++) {
+        jx_reset(cntx);
 
-    if ((value = jx_get_result(cntx)) == NULL) {
-        fprintf(stderr, "%s\n", jx_get_error_message(cntx));
-        jx_free(cntx);
-        return false;
-    }
+        jx_parse_json(cntx, steps[i].json, strlen(steps[i].json));
 
-    if (cmd_opts.serialize) {
-        out = jx_serialize_json(value, cmd_opts.escape);
+        if (!steps[i].complete) {
+            if (steps[i].expected != NULL && strcmp(jx_get_error_message(cntx), steps[i].expected) != 0) {
+                fprintf(stderr, "Error: step %d expected [%s], got [%s].\n",
+                    i, steps[i].expected, jx_get_error_message(cntx));
+                success = false;
+            }
 
-        if (out == NULL) {
-            fprintf(stderr, "Error: %s\n", strerror(errno));
-            jxv_free(value);
-            jx_free(cntx);
-            return false;
+            continue;
         }
 
-        printf("%s", out);
+        if ((value = jx_get_result(cntx)) == NULL) {
+            fprintf(stderr, "Error: step %d: %s\n", i, jx_get_error_message(cntx));
+            success = false;
+            continue;
+        }
 
-        if (!cmd_opts.newline) {
-            putchar('\n');
+        out = jx_serialize_json(value, false);
+
+        jxv_free(value);
+
+        if (out == NULL || strcmp(out, steps[i].expected) != 0) {
+            fprintf(stderr, "Error: step %d expected [%s], got [%s].\n", i, steps[i].expected, out);
+            success = false;
         }
 
         free(out);
     }
 
-    jxv_free(value);
+    if (success) {
+        printf("Success\n");
+    }
+
     jx_free(cntx);
 
-    return true;
+    return success;
 }
 
-bool validate_json_file(const char *path)
+bool execute_arena_test()
 {
     jx_cntx *cntx;
-    jx_value *value;
-    char *json;
+    jx_arena *arena;
+    jx_value *value, *array, *str;
+    char *out = NULL;
+    bool success = false;
+    int i, round;
 
-    if ((cntx = jx_new()) == NULL) {
+    const char *json = "{ \"name\": \"arena\", \"values\": [ 1, 2.5, \"three\", { \"four\": [ 4 ] } ] }";
+    const char *expected =
+        "{\"name\":\"arena-allocated\",\"values\":[1,2.5,\"three\",{\"four\":[4]},0,1,2,3,4,5,6,7,8,9]}";
+
+    printf("Testing arena allocation:\n");
+
+    /* A tiny block size makes most allocations overflow into new (or oversized) blocks. */
+    if ((cntx = jx_new()) == NULL || (arena = jx_arena_new(64)) == NULL) {
         fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
+        jx_free(cntx);
         return false;
     }
 
-    jx_set_extensions(cntx, global_extensions);
+    jx_set_arena(cntx, arena);
 
-    value = jx_obj_from_file(cntx, path);
+    /* The second round reuses the blocks kept by jx_arena_reset(). */
+    for (round = 0; round < 2; round++) {
+        jx_reset(cntx);
 
-    if (value == NULL) {
-        fprintf(stderr, "%s\n", jx_get_error_message(cntx));
-        jx_free(cntx);
-        return false;
-    }
+        jx_parse_json(cntx, json, strlen(json));
 
-    if (cmd_opts.serialize) {
-        json = jx_serialize_json(value, cmd_opts.escape);
+        if ((value = jx_get_result(cntx)) == NULL) {
+            fprintf(stderr, "Error: %s\n", jx_get_error_message(cntx));
+            break;
+        }
 
-        if (json == NULL) {
-            fprintf(stderr, "Error: %s\n", strerror(errno));
-            jxv_free(value);
-            jx_free(cntx);
-            return false;
+        array = jxd_get(value, "values");
+        str = jxd_get(value, "name");
+
+        if (jxv_get_arena(value) != arena || jxv_get_arena(array) != arena) {
+            fprintf(stderr, "Error: parsed values were not allocated from the arena.\n");
+            break;
         }
 
-        printf("%s", json);
+        for (i = 0; i < 10; i++) {
+            jxa_push_number(array, i);
+        }
 
-        if (!cmd_opts.newline) {
-            putchar('\n');
+        jxs_append_str(str, "-allocated");
+
+        jxd_put_number(value, "deleted", 1);
+        jxd_del_free(value, "deleted");
+
+        out = jx_serialize_json(value, false);
+
+        /* A no-op for arena values; the whole document goes with the reset below. */
+        jxv_free(value);
+
+        if (out == NULL || strcmp(out, expected) != 0) {
+            fprintf(stderr, "Error: expected [%s], got [%s].\n", expected, out);
+            break;
         }
 
-        free(json);
+        free(out);
+        out = NULL;
+
+        jx_arena_reset(arena);
+    }
+
+    if (round == 2) {
+        success = true;
+        printf("Success\n");
+    }
+
+    free(out);
+    jx_free(cntx);
+    jx_arena_free(arena);
+
+    return success;
+}
+
+struct sax_log
+{
+    char buf[512];
+    size_t length;
+
+    const char *chunk;
+    size_t chunk_length;
+    int views;
+
+    int abort_at;
+    int events;
+};
+
+bool sax_append(struct sax_log *log, const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    log->length += vsnprintf(log->buf + log->length, sizeof(log->buf) - log->length, fmt, ap);
+    va_end(ap);
+
+    if (log->length >= sizeof(log->buf)) {
+        log->length = sizeof(log->buf) - 1;
+    }
+
+    return ++log->events != log->abort_at;
+}
+
+bool sax_view(struct sax_log *log, const char *prefix, const char *str, size_t length)
+{
+    if (str >= log->chunk && str + length <= log->chunk + log->chunk_length) {
+        log->views++;
+    }
+
+    return sax_append(log, "%s:%.*s ", prefix, (int)length, str);
+}
+
+bool sax_start_object(void *user) { return sax_append(user, "{ "); }
+bool sax_end_object(void *user) { return sax_append(user, "} "); }
+bool sax_start_array(void *user) { return sax_append(user, "[ "); }
+bool sax_end_array(void *user) { return sax_append(user, "] "); }
+bool sax_key(void *user, const char *key, size_t length) { return sax_view(user, "k", key, length); }
+bool sax_string(void *user, const char *str, size_t length) { return sax_view(user, "s", str, length); }
+bool sax_number(void *user, double num) { return sax_append(user, "n:%g ", num); }
+bool sax_boolean(void *user, bool value) { return sax_append(user, "b:%d ", value); }
+bool sax_null(void *user) { return sax_append(user, "null "); }
+
+bool execute_callback_test()
+{
+    jx_cntx *cntx;
+    struct sax_log log;
+    size_t i, chunk_size;
+    bool success = true;
+
+    jx_handlers handlers = {
+        sax_start_object, sax_end_object, sax_start_array, sax_end_array,
+        sax_key, sax_string, sax_number, sax_boolean, sax_null
+    };
+
+    const char *json =
+        "{ \"name\": \"sax\", \"list\": [ 1, -2.5e3, true, false, null, \"a\\\"b\", [] ], "
+        "\"empty\": {}, \"u\": \"\\u03c0\" }";
+
+    const char *expected =
+        "{ k:name s:sax k:list [ n:1 n:-2500 b:1 b:0 null s:a\"b [ ] ] k:empty { } k:u s:\xCF\x80 } ";
+
+    printf("Testing callback parsing:\n");
+
+    if ((cntx = jx_new()) == NULL) {
+        fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
+        return false;
+    }
+
+    jx_set_handlers(cntx, &handlers, &log);
+
+    /* Parse in one chunk, where unescaped strings are passed in place, then a byte at a
+     * time, and finally abort from a handler. */
+    for (chunk_size = strlen(json); chunk_size > 0 && success; chunk_size = chunk_size == 1 ? 0 : 1) {
+        memset(&log, 0, sizeof(log));
+
+        jx_reset(cntx);
+
+        for (i = 0; i < strlen(json); i += chunk_size) {
+            log.chunk = json + i;
+            log.chunk_length = chunk_size;
+
+            if (jx_parse_json(cntx, json + i, chunk_size) == -1) {
+                break;
+            }
+        }
+
+        if (jx_get_result(cntx) != NULL || jx_get_error(cntx) != JX_ERROR_NONE) {
+            fprintf(stderr, "Error: chunk size %lu: %s\n", chunk_size, jx_get_error_message(cntx));
+            success = false;
+        }
+        else if (strcmp(log.buf, expected) != 0) {
+            fprintf(stderr, "Error: expected [%s], got [%s].\n", expected, log.buf);
+            success = false;
+        }
+        else if (chunk_size > 1 && log.views != 5) {
+            fprintf(stderr, "Error: expected 5 strings passed in place, got %d.\n", log.views);
+            success = false;
+        }
+    }
+
+    if (success) {
+        memset(&log, 0, sizeof(log));
+        log.abort_at = 6;
+
+        jx_reset(cntx);
+
+        if (jx_parse_json(cntx, json, strlen(json)) != -1 || jx_get_error(cntx) != JX_ERROR_ABORTED) {
+            fprintf(stderr, "Error: expected the parse to be aborted by the callback.\n");
+            success = false;
+        }
+    }
+
+    if (success) {
+        printf("Success\n");
+    }
+
+    jx_free(cntx);
+
+    return success;
+}
+
+bool execute_async_test()
+{
+    jx_cntx *cntx;
+    jx_value *value;
+    char *out;
+    size_t i;
+    int ret;
+    bool success = true;
+
+    const char *json =
+        "{ \"id\": 42, \"tags\": [ \"a\", \"b\", \"c\" ], \"nested\": { \"x\": [ 1, 2, [ 3 ] ], "
+        "\"y\": null }, \"s\": \"\\u03c0 is \\\"pi\\\"\", \"f\": [ true, false, -1.25e-3 ] }";
+
+    const char *expected =
+        "{\"id\":42,\"tags\":[\"a\",\"b\",\"c\"],\"nested\":{\"x\":[1,2,[3]],\"y\":null},"
+        "\"s\":\"\xCF\x80 is \\\"pi\\\"\",\"f\":[true,false,-0.00125]}";
+
+    const char *invalid = "[ 1, 2, 3 $ ]";
+
+    printf("Testing background parsing:\n");
+
+#ifdef WIN32
+    printf("Not supported on this platform\n");
+    return true;
+#endif
+
+    if ((cntx = jx_new()) == NULL) {
+        fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
+        return false;
+    }
+
+    /* Small chunks fill the ring quickly, so the feeding thread has to wait for the worker. */
+    if (!jx_parse_async_start(cntx)) {
+        fprintf(stderr, "Error: %s\n", jx_get_error_message(cntx));
+        jx_free(cntx);
+        return false;
+    }
+
+    for (i = 0; i < strlen(json) && success; i += 3) {
+        success = jx_parse_async_feed(cntx, json + i, strlen(json) - i < 3 ? strlen(json) - i : 3);
+    }
+
+    ret = jx_parse_async_finish(cntx);
+
+    if (!success || ret != 1 || (value = jx_get_result(cntx)) == NULL) {
+        fprintf(stderr, "Error: %s\n", jx_get_error_message(cntx));
+        jx_free(cntx);
+        return false;
+    }
+
+    out = jx_serialize_json(value, false);
+
+    jxv_free(value);
+
+    if (out == NULL || strcmp(out, expected) != 0) {
+        fprintf(stderr, "Error: expected [%s], got [%s].\n", expected, out);
+        success = false;
+    }
+
+    free(out);
+
+    /* A syntax error stops the worker; it is reported by feed or finish. */
+    if (success) {
+        jx_reset(cntx);
+
+        jx_parse_async_start(cntx);
+
+        for (i = 0; i < strlen(invalid); i++) {
+            if (!jx_parse_async_feed(cntx, invalid + i, 1)) {
+                break;
+            }
+        }
+
+        if (jx_parse_async_finish(cntx) != -1 || jx_get_error(cntx) != JX_ERROR_ILLEGAL_TOKEN) {
+            fprintf(stderr, "Error: expected an illegal token error, got [%s].\n", jx_get_error_message(cntx));
+            success = false;
+        }
+    }
+
+    /* Cancelling part way through leaves a context that can be reset and reused. */
+    if (success) {
+        jx_reset(cntx);
+
+        jx_parse_async_start(cntx);
+        jx_parse_async_feed(cntx, json, strlen(json) / 2);
+        jx_parse_async_cancel(cntx);
+
+        jx_reset(cntx);
+
+        if (jx_parse_json(cntx, json, strlen(json)) != 1) {
+            fprintf(stderr, "Error: %s\n", jx_get_error_message(cntx));
+            success = false;
+        }
+
+        jxv_free(jx_get_result(cntx));
+    }
+
+    if (success) {
+        printf("Success\n");
+    }
+
+    jx_free(cntx);
+
+    return success;
+}
+
+#ifdef __linux__
+struct mux_result
+{
+    int completed;
+    int failed;
+    double sum;
+};
+
+void mux_done(jx_mux *mux, int fd, jx_cntx *cntx, jx_value *root, void *user)
+{
+    struct mux_result *result = user;
+
+    if (root == NULL) {
+        result->failed++;
+        return;
+    }
+
+    result->completed++;
+
+    iterate_array(root, &result->sum, sum_func);
+
+    jxv_free(root);
+}
+#endif
+
+bool execute_mux_test()
+{
+#ifdef __linux__
+    jx_mux *mux;
+    jx_cntx *cntxs[4];
+    int fds[4][2];
+    struct mux_result result;
+    int i, rounds;
+    bool success = true;
+
+    /* Each connection receives its document in two pieces; the third sends an illegal
+     * token, and the fourth hangs up half way through. */
+    const char *pieces[4][2] = {
+        { "[ 1, 2", "0, 3 ]" },
+        { "[ 100", "0 ] " },
+        { "[ 5, ", "$ ]" },
+        { "[ 7, ", NULL }
+    };
+
+    printf("Testing multiplexed reads:\n");
+
+    memset(&result, 0, sizeof(result));
+
+    if ((mux = jx_mux_new(mux_done, &result)) == NULL) {
+        fprintf(stderr, "Error creating multiplexer: %s\n", strerror(errno));
+        return false;
+    }
+
+    for (i = 0; i < 4; i++) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]) == -1 || (cntxs[i] = jx_new()) == NULL) {
+            fprintf(stderr, "Error creating connection: %s\n", strerror(errno));
+            return false;
+        }
+
+        fcntl(fds[i][0], F_SETFL, fcntl(fds[i][0], F_GETFL) | O_NONBLOCK);
+
+        jx_mux_add(mux, fds[i][0], cntxs[i]);
+    }
+
+    for (rounds = 0; rounds < 2; rounds++) {
+        for (i = 0; i < 4; i++) {
+            if (pieces[i][rounds] != NULL) {
+                write(fds[i][1], pieces[i][rounds], strlen(pieces[i][rounds]));
+            }
+            else {
+                close(fds[i][1]);
+                fds[i][1] = -1;
+            }
+        }
+
+        jx_mux_run(mux, 0);
+    }
+
+    while (jx_mux_get_size(mux) > 0) {
+        if (jx_mux_run(mux, 1000) == -1) {
+            break;
+        }
+    }
+
+    if (result.completed != 2 || result.failed != 2 || result.sum != 1024) {
+        fprintf(stderr, "Error: expected 2 documents (sum 1024) and 2 failures, got %d (sum %.0f) and %d.\n",
+            result.completed, result.sum, result.failed);
+        success = false;
+    }
+    else if (jx_get_error(cntxs[2]) != JX_ERROR_ILLEGAL_TOKEN ||
+             jx_get_error(cntxs[3]) != JX_ERROR_INCOMPLETE_OBJECT) {
+        fprintf(stderr, "Error: unexpected errors [%s], [%s].\n",
+            jx_get_error_message(cntxs[2]), jx_get_error_message(cntxs[3]));
+        success = false;
+    }
+
+    for (i = 0; i < 4; i++) {
+        close(fds[i][0]);
+
+        if (fds[i][1] != -1) {
+            close(fds[i][1]);
+        }
+
+        jx_free(cntxs[i]);
+    }
+
+    jx_mux_free(mux);
+
+    if (success) {
+        printf("Success\n");
+    }
+
+    return success;
+#else
+    printf("Testing multiplexed reads:\n");
+    printf("Not supported on this platform\n");
+
+    return true;
+#endif
+}
+
+bool execute_small_string_test()
+{
+    jx_value *str, *copy;
+    char expected[64];
+    bool success = false;
+    int i;
+
+    printf("Testing short and growing strings:\n");
+
+    if ((str = jxs_new("ok")) == NULL) {
+        fprintf(stderr, "Error allocating string: %s\n", strerror(errno));
+        return false;
+    }
+
+    strcpy(expected, "ok");
+
+    /* Grow one character at a time past the size that fits inside the value, then
+     * shrink back down, checking the contents at every length. */
+    for (i = 0; i < 80; i++) {
+        size_t length = strlen(expected);
+
+        if (i < 40) {
+            expected[length] = 'a' + i % 26;
+            expected[length + 1] = '\0';
+
+            jxs_push(str, expected[length]);
+        }
+        else if (jxs_pop(str) != expected[length - 1]) {
+            fprintf(stderr, "Error: popped the wrong character at length %lu.\n", length);
+            break;
+        }
+        else {
+            expected[length - 1] = '\0';
+        }
+
+        if (strcmp(jxs_get_str(str), expected) != 0 || jxs_top(str) != expected[strlen(expected) - 1]) {
+            fprintf(stderr, "Error: expected [%s], got [%s].\n", expected, jxs_get_str(str));
+            break;
+        }
+    }
+
+    copy = jxs_new_n("0123456789abcdef", 13);
+
+    if (i == 80 && copy != NULL && jxs_append_jxs(str, copy) && jxs_append_fmt(str, "-%d", 42) &&
+        strcmp(jxs_get_str(str), "ok0123456789abc-42") == 0 && jxs_append_str(copy, "") &&
+        strcmp(jxs_get_str(copy), "0123456789abc") == 0) {
+        success = true;
+        printf("Success\n");
+    }
+    else if (i == 80) {
+        fprintf(stderr, "Error: appending strings failed [%s].\n", jxs_get_str(str));
+    }
+
+    jxv_free(copy);
+    jxv_free(str);
+
+    return success;
+}
+
+/* Strings spanning several blocks of the widest SIMD scan (32 bytes), with a byte that
+ * stops the scan at each position in turn: an escape, a control byte (which is rejected),
+ * the start of a UTF-8 sequence, or the end of the string. Each is parsed whole, then
+ * split in two at every point, so that it takes both the path for a string found whole in
+ * its chunk and the one for a string copied from several. */
+bool execute_string_scan_test()
+{
+    struct
+    {
+        const char *json;
+        const char *text;
+        bool last;
+    } specials[] = {
+        { "\\\"", "\"", false },
+        { "\\\\", "\\", false },
+        { "\\n", "\n", false },
+        { "\x01", NULL, false },
+        { "\xc3\xa9", "\xc3\xa9", false },
+        { "", "", true }
+    };
+
+    jx_cntx *cntx;
+    jx_value *value;
+    char body[81], json[128], expected[128];
+    bool success = true;
+    int i, pos, split, length, n_specials = sizeof(specials) / sizeof(specials[0]);
+
+    printf("Testing string scanning:\n");
+
+    if ((cntx = jx_new()) == NULL) {
+        fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
+        return false;
+    }
+
+    for (i = 0; i < 80; i++) {
+        body[i] = 'a' + i % 26;
+    }
+
+    body[80] = '\0';
+
+    for (i = 0; i < n_specials && success; i++) {
+        for (pos = 0; pos < 80 && success; pos++) {
+            const char *rest = specials[i].last ? "" : body + pos;
+
+            length = sprintf(json, "[\"%.*s%s%s\"]", pos, body, specials[i].json, rest);
+            sprintf(expected, "%.*s%s%s", pos, body, specials[i].text != NULL ? specials[i].text : "", rest);
+
+            for (split = 0; split < length && success; split++) {
+                jx_reset(cntx);
+
+                if (split == 0) {
+                    jx_parse_json(cntx, json, length);
+                }
+                else if (jx_parse_json(cntx, json, split) == 0) {
+                    jx_parse_json(cntx, json + split, length - split);
+                }
+
+                value = jx_get_result(cntx);
+
+                if (specials[i].text == NULL ? value != NULL :
+                    value == NULL || strcmp(jxs_get_str(jxa_get(value, 0)), expected) != 0) {
+                    fprintf(stderr, "Error: special %d at %d, split at %d: got [%s].\n", i, pos, split,
+                        value != NULL ? jxs_get_str(jxa_get(value, 0)) : jx_get_error_message(cntx));
+                    success = false;
+                }
+
+                jxv_free(value);
+            }
+        }
+    }
+
+    if (success) {
+        printf("Success\n");
+    }
+
+    jx_free(cntx);
+
+    return success;
+}
+
+void collect_keys(const char *key, jx_value *value, void *ptr)
+{
+    jxs_append_fmt(ptr, "%s,", key);
+}
+
+bool execute_object_test()
+{
+    jx_dict_engine engines[] = { JX_DICT_HASH, JX_DICT_TRIE };
+    const char *orders[] = { "b,c,a,", "a,b,c," };
+
+    jx_value *dict, *keys;
+    char key[32];
+    bool success = true;
+    int e, i;
+
+    printf("Testing objects:\n");
+
+    for (e = 0; e < 2 && success; e++) {
+        jxd_set_default_engine(engines[e]);
+
+        dict = jxd_new();
+        keys = jxs_new(NULL);
+
+        if (dict == NULL || keys == NULL) {
+            fprintf(stderr, "Error allocating object: %s\n", strerror(errno));
+            jxv_free(dict);
+            jxv_free(keys);
+            success = false;
+            break;
+        }
+
+        /* Replacing a value keeps the key where it was. */
+        jxd_put_number(dict, "b", 1);
+        jxd_put_number(dict, "c", 2);
+        jxd_put_number(dict, "a", 3);
+        jxd_put_number(dict, "b", 4);
+
+        jxd_iterate(dict, collect_keys, keys);
+
+        if (jxd_size(dict) != 3 || jxd_get_number(dict, "b", NULL) != 4 ||
+            strcmp(jxs_get_str(keys), orders[e]) != 0) {
+            fprintf(stderr, "Error: engine %d has keys [%s].\n", e, jxs_get_str(keys));
+            success = false;
+        }
+
+        /* Enough keys to grow the table a few times, with deletes leaving holes behind. */
+        for (i = 0; i < 1000 && success; i++) {
+            sprintf(key, "key-%d", i);
+
+            if (!jxd_put_number(dict, key, i)) {
+                fprintf(stderr, "Error: failed to add key [%s].\n", key);
+                success = false;
+            }
+
+            if (i % 3 == 0) {
+                sprintf(key, "key-%d", i / 2);
+                jxd_del_free(dict, key);
+            }
+        }
+
+        for (i = 0; i < 1000 && success; i++) {
+            /* Every third insert deleted key i / 2: those below 500 that aren't 2 mod 3. */
+            bool found, deleted = i < 500 && i % 3 != 2;
+            double num;
+
+            sprintf(key, "key-%d", i);
+
+            num = jxd_get_number(dict, key, &found);
+
+            if (found == deleted || (found && num != i)) {
+                fprintf(stderr, "Error: engine %d, key [%s] %s.\n", e, key, found ? "found" : "missing");
+                success = false;
+            }
+        }
+
+        if (success && (jxd_size(dict) != 3 + 1000 - 334 || jxd_del(dict, "missing") != NULL)) {
+            fprintf(stderr, "Error: engine %d has %lu keys.\n", e, (unsigned long)jxd_size(dict));
+            success = false;
+        }
+
+        jxv_free(keys);
+        jxv_free(dict);
+    }
+
+    jxd_set_default_engine(JX_DICT_HASH);
+
+    /* Parsed members are added as their keys are read; a repeated key keeps its place but
+     * takes the last value. The nested object grows past the size searched linearly. */
+    if (success) {
+        const char *json = "{ \"z\": 1, \"a\": [ true ], \"z\": { \"k1\": 1, \"k2\": 2, \"k3\": 3, "
+            "\"k4\": 4, \"k5\": 5, \"k6\": 6, \"k7\": 7, \"k8\": 8, \"k9\": 9, \"k1\": 10 }, \"\": null }";
+        const char *expected = "{\"z\":{\"k1\":10,\"k2\":2,\"k3\":3,\"k4\":4,\"k5\":5,\"k6\":6,\"k7\":7,"
+            "\"k8\":8,\"k9\":9},\"a\":[true],\"\":null}";
+
+        jx_cntx *cntx = jx_new();
+        char *out = NULL;
+
+        if (cntx != NULL) {
+            jx_parse_json(cntx, json, strlen(json));
+        }
+
+        if ((dict = jx_get_result(cntx)) == NULL || jxd_size(dict) != 3 || jxd_size(jxd_get(dict, "z")) != 9 ||
+            (out = jx_serialize_json(dict, false)) == NULL || strcmp(out, expected) != 0) {
+            fprintf(stderr, "Error: expected [%s], got [%s].\n", expected, out);
+            success = false;
+        }
+
+        free(out);
+        jxv_free(dict);
+        jx_free(cntx);
+    }
+
+    if (success) {
+        printf("Success\n");
+    }
+
+    return success;
+}
+
+void first_key(const char *key, jx_value *value, void *ptr)
+{
+    const char **first = ptr;
+
+    if (*first == NULL) {
+        *first = key;
+    }
+}
+
+bool execute_intern_test()
+{
+    const char *expected = "{\"id\":5,\"k0\":0,\"k1\":1,\"k2\":2,\"k3\":3,\"k4\":4,\"k5\":5,"
+        "\"k6\":6,\"k7\":7,\"k8\":8,\"k9\":9}";
+
+    jx_cntx *cntx;
+    jx_value *json, *docs[2] = { NULL, NULL }, *obj;
+    const char *keys[2] = { NULL, NULL };
+    char key[8], *out = NULL;
+    bool success = true;
+    int i;
+
+    printf("Testing key interning:\n");
+
+    if ((cntx = jx_new()) == NULL) {
+        fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
+        return false;
+    }
+
+    /* Enough records that the keys of the later ones are shared. */
+    json = jxs_new("[");
+
+    for (i = 0; i < 100; i++) {
+        jxs_append_fmt(json, "%s{ \"id\": %d, \"name\": \"n%d\" }", i > 0 ? ", " : "", i, i);
+    }
+
+    jxs_append_str(json, "]");
+
+    for (i = 0; i < 2; i++) {
+        jx_reset(cntx);
+        jx_parse_json(cntx, jxs_get_str(json), strlen(jxs_get_str(json)));
+
+        if ((docs[i] = jx_get_result(cntx)) != NULL) {
+            jxd_iterate(jxa_get(docs[i], 99), first_key, &keys[i]);
+        }
+    }
+
+    jxv_free(json);
+
+    /* The same key is shared across objects and documents parsed by one context. */
+    if (keys[0] == NULL || keys[0] != keys[1]) {
+        fprintf(stderr, "Error: \"id\" keys are not shared.\n");
+        success = false;
+    }
+
+    /* The shared keys outlive the context, and mix with keys added afterwards. */
+    jx_free(cntx);
+
+    if (success) {
+        obj = jxa_get(docs[0], 99);
+
+        jxd_put_number(obj, "id", 5);
+
+        for (i = 0; i < 10; i++) {
+            sprintf(key, "k%d", i);
+            jxd_put_number(obj, key, i);
+        }
+
+        jxd_del_free(obj, "name");
+
+        /* Objects moved between documents keep their keys alive on their own. */
+        jxv_free(jxa_pop(docs[1]));
+        jxa_push(docs[1], jxa_pop(docs[0]));
+
+        jxv_free(docs[0]);
+        docs[0] = NULL;
+
+        out = jx_serialize_json(jxa_top(docs[1]), false);
+    }
+
+    if (success && (out == NULL || strcmp(out, expected) != 0)) {
+        fprintf(stderr, "Error: expected [%s], got [%s].\n", expected, out);
+        success = false;
+    }
+
+    free(out);
+    jxv_free(docs[0]);
+    jxv_free(docs[1]);
+
+    if (success) {
+        printf("Success\n");
+    }
+
+    return success;
+}
+
+bool execute_packed_array_test()
+{
+    const char *json = "[ 1, -2.5, 3e2, 4 ]";
+    const char *expected = "[1,-2.5,300,5,\"six\"]";
+
+    jx_cntx *cntx;
+    jx_value *array = NULL, *value;
+    double nums[4] = { 0, 0, 0, 0 };
+    char *out = NULL;
+    bool packed, success = false;
+
+    printf("Testing packed arrays:\n");
+
+    if ((cntx = jx_new()) == NULL) {
+        fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
+        return false;
+    }
+
+    jx_parse_json(cntx, json, strlen(json));
+
+    if ((array = jx_get_result(cntx)) == NULL) {
+        fprintf(stderr, "Error: %s\n", jx_get_error_message(cntx));
+    }
+    else if (jxa_get_numbers(array, nums, 1, 4) != 3 || nums[0] != -2.5 || nums[1] != 300 || nums[2] != 4 ||
+        jxa_get_numbers(array, nums, 4, 1) != 0) {
+        fprintf(stderr, "Error: jxa_get_numbers() copied [%g, %g, %g].\n", nums[0], nums[1], nums[2]);
+    }
+    else if (jxv_get_number(jxa_get(array, 1)) != -2.5 || jxv_get_number(jxa_top(array)) != 4 ||
+        !jxa_is_packed(array)) {
+        /* Reading items, as values or otherwise, must leave the array as it is. */
+        fprintf(stderr, "Error: reading items unpacked the array.\n");
+    }
+    else {
+        /* Freeing an item read from a packed array is harmless; it goes with the array. */
+        jxv_free(jxa_get(array, 0));
+
+        /* Popping a packed number hands out a value of its own. */
+        value = jxa_pop(array);
+
+        if (jxv_get_number(value) != 4) {
+            fprintf(stderr, "Error: popped %g.\n", jxv_get_number(value));
+        }
+
+        jxv_free(value);
+
+        /* A number pushed as a value joins the others in place. */
+        jxa_push(array, jxv_int_new(5));
+        packed = jxa_is_packed(array);
+
+        /* Adding anything but a number boxes the numbers that are already there. */
+        jxa_push(array, jxs_new("six"));
+
+        out = jx_serialize_json(array, false);
+
+        if (out == NULL || strcmp(out, expected) != 0 || jxa_get_type(array, 4) != JX_TYPE_STRING ||
+            !packed || jxa_is_packed(array) || !jxa_is_int(array, 3) || jxa_get_numbers(array, nums, 2, 4) != 3 ||
+            nums[0] != 300 || nums[1] != 5 || nums[2] != 0) {
+            fprintf(stderr, "Error: expected [%s], got [%s].\n", expected, out);
+        }
+        else {
+            success = true;
+        }
+    }
+
+    if (success) {
+        printf("Success\n");
+    }
+
+    free(out);
+    jxv_free(array);
+    jx_free(cntx);
+
+    return success;
+}
+
+bool execute_int_test()
+{
+    const char *json = "{ \"id\": 9223372036854775807, \"ids\": [ 9007199254740993, -9223372036854775808, 1.5 ], "
+        "\"mixed\": [ 1, 2.5, 3 ], \"big\": 9223372036854775808, \"zero\": -0 }";
+    const char *expected = "{\"id\":9223372036854775807,\"ids\":[9007199254740993,-9223372036854775808,1.5],"
+        "\"mixed\":[1,2.5,3,-42],\"big\":9223372036854776000,\"zero\":-0}";
+
+    jx_cntx *cntx;
+    jx_value *doc = NULL, *ids, *mixed;
+    char *out = NULL;
+    bool success = false;
+    size_t i;
+
+    printf("Testing integers:\n");
+
+    if ((cntx = jx_new()) == NULL) {
+        fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
+        return false;
+    }
+
+    /* A byte at a time, so that every number also takes the path for split input. */
+    for (i = 0; i < strlen(json) && jx_parse_json(cntx, json + i, 1) == 0; i++) {
+        continue;
+    }
+
+    if ((doc = jx_get_result(cntx)) == NULL) {
+        fprintf(stderr, "Error: %s\n", jx_get_error_message(cntx));
+    }
+    else {
+        ids = jxd_get(doc, "ids");
+        mixed = jxd_get(doc, "mixed");
+
+        /* Integers stay integers, whatever comes after them in the array. */
+        jxa_push_int(mixed, -42);
+
+        if (jxd_get_int(doc, "id", NULL) != INT64_MAX || jxa_get_int(ids, 0) != 9007199254740993LL ||
+            !jxa_is_int(ids, 1) || jxa_is_int(ids, 2) || !jxa_is_int(mixed, 0) ||
+            !jxv_is_int(jxa_get(mixed, 0)) || jxa_is_int(mixed, 1) || jxa_get_int(mixed, 1) != 2 ||
+            !jxa_is_int(mixed, 3) || !jxa_is_packed(mixed) ||
+            jxv_is_int(jxd_get(doc, "big")) || jxv_is_int(jxd_get(doc, "zero"))) {
+            fprintf(stderr, "Error: integers were not kept exact.\n");
+        }
+        else if ((out = jx_serialize_json(doc, false)) == NULL || strcmp(out, expected) != 0) {
+            fprintf(stderr, "Error: expected [%s], got [%s].\n", expected, out);
+        }
+        else {
+            success = true;
+        }
+    }
+
+    if (success) {
+        printf("Success\n");
+    }
+
+    free(out);
+    jxv_free(doc);
+    jx_free(cntx);
+
+    return success;
+}
+
+bool execute_key_test()
+{
+    jx_dict_engine engines[] = { JX_DICT_HASH, JX_DICT_TRIE };
+
+    jx_value *dict, *records;
+    jx_key *prepared[20], *missing;
+    jx_cntx *cntx;
+    char key[32];
+    bool success = true;
+    int e, i;
+
+    printf("Testing key lookups:\n");
+
+    for (e = 0; e < 2 && success; e++) {
+        jxd_set_default_engine(engines[e]);
+
+        if ((dict = jxd_new()) == NULL) {
+            fprintf(stderr, "Error allocating object: %s\n", strerror(errno));
+            success = false;
+            break;
+        }
+
+        /* Enough keys for the hash table to index them. */
+        for (i = 0; i < 20; i++) {
+            sprintf(key, "key-%d", i);
+            jxd_put_number(dict, key, i);
+            prepared[i] = jx_key_prepare(key);
+        }
+
+        /* Keys given with a length are only read up to it. */
+        jxd_put_n(dict, "name=value", 4, jxv_number_new(100));
+        missing = jx_key_prepare("key-20");
+
+        if (jxd_get_number(dict, "name", NULL) != 100 ||
+            jxv_get_number(jxd_get_n(dict, "key-12345", 6)) != 12 ||
+            jxd_get_n(dict, "key-1", 4) != NULL || jxd_get_k(dict, missing) != NULL) {
+            fprintf(stderr, "Error: engine %d, lookup by length failed.\n", e);
+            success = false;
+        }
+
+        /* Keys are bytes, so a null byte inside one doesn't cut it short. */
+        jxd_put_n(dict, "ke\0-11", 6, jxv_number_new(11));
+        jxd_put_n(dict, "ke\0-22", 6, jxv_number_new(22));
+        jxv_free(jxd_del_n(dict, "ke\0-22x", 6));
+
+        if (jxd_size(dict) != 22 || jxv_get_number(jxd_get_n(dict, "ke\0-11", 6)) != 11 ||
+            jxd_get_n(dict, "ke\0-22", 6) != NULL || jxd_get_n(dict, "ke", 2) != NULL ||
+            jxd_get_n(dict, "ke\0", 3) != NULL) {
+            fprintf(stderr, "Error: engine %d, keys with null bytes were mixed up.\n", e);
+            success = false;
+        }
+
+        for (i = 0; i < 20 && success; i++) {
+            if (prepared[i] == NULL || jxv_get_number(jxd_get_k(dict, prepared[i])) != i) {
+                fprintf(stderr, "Error: engine %d, prepared key %d not found.\n", e, i);
+                success = false;
+            }
+        }
+
+        if (success) {
+            jx_value *value = jxd_del_n(dict, "key-19x", 6);
+
+            if (jxv_get_number(value) != 19 || jxd_get_k(dict, prepared[19]) != NULL) {
+                fprintf(stderr, "Error: engine %d, delete by length failed.\n", e);
+                success = false;
+            }
+
+            jxv_free(value);
+        }
+
+        for (i = 0; i < 20; i++) {
+            jx_key_free(prepared[i]);
+        }
+
+        jx_key_free(missing);
+        jxv_free(dict);
+    }
+
+    jxd_set_default_engine(JX_DICT_HASH);
+
+    /* Parsed records share their keys, with a prepared key still found by its bytes. */
+    if (success && (cntx = jx_new()) != NULL) {
+        jx_value *json = jxs_new("[");
+
+        for (i = 0; i < 100; i++) {
+            jxs_append_fmt(json, "%s{\"a\": 0, \"b\": 1, \"c\": 2, \"d\": 3, \"e\": 4, "
+                "\"f\": 5, \"g\": 6, \"h\": 7, \"i\": 8, \"id\": %d}", i > 0 ? "," : "", i);
+        }
+
+        jxs_append_str(json, "]");
+        jx_parse_json(cntx, jxs_get_str(json), strlen(jxs_get_str(json)));
+
+        prepared[0] = jx_key_prepare("id");
+
+        if ((records = jx_get_result(cntx)) == NULL) {
+            fprintf(stderr, "Error: %s\n", jx_get_error_message(cntx));
+            success = false;
+        }
+
+        for (i = 0; i < 100 && success; i++) {
+            if (jxv_get_int(jxd_get_k(jxa_get(records, i), prepared[0])) != i) {
+                fprintf(stderr, "Error: record %d, prepared key not found.\n", i);
+                success = false;
+            }
+        }
+
+        jx_key_free(prepared[0]);
+        jxv_free(records);
+        jxv_free(json);
+        jx_free(cntx);
+    }
+
+    if (success) {
+        printf("Success\n");
+    }
+
+    return success;
+}
+
+bool execute_iter_test()
+{
+    jx_dict_engine engines[] = { JX_DICT_HASH, JX_DICT_TRIE };
+    const char *orders[] = { "b,,a-rather-long-key-of-forty-bytes-or-so,d,",
+        ",a-rather-long-key-of-forty-bytes-or-so,b,d," };
+
+    jx_value *array, *dict, *keys;
+    jx_iter iter;
+    const char *key;
+    size_t length;
+    bool success = true;
+    int e, i;
+
+    printf("Testing iterators:\n");
+
+    /* A packed array is iterated over as it is. */
+    array = jxa_new(4);
+
+    for (i = 0; i < 10; i++) {
+        jxa_push_int(array, i * i);
+    }
+
+    jx_iter_init(&iter, array);
+
+    for (i = 0; jx_iter_next(&iter); i++) {
+        if (jx_iter_value(&iter) != jxa_get(array, i) || !jxv_is_int(jx_iter_value(&iter)) ||
+            jxv_get_int(jx_iter_value(&iter)) != i * i) {
+            fprintf(stderr, "Error: packed array item %d is wrong.\n", i);
+            success = false;
+        }
+    }
+
+    if (i != 10 || !jxa_is_packed(array)) {
+        fprintf(stderr, "Error: iterated over %d packed array items.\n", i);
+        success = false;
+    }
+
+    jxa_push(array, jxs_new("last"));
+
+    jx_iter_init(&iter, array);
+
+    for (i = 0; jx_iter_next(&iter); i++) {
+        jx_value *item = jx_iter_value(&iter);
+
+        if (jx_iter_key(&iter, &length) != NULL || length != 0 ||
+            (i < 10 && jxv_get_int(item) != i * i) || (i == 10 && strcmp(jxs_get_str(item), "last") != 0)) {
+            fprintf(stderr, "Error: array item %d is wrong.\n", i);
+            success = false;
+        }
+    }
+
+    if (i != 11 || jx_iter_next(&iter) || jx_iter_init(&iter, jxv_null()) || jx_iter_next(&iter)) {
+        fprintf(stderr, "Error: iterated over %d array items.\n", i);
+        success = false;
+    }
+
+    jxv_free(array);
+
+    for (e = 0; e < 2 && success; e++) {
+        jxd_set_default_engine(engines[e]);
+
+        dict = jxd_new();
+        keys = jxs_new(NULL);
+
+        jxd_put_number(dict, "b", 1);
+        jxd_put_number(dict, "c", 2);
+        jxd_put_number(dict, "", 3);
+        jxd_put_number(dict, "a-rather-long-key-of-forty-bytes-or-so", 4);
+        jxd_put_number(dict, "d", 5);
+        jxd_del_free(dict, "c");
+
+        jx_iter_init(&iter, dict);
+
+        while (jx_iter_next(&iter)) {
+            key = jx_iter_key(&iter, &length);
+
+            if (strlen(key) != length || jx_iter_value(&iter) != jxd_get(dict, (char *)key)) {
+                fprintf(stderr, "Error: engine %d, member [%s] is wrong.\n", e, key);
+                success = false;
+            }
+
+            jxs_append_fmt(keys, "%s,", key);
+        }
+
+        if (strcmp(jxs_get_str(keys), orders[e]) != 0) {
+            fprintf(stderr, "Error: engine %d has keys [%s].\n", e, jxs_get_str(keys));
+            success = false;
+        }
+
+        /* Stopping early. */
+        jx_iter_init(&iter, dict);
+
+        if (!jx_iter_next(&iter) || !jx_iter_next(&iter) || jx_iter_value(&iter) == NULL) {
+            fprintf(stderr, "Error: engine %d has too few members.\n", e);
+            success = false;
+        }
+
+        jx_iter_end(&iter);
+
+        if (jx_iter_next(&iter) || jx_iter_value(&iter) != NULL) {
+            fprintf(stderr, "Error: engine %d, iteration didn't end.\n", e);
+            success = false;
+        }
+
+        jxv_free(keys);
+        jxv_free(dict);
+    }
+
+    jxd_set_default_engine(JX_DICT_HASH);
+
+    if (success) {
+        printf("Success\n");
+    }
+
+    return success;
+}
+
+typedef struct
+{
+    char data[512];
+    size_t length, writes, max_writes;
+} serialize_sink;
+
+bool collect_output(void *user, const char *data, size_t length)
+{
+    serialize_sink *sink = user;
+
+    if (sink->writes++ == sink->max_writes || sink->length + length > sizeof(sink->data)) {
+        return false;
+    }
+
+    memcpy(sink->data + sink->length, data, length);
+    sink->length += length;
+
+    return true;
+}
+
+bool execute_stream_test()
+{
+    const char *json = "{ \"quote\": \"say \\\"hi\\\"\", \"path\": \"C:\\\\tmp\", "
+        "\"list\": [ 1, 2.5, true, null, { \"tab\": \"a\\tb\" } ] }";
+    size_t buffer_sizes[] = { 1, 7, 0 };
+
+    jx_serialize_opts opts;
+    serialize_sink sink;
+    jx_cntx *cntx;
+    jx_value *value;
+    char *expected[2] = { NULL, NULL };
+    bool success = true;
+    int escape, i;
+
+    printf("Testing streaming serialization:\n");
+
+    if ((cntx = jx_new()) == NULL) {
+        fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
+        return false;
+    }
+
+    jx_parse_json(cntx, json, strlen(json));
+
+    if ((value = jx_get_result(cntx)) == NULL ||
+        (expected[0] = jx_serialize_json(value, false)) == NULL ||
+        (expected[1] = jx_serialize_json(value, true)) == NULL) {
+        fprintf(stderr, "Error: %s\n", jx_get_error_message(cntx));
+        success = false;
+    }
+
+    /* Buffers smaller than a token, and one larger than the document. */
+    for (escape = 0; escape < 2 && success; escape++) {
+        for (i = 0; i < 3 && success; i++) {
+            memset(&sink, 0, sizeof(sink));
+            sink.max_writes = SIZE_MAX;
+
+            opts.escape = escape;
+            opts.buffer_size = buffer_sizes[i];
+
+            if (!jx_serialize_to_sink(value, collect_output, &sink, &opts) ||
+                sink.length != strlen(expected[escape]) ||
+                memcmp(sink.data, expected[escape], sink.length) != 0 ||
+                (buffer_sizes[i] == 1 && sink.writes != sink.length) || (buffer_sizes[i] == 0 && sink.writes != 1)) {
+                fprintf(stderr, "Error: buffer size %lu, got [%.*s] in %lu writes.\n", (unsigned long)buffer_sizes[i],
+                    (int)sink.length, sink.data, (unsigned long)sink.writes);
+                success = false;
+            }
+        }
+    }
+
+    /* A sink failing stops the serialization. */
+    if (success) {
+        memset(&sink, 0, sizeof(sink));
+        sink.max_writes = 2;
+
+        opts.escape = false;
+        opts.buffer_size = 8;
+
+        if (jx_serialize_to_sink(value, collect_output, &sink, &opts) || sink.writes != 3 ||
+            jx_serialize_to_sink(jxv_null(), collect_output, &sink, NULL)) {
+            fprintf(stderr, "Error: serialization continued after %lu writes.\n", (unsigned long)sink.writes);
+            success = false;
+        }
+    }
+
+#ifndef WIN32
+    if (success) {
+        int fds[2];
+        char out[512];
+        ssize_t n;
+
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+            fprintf(stderr, "Error creating socket pair: %s\n", strerror(errno));
+            success = false;
+        }
+        else {
+            if (!jx_serialize_to_fd(value, fds[0], NULL) || (n = read(fds[1], out, sizeof(out))) == -1 ||
+                (size_t)n != strlen(expected[0]) || memcmp(out, expected[0], n) != 0) {
+                fprintf(stderr, "Error: serializing to a socket failed.\n");
+                success = false;
+            }
+
+            close(fds[0]);
+            close(fds[1]);
+        }
+    }
+#endif
+
+    free(expected[0]);
+    free(expected[1]);
+    jxv_free(value);
+    jx_free(cntx);
+
+    if (success) {
+        printf("Success\n");
+    }
+
+    return success;
+}
+
+#ifndef WIN32
+/* Append what's waiting on a socket to a growing buffer. */
+bool drain_socket(int fd, char **data, size_t *length, size_t *size)
+{
+    ssize_t n;
+
+    do {
+        if (*size - *length < 4096) {
+            char *buf = realloc(*data, *size * 2 + 4096);
+
+            if (buf == NULL) {
+                return false;
+            }
+
+            *data = buf;
+            *size = *size * 2 + 4096;
+        }
+
+        n = read(fd, *data + *length, *size - *length);
+
+        if (n > 0) {
+            *length += n;
+        }
+    } while (n > 0);
+
+    return n == 0 || errno == EAGAIN || errno == EWOULDBLOCK;
+}
+#endif
+
+bool execute_writer_test()
+{
+    jx_dict_engine engines[] = { JX_DICT_HASH, JX_DICT_TRIE };
+
+    jx_value *value = NULL;
+    bool success = true;
+    int e;
+
+    printf("Testing resumable writes:\n");
+
+    if (jx_writer_new(jxv_null()) != NULL) {
+        fprintf(stderr, "Error: created a writer for a scalar.\n");
+        success = false;
+    }
+
+#ifndef WIN32
+    for (e = 0; e < 2 && success; e++) {
+        jx_writer *w = NULL;
+        jx_cntx *cntx;
+        char *json = NULL, *expected = NULL, *data = NULL;
+        size_t json_length = 0, length = 0, size = 0, blocked = 0;
+        int fds[2] = { -1, -1 }, sndbuf = 4096, result, i;
+
+        jxd_set_default_engine(engines[e]);
+
+        /* Records with nested objects, packed arrays and strings to escape, several times
+         * larger than the socket buffer. */
+        json = malloc(2000 * 128);
+
+        if (json == NULL || (cntx = jx_new()) == NULL) {
+            fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
+            free(json);
+            success = false;
+            break;
+        }
+
+        json_length += sprintf(json, "[");
+
+        for (i = 0; i < 2000; i++) {
+            json_length += sprintf(json + json_length, "%s{ \"id\": %d, \"name\": \"user \\\"%d\\\"\", "
+                "\"scores\": [ %d, %d.5 ], \"tags\": { \"a\": [], \"b\": {} } }", i ? "," : "", i, i, i, i);
+        }
+
+        json_length += sprintf(json + json_length, "]");
+
+        jx_parse_json(cntx, json, json_length);
+
+        if ((value = jx_get_result(cntx)) == NULL || (expected = jx_serialize_json(value, false)) == NULL) {
+            fprintf(stderr, "Error: %s\n", jx_get_error_message(cntx));
+            success = false;
+        }
+        else if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1 ||
+            setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) == -1 ||
+            fcntl(fds[0], F_SETFL, O_NONBLOCK) == -1 || fcntl(fds[1], F_SETFL, O_NONBLOCK) == -1 ||
+            (w = jx_writer_new(value)) == NULL) {
+            fprintf(stderr, "Error creating writer: %s\n", strerror(errno));
+            success = false;
+        }
+
+        /* Read whenever the writer would block, until it is done. */
+        while (success && (result = jx_writer_write(w, fds[0])) != 1) {
+            if (result == -1 || !drain_socket(fds[1], &data, &length, &size)) {
+                fprintf(stderr, "Error writing: %s\n", strerror(errno));
+                success = false;
+            }
+
+            blocked++;
+        }
+
+        if (success && (!drain_socket(fds[1], &data, &length, &size) || blocked == 0 ||
+            length != strlen(expected) || memcmp(data, expected, length) != 0 ||
+            jx_writer_write(w, fds[0]) != 1)) {
+            fprintf(stderr, "Error: wrote %lu of %lu bytes, blocking %lu times.\n", (unsigned long)length,
+                (unsigned long)strlen(expected), (unsigned long)blocked);
+            success = false;
+        }
+
+        if (fds[0] != -1) {
+            close(fds[0]);
+            close(fds[1]);
+        }
+
+        jx_writer_free(w);
+        free(data);
+        free(expected);
+        free(json);
+        jxv_free(value);
+        jx_free(cntx);
+    }
+
+    jxd_set_default_engine(JX_DICT_HASH);
+#endif
+
+    if (success) {
+        printf("Success\n");
+    }
+
+    return success;
+}
+
+bool execute_size_test()
+{
+    const char *docs[] = {
+        "[]",
+        "{ \"quote\": \"say \\\"hi\\\"\", \"path\": \"C:\\\\tmp\", \"ctrl\": \"\\u00e9\\r\\n\" }",
+        "[ 1, -2.5e-7, 9007199254740993, true, null, [ [ {} ] ], { \"a\": [ 0.1, 2 ] } ]"
+    };
+
+    jx_serialize_opts opts;
+    jx_cntx *cntx;
+    jx_value *value;
+    char *expected, buf[256];
+    size_t size;
+    bool success = true;
+    int d, escape;
+
+    printf("Testing exact-size serialization:\n");
+
+    if ((cntx = jx_new()) == NULL) {
+        fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
+        return false;
+    }
+
+    memset(&opts, 0, sizeof(opts));
+
+    for (d = 0; d < (int)(sizeof(docs) / sizeof(docs[0])) && success; d++) {
+        jx_reset(cntx);
+        jx_parse_json(cntx, docs[d], strlen(docs[d]));
+
+        if ((value = jx_get_result(cntx)) == NULL) {
+            fprintf(stderr, "Error: %s\n", jx_get_error_message(cntx));
+            success = false;
+            break;
+        }
+
+        for (escape = 0; escape < 2 && success; escape++) {
+            opts.escape = escape;
+
+            expected = jx_serialize_json(value, escape);
+            size = jx_serialized_size(value, &opts);
+
+            /* The exact size is enough, one byte less isn't, and nothing is written past
+             * the end of the buffer either way. */
+            memset(buf, '#', sizeof(buf));
+
+            if (expected == NULL || size != strlen(expected) || jx_serialize_into(value, buf, size - 1, &opts) != 0 ||
+                buf[size - 1] != '#' || jx_serialize_into(value, buf, size, &opts) != size ||
+                memcmp(buf, expected, size) != 0 || buf[size] != '#') {
+                fprintf(stderr, "Error: expected %lu bytes [%s], got [%.*s].\n", (unsigned long)size, expected,
+                    (int)size, buf);
+                success = false;
+            }
+
+            free(expected);
+        }
+
+        jxv_free(value);
+    }
+
+    if (success && (jx_serialized_size(jxv_null(), NULL) != 0 || jx_serialize_into(jxv_null(), buf, sizeof(buf), NULL) != 0)) {
+        fprintf(stderr, "Error: serialized a scalar.\n");
+        success = false;
+    }
+
+    jx_free(cntx);
+
+    if (success) {
+        printf("Success\n");
+    }
+
+    return success;
+}
+
+/* Serialize a document that keeps its serialized bytes, and an equal one that doesn't. */
+bool compare_cached(jx_value *cached, jx_value *plain, const char *step)
+{
+    char *expected = jx_serialize_json(plain, false);
+    char *out = jx_serialize_json(cached, false);
+    bool success;
+
+    success = expected != NULL && out != NULL && strcmp(out, expected) == 0 &&
+        jx_serialized_size(cached, NULL) == strlen(expected);
+
+    if (!success) {
+        fprintf(stderr, "Error: after %s, expected [%s], got [%s].\n", step, expected, out);
+    }
+
+    free(expected);
+    free(out);
+
+    return success;
+}
+
+bool execute_cache_test()
+{
+    jx_dict_engine engines[] = { JX_DICT_HASH, JX_DICT_TRIE };
+
+    const char *json = "{ \"name\": \"config\", \"servers\": [ { \"host\": \"a\", \"ports\": [ 80, 443 ] }, "
+        "{ \"host\": \"b\", \"ports\": [] } ], \"limits\": { \"cpu\": 2, \"mem\": { \"soft\": 1, \"hard\": 2 } } }";
+
+    jx_value *docs[2], *item;
+    jx_arena *arena;
+    jx_cntx *cntx;
+    char *out;
+    bool success = true;
+    int e, d;
+
+    printf("Testing serialization caches:\n");
+
+    if ((cntx = jx_new()) == NULL) {
+        fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
+        return false;
+    }
+
+    for (e = 0; e < 2 && success; e++) {
+        jxd_set_default_engine(engines[e]);
+
+        /* The same changes to a document with caches (docs[0]) and one without. */
+        for (d = 0; d < 2; d++) {
+            jx_reset(cntx);
+            jx_parse_json(cntx, json, strlen(json));
+
+            docs[d] = jx_get_result(cntx);
+        }
+
+        if (docs[0] == NULL || docs[1] == NULL || !jxv_set_cache(docs[0], true)) {
+            fprintf(stderr, "Error: %s\n", jx_get_error_message(cntx));
+            jxv_free(docs[0]);
+            jxv_free(docs[1]);
+            success = false;
+            break;
+        }
+
+        success = compare_cached(docs[0], docs[1], "enabling");
+
+        for (d = 0; d < 2; d++) {
+            jxd_put_int(jxd_get(jxd_get(docs[d], "limits"), "mem"), "hard", 4);
+        }
+
+        success = success && compare_cached(docs[0], docs[1], "jxd_put");
+
+        for (d = 0; d < 2; d++) {
+            jxv_free(jxd_del(jxd_get(docs[d], "limits"), "cpu"));
+            jxa_push_int(jxd_get(jxa_get(jxd_get(docs[d], "servers"), 1), "ports"), 8080);
+        }
+
+        success = success && compare_cached(docs[0], docs[1], "jxd_del and jxa_push_int");
+
+        /* Containers added later are followed too. */
+        for (d = 0; d < 2; d++) {
+            item = jxd_new();
+            jxd_put_string(item, "host", "c");
+            jxd_put(item, "ports", jxa_new(1));
+            jxa_push(jxd_get(docs[d], "servers"), item);
+        }
+
+        success = success && compare_cached(docs[0], docs[1], "jxa_push");
+
+        for (d = 0; d < 2; d++) {
+            jxa_push_int(jxd_get(jxa_get(jxd_get(docs[d], "servers"), 2), "ports"), 22);
+        }
+
+        success = success && compare_cached(docs[0], docs[1], "changing an added container");
+
+        /* A container taken out no longer changes the document. */
+        for (d = 0; d < 2; d++) {
+            item = jxa_pop(jxd_get(docs[d], "servers"));
+            jxd_put_bool(item, "gone", true);
+            jxv_free(item);
+        }
+
+        success = success && compare_cached(docs[0], docs[1], "jxa_pop");
+
+        /* Strings changed in place aren't noticed, which shows that unchanged parts are
+         * copied from the cache. */
+        if (success) {
+            jxs_append_str(jxd_get(jxa_get(jxd_get(docs[0], "servers"), 0), "host"), "!");
+
+            if ((out = jx_serialize_json(docs[0], false)) == NULL || strstr(out, "\"a!\"") != NULL) {
+                fprintf(stderr, "Error: a cached subtree was serialized again [%s].\n", out);
+                success = false;
+            }
+
+            free(out);
+
+            jxs_append_str(jxd_get(jxa_get(jxd_get(docs[1], "servers"), 0), "host"), "!");
+            jxd_put_int(jxa_get(jxd_get(docs[0], "servers"), 0), "weight", 1);
+            jxd_put_int(jxa_get(jxd_get(docs[1], "servers"), 0), "weight", 1);
+
+            success = compare_cached(docs[0], docs[1], "changing a cached subtree");
+        }
+
+        if (success) {
+            jxv_set_cache(docs[0], false);
+            jxd_put_int(docs[0], "version", 2);
+            jxd_put_int(docs[1], "version", 2);
+
+            success = compare_cached(docs[0], docs[1], "disabling");
+        }
+
+        jxv_free(docs[0]);
+        jxv_free(docs[1]);
+    }
+
+    jxd_set_default_engine(JX_DICT_HASH);
+
+    /* Only containers outside of arenas keep caches. */
+    if (success) {
+        if ((arena = jx_arena_new(4096)) == NULL) {
+            fprintf(stderr, "Error allocating arena: %s\n", strerror(errno));
+            success = false;
+        }
+        else {
+            item = jxa_new_arena(arena, 1);
+
+            if (jxv_set_cache(item, true) || jxv_set_cache(jxv_null(), true)) {
+                fprintf(stderr, "Error: enabled a cache for an arena value or a scalar.\n");
+                success = false;
+            }
+
+            jx_arena_free(arena);
+        }
+    }
+
+    jx_free(cntx);
+
+    if (success) {
+        printf("Success\n");
+    }
+
+    return success;
+}
+
+bool execute_parallel_test()
+{
+    jx_dict_engine engines[] = { JX_DICT_HASH, JX_DICT_TRIE };
+    int threads[] = { 1, 2, 3, 8, 0 };
+
+    jx_value *docs[3], *item;
+    char *expected, *out, key[32];
+    bool success = true;
+    int e, d, t, i;
+
+    printf("Testing parallel serialization:\n");
+
+    for (e = 0; e < 2 && success; e++) {
+        jxd_set_default_engine(engines[e]);
+
+        /* A large array of records, a large object, and a packed array. */
+        docs[0] = jxa_new(0);
+        docs[1] = jxd_new();
+        docs[2] = jxa_new(0);
+
+        for (i = 0; i < 5000; i++) {
+            item = jxd_new();
+            jxd_put_int(item, "id", i);
+            jxd_put_string(item, "name", (i % 7) ? "plain" : "needs \"escaping\"\n");
+            jxd_put(item, "scores", jxa_new(2));
+            jxa_push_number(jxd_get(item, "scores"), i / 8.0);
+            jxa_push(docs[0], item);
+
+            sprintf(key, "key %d", i);
+            jxd_put_number(docs[1], key, i * 0.1);
+
+            jxa_push_int(docs[2], (int64_t)i * 1000003);
+        }
+
+        for (d = 0; d < 3 && success; d++) {
+            expected = jx_serialize_json(docs[d], false);
+
+            for (t = 0; t < (int)(sizeof(threads) / sizeof(threads[0])) && success; t++) {
+                if ((out = jx_serialize_json_parallel(docs[d], threads[t])) == NULL || expected == NULL ||
+                    strcmp(out, expected) != 0) {
+                    fprintf(stderr, "Error: document %d with %d threads differs from the serial output.\n",
+                        d, threads[t]);
+                    success = false;
+                }
+
+                free(out);
+            }
+
+#ifndef WIN32
+            if (success) {
+                FILE *file = tmpfile();
+                size_t length = strlen(expected);
+
+                out = malloc(length + 1);
+
+                if (file == NULL || out == NULL || !jx_serialize_to_fd_parallel(docs[d], fileno(file), 4) ||
+                    lseek(fileno(file), 0, SEEK_SET) != 0 || read(fileno(file), out, length + 1) != (ssize_t)length ||
+                    memcmp(out, expected, length) != 0) {
+                    fprintf(stderr, "Error: document %d written in parallel differs from the serial output.\n", d);
+                    success = false;
+                }
+
+                if (file != NULL) {
+                    fclose(file);
+                }
+
+                free(out);
+            }
+#endif
+
+            free(expected);
+        }
+
+        /* The caches of the containers in a range are filled in by the thread serializing it. */
+        for (i = 0; i < 2 && success; i++) {
+            if (!jxv_set_cache(docs[0], true) || !jxd_put_int(jxa_get(docs[0], i * 1000), "id", -1) ||
+                (out = jx_serialize_json_parallel(docs[0], 4)) == NULL) {
+                fprintf(stderr, "Error: serializing a document with caches failed.\n");
+                success = false;
+                break;
+            }
+
+            expected = jx_serialize_json(docs[0], false);
+
+            if (expected == NULL || strcmp(out, expected) != 0) {
+                fprintf(stderr, "Error: a document with caches serialized in parallel differs.\n");
+                success = false;
+            }
+
+            free(expected);
+            free(out);
+        }
+
+        for (d = 0; d < 3; d++) {
+            jxv_free(docs[d]);
+        }
+    }
+
+    jxd_set_default_engine(JX_DICT_HASH);
+
+    if (success && jx_serialize_json_parallel(jxv_null(), 4) != NULL) {
+        fprintf(stderr, "Error: serialized a scalar.\n");
+        success = false;
+    }
+
+    if (success) {
+        printf("Success\n");
+    }
+
+    return success;
+}
+
+bool execute_simple_tests()
+{
+    int i;
+    int n_tests, n_passed;
+    float score;
+    bool output = false;
+
+    jx_cntx *cntx;
+    jx_value *value;
+
+    printf("Executing simple tests:\n");
+
+    n_tests = sizeof(simple_tests) / sizeof(struct json_test);
+    n_passed = 0;
+
+    for (i = 0; i < n_tests; i++) {
+        bool passed = false;
+
+        if ((cntx = jx_new()) == NULL) {
+            fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
+            break;
+        }
+
+        jx_parse_json(cntx, simple_tests[i].json, strlen(simple_tests[i].json));
+
+        if ((value = jx_get_result(cntx)) != NULL) {
+            jxv_free(value);
+            passed = true;
+        }
+
+        if (cmd_opts.verbose || passed != simple_tests[i].should_pass) {
+            if (!output) {
+                printf("----------------------------------------------------------\n");
+                output = true;
+            }
+
+            printf("Json: %s\nResult: %s\nExpected Result: %s\nMessage: %s\n",
+                simple_tests[i].json,
+                passed ? "Passed" : "Failed",
+                simple_tests[i].should_pass ? "Pass" : "Fail",
+                !passed ? jx_get_error_message(cntx) : "OK");
+
+            printf("----------------------------------------------------------\n");
+        }
+
+        if (passed == simple_tests[i].should_pass) {
+            n_passed++;
+        }
+
+        jx_free(cntx);
+    }
+
+    score = ((float)n_passed / (float)n_tests) * 100.0f;
+
+    printf("%d of %d Tests Passed (%.1f%%)\n", n_passed, n_tests, score);
+
+    return n_tests == n_passed;
+}
+
+bool run_tests()
+{
+    if (!execute_simple_tests()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!strings_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_small_string_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_string_scan_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_muli_part_parse_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_ext_utf8_pi_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_position_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_number_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_number_format_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_escape_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_reset_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_arena_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_object_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_intern_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_packed_array_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_key_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_iter_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_stream_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_writer_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_size_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_cache_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_parallel_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_int_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_callback_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_async_test()) {
+        return false;
+    }
+
+    printf("\n");
+
+    if (!execute_mux_test()) {
+        return false;
+    }
+
+    return true;
+}
+
+bool validate_json_string(const char *json)
+{
+    jx_cntx *cntx;
+    jx_value *value;
+    char *out;
+
+    if (json == NULL) {
+        return false;
+    }
+
+    if ((cntx = jx_new()) == NULL) {
+        fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
+        return false;
+    }
+
+    jx_set_extensions(cntx, global_extensions);
+
+    jx_parse_json(cntx, json, strlen(json));
+
+    if ((value = jx_get_result(cntx)) == NULL) {
+        fprintf(stderr, "%s\n", jx_get_error_message(cntx));
+        jx_free(cntx);
+        return false;
+    }
+
+    if (cmd_opts.serialize) {
+        out = jx_serialize_json(value, cmd_opts.escape);
+
+        if (out == NULL) {
+            fprintf(stderr, "Error: %s\n", strerror(errno));
+            jxv_free(value);
+            jx_free(cntx);
+            return false;
+        }
+
+        printf("%s", out);
+
+        if (!cmd_opts.newline) {
+            putchar('\n');
+        }
+
+        free(out);
+    }
+
+    jxv_free(value);
+    jx_free(cntx);
+
+    return true;
+}
+
+bool validate_json_file(const char *path)
+{
+    jx_cntx *cntx;
+    jx_value *value;
+
+    if ((cntx = jx_new()) == NULL) {
+        fprintf(stderr, "Error allocating context: %s\n", strerror(errno));
+        return false;
+    }
+
+    jx_set_extensions(cntx, global_extensions);
+
+    value = jx_obj_from_file(cntx, path);
+
+    if (value == NULL) {
+        fprintf(stderr, "%s\n", jx_get_error_message(cntx));
+        jx_free(cntx);
+        return false;
+    }
+
+    /* Files may be large, so they are written out as they are serialized. */
+    if (cmd_opts.serialize) {
+        jx_serialize_opts opts = { cmd_opts.escape, 0 };
+
+        fflush(stdout);
+
+        if (!jx_serialize_to_fd(value, fileno(stdout), &opts)) {
+            fprintf(stderr, "Error: %s\n", strerror(errno));
+            jxv_free(value);
+            jx_free(cntx);
+            return false;
+        }
+
+        if (!cmd_opts.newline) {
+            putchar('\n');
+        }
     }
     else {
         printf("JSON OK\n");